@@ -0,0 +1,1579 @@
+/*
+ * gedit-search-counter.c
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* GeditSearchCounter counts the occurrences of the search text in a worker
+ * thread, over a snapshot of the buffer contents. GtkSourceSearchContext
+ * only knows the number of occurrences once it has scanned the whole buffer
+ * in idle chunks on the main thread; for big buffers that takes seconds and
+ * competes with typing. The counter publishes partial results while it is
+ * running, so "N of M+" can be displayed from the first keystroke.
+ *
+ * The occurrences are the ones GtkSourceSearchContext finds with the same
+ * search settings: a regex is compiled with the same flags, with \b around
+ * it at word boundaries; a plain text is compared case-insensitively like
+ * gtk_text_iter_forward_search() does, after casefolding and NFKD
+ * normalization, and at word boundaries it must start and end a natural
+ * word as Pango breaks them, the underscores being part of the words.
+ *
+ * The snapshot is copied in idle chunks on the main thread the first time,
+ * and then kept up to date: the edits of the buffer are recorded and applied
+ * to it by the next job, in the worker thread. So neither the first
+ * keystroke nor an edit copies the whole buffer on the main thread, and
+ * changing the search text doesn't copy it at all. The results of the last
+ * searches on the snapshot are cached: going back to a previous search text
+ * (e.g. deleting a character) reuses them directly, and when the new search
+ * text is a literal extension of a cached one, only the cached matches are
+ * verified instead of scanning the whole snapshot. When there are few of
+ * them, this is done synchronously, so the position of the match selected by
+ * GtkSourceSearchContext is known as soon as the search text changes.
+ */
+
+#include "gedit-search-counter.h"
+
+#include <string.h>
+#include <pango/pango.h>
+
+/* Number of matches found by the worker before they are made visible to the
+ * main thread.
+ */
+#define PUBLISH_BATCH_SIZE 256
+
+/* In milliseconds. */
+#define PROGRESS_INTERVAL 100
+#define RESTART_DELAY 300
+
+#define CACHE_MAX_JOBS 8
+#define CACHE_MAX_MATCHES 4000000
+
+/* Below this number of candidates, a refinement is verified directly on the
+ * main thread.
+ */
+#define SYNC_VERIFY_MAX_CANDIDATES 4096
+
+/* Number of characters copied to the snapshot in one idle iteration. */
+#define SNAPSHOT_CHUNK_CHARS (1 << 20)
+
+/* Beyond this number of edits to apply to the snapshot, a new one is taken
+ * instead.
+ */
+#define EDITS_MAX 32
+
+/* Number of characters tried by the worker between two checks of the
+ * cancellable, when comparing them one by one.
+ */
+#define CANCEL_CHECK_INTERVAL 4096
+
+typedef struct
+{
+	gsize start_byte;
+	gsize end_byte;
+
+	/* In characters, like GtkTextIter offsets. */
+	gint start;
+	gint end;
+} Match;
+
+/* An edit of the buffer, in characters in the text as it was before it. */
+typedef struct
+{
+	gint offset;
+	gint n_deleted;
+
+	/* NULL for a deletion. */
+	gchar *text;
+} Edit;
+
+/* The log attributes of the line the last word boundaries were checked in. */
+typedef struct
+{
+	gsize start;
+	gsize end;
+	PangoLogAttr *attrs;
+} LineAttrs;
+
+typedef struct
+{
+	gint ref_count;
+
+	/* The edits are applied to the snapshot by the worker, before
+	 * searching it.
+	 */
+	GBytes *snapshot;
+	GArray *edits;
+
+	/* A regex, or else the search text casefolded and normalized for a
+	 * case-insensitive search of a plain text.
+	 */
+	GRegex *regex;
+	gchar *folded_text;
+	gsize folded_len;
+
+	/* The folding of the characters met so far, used by a single thread
+	 * at a time.
+	 */
+	GHashTable *folds;
+
+	gboolean at_word_boundaries;
+
+	/* Whether the natural word boundaries are checked for each match,
+	 * the regex has \b around it instead.
+	 */
+	gboolean check_word_boundaries;
+
+	/* For a refinement of a previous search, the previous matches. Only
+	 * those need to be verified.
+	 */
+	GArray *candidates;
+
+	/* The search parameters, to find the job in the cache and to know if a
+	 * later search is a refinement of this one.
+	 */
+	gchar *search_text;
+	guint regex_enabled : 1;
+	guint case_sensitive : 1;
+
+	GMutex mutex;
+	GArray *matches;
+	gint n_matches;
+
+	gboolean complete;
+} CountJob;
+
+struct _GeditSearchCounter
+{
+	GObject parent_instance;
+
+	/* Weak ref */
+	GtkTextBuffer *buffer;
+
+	GtkSourceSearchSettings *settings;
+
+	/* The buffer contents, NULL while it is not completely copied yet.
+	 * The edits recorded since it was copied are not applied to it yet.
+	 */
+	GBytes *snapshot;
+	GArray *edits;
+
+	/* While the snapshot is copied, the text copied so far and the offset
+	 * in the buffer where the copy continues.
+	 */
+	GString *partial;
+	gint partial_end;
+	guint snapshot_idle_id;
+
+	/* The job for the current search settings, NULL if it has not been
+	 * started yet.
+	 */
+	CountJob *job;
+	GTask *task;
+
+	/* The last completed jobs on the snapshot, most recent first. */
+	GQueue cache;
+	guint cache_n_matches;
+
+	guint progress_timeout_id;
+	guint restart_timeout_id;
+	gint last_notified_count;
+};
+
+enum
+{
+	CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+G_DEFINE_TYPE (GeditSearchCounter, gedit_search_counter, G_TYPE_OBJECT)
+
+static CountJob *
+count_job_ref (CountJob *job)
+{
+	g_atomic_int_inc (&job->ref_count);
+	return job;
+}
+
+static void
+count_job_unref (CountJob *job)
+{
+	if (job == NULL || !g_atomic_int_dec_and_test (&job->ref_count))
+	{
+		return;
+	}
+
+	g_bytes_unref (job->snapshot);
+
+	if (job->edits != NULL)
+	{
+		g_array_unref (job->edits);
+	}
+
+	if (job->regex != NULL)
+	{
+		g_regex_unref (job->regex);
+	}
+
+	g_free (job->folded_text);
+	g_hash_table_unref (job->folds);
+
+	if (job->candidates != NULL)
+	{
+		g_array_unref (job->candidates);
+	}
+
+	g_free (job->search_text);
+	g_mutex_clear (&job->mutex);
+	g_array_unref (job->matches);
+	g_slice_free (CountJob, job);
+}
+
+static void
+edit_clear (Edit *edit)
+{
+	g_free (edit->text);
+}
+
+static GArray *
+edits_new (void)
+{
+	GArray *edits;
+
+	edits = g_array_new (FALSE, FALSE, sizeof (Edit));
+	g_array_set_clear_func (edits, (GDestroyNotify) edit_clear);
+
+	return edits;
+}
+
+static GArray *
+edits_copy (GArray *edits)
+{
+	GArray *copy;
+	guint i;
+
+	copy = edits_new ();
+
+	for (i = 0; i < edits->len; i++)
+	{
+		Edit edit = g_array_index (edits, Edit, i);
+
+		edit.text = g_strdup (edit.text);
+		g_array_append_val (copy, edit);
+	}
+
+	return copy;
+}
+
+static GBytes *
+apply_edits (GBytes *snapshot,
+	     GArray *edits)
+{
+	GString *text;
+	gsize len;
+	const gchar *data;
+	guint i;
+
+	data = g_bytes_get_data (snapshot, &len);
+	text = g_string_new_len (data, len);
+
+	for (i = 0; i < edits->len; i++)
+	{
+		const Edit *edit = &g_array_index (edits, Edit, i);
+		gchar *start;
+		gchar *end;
+
+		start = g_utf8_offset_to_pointer (text->str, edit->offset);
+		end = g_utf8_offset_to_pointer (start, edit->n_deleted);
+
+		g_string_erase (text, start - text->str, end - start);
+
+		if (edit->text != NULL)
+		{
+			g_string_insert (text, start - text->str, edit->text);
+		}
+	}
+
+	return g_string_free_to_bytes (text);
+}
+
+/* Returns the log attributes of the position @pos, computed like
+ * gtk_text_iter_starts_word() does for the line which contains it.
+ */
+static const PangoLogAttr *
+get_log_attr (LineAttrs   *line,
+	      const gchar *text,
+	      gsize        len,
+	      gsize        pos)
+{
+	if (line->attrs == NULL || pos < line->start || pos > line->end)
+	{
+		const gchar *newline;
+		gint n_chars;
+
+		line->start = pos;
+
+		while (line->start > 0 && text[line->start - 1] != '\n')
+		{
+			line->start--;
+		}
+
+		newline = memchr (text + pos, '\n', len - pos);
+		line->end = newline != NULL ? (gsize) (newline - text) : len;
+
+		n_chars = g_utf8_strlen (text + line->start, line->end - line->start);
+
+		g_free (line->attrs);
+		line->attrs = g_new (PangoLogAttr, n_chars + 1);
+
+		pango_get_log_attrs (text + line->start,
+				     line->end - line->start,
+				     -1,
+				     pango_language_get_default (),
+				     line->attrs,
+				     n_chars + 1);
+	}
+
+	return &line->attrs[g_utf8_strlen (text + line->start, pos - line->start)];
+}
+
+static gunichar
+get_char_before (const gchar *text,
+		 gsize        pos)
+{
+	return pos > 0 ? g_utf8_get_char (g_utf8_prev_char (text + pos)) : 0;
+}
+
+/* Like the extra natural word boundaries of GtkSourceView: the natural words
+ * of Pango, with the underscores as part of them.
+ */
+static gboolean
+starts_extra_natural_word (LineAttrs   *line,
+			   const gchar *text,
+			   gsize        len,
+			   gsize        pos)
+{
+	const PangoLogAttr *attr = get_log_attr (line, text, len, pos);
+	gunichar c = pos < len ? g_utf8_get_char (text + pos) : 0;
+
+	if (pos == 0)
+	{
+		return attr->is_word_start || c == '_';
+	}
+
+	if (attr->is_word_start)
+	{
+		return get_char_before (text, pos) != '_';
+	}
+
+	return (c == '_' &&
+		get_char_before (text, pos) != '_' &&
+		!attr->is_word_end);
+}
+
+static gboolean
+ends_extra_natural_word (LineAttrs   *line,
+			 const gchar *text,
+			 gsize        len,
+			 gsize        pos)
+{
+	const PangoLogAttr *attr = get_log_attr (line, text, len, pos);
+	gunichar c = pos < len ? g_utf8_get_char (text + pos) : 0;
+
+	if (pos == len)
+	{
+		return attr->is_word_end || get_char_before (text, pos) == '_';
+	}
+
+	if (attr->is_word_end)
+	{
+		return c != '_';
+	}
+
+	return (get_char_before (text, pos) == '_' &&
+		c != '_' &&
+		!attr->is_word_start);
+}
+
+static gchar *
+fold_text (const gchar *text,
+	   gssize       len)
+{
+	gchar *casefold;
+	gchar *folded;
+
+	casefold = g_utf8_casefold (text, len);
+	folded = g_utf8_normalize (casefold, -1, G_NORMALIZE_NFKD);
+	g_free (casefold);
+
+	return folded;
+}
+
+/* Returns the casefolded and normalized character at @p, in @ascii for an
+ * ASCII character.
+ */
+static const gchar *
+fold_char (CountJob    *job,
+	   const gchar *p,
+	   gchar       *ascii,
+	   gsize       *folded_len)
+{
+	gunichar c = (guchar) *p;
+	gchar *folded;
+
+	if (c < 0x80)
+	{
+		*ascii = g_ascii_tolower (c);
+		*folded_len = 1;
+		return ascii;
+	}
+
+	c = g_utf8_get_char (p);
+	folded = g_hash_table_lookup (job->folds, GUINT_TO_POINTER (c));
+
+	if (folded == NULL)
+	{
+		folded = fold_text (p, g_utf8_next_char (p) - p);
+		g_hash_table_insert (job->folds, GUINT_TO_POINTER (c), folded);
+	}
+
+	*folded_len = strlen (folded);
+	return folded;
+}
+
+/* Whether the folded search text matches the characters from @pos on. The
+ * match must end with a character, not in the middle of its folding.
+ */
+static gboolean
+folded_match_at (CountJob    *job,
+		 const gchar *text,
+		 gsize        len,
+		 gsize        pos,
+		 gsize       *end_byte)
+{
+	gsize matched = 0;
+
+	while (matched < job->folded_len)
+	{
+		const gchar *folded;
+		gsize folded_len;
+		gchar ascii;
+
+		if (pos >= len)
+		{
+			return FALSE;
+		}
+
+		folded = fold_char (job, text + pos, &ascii, &folded_len);
+
+		if (folded_len > job->folded_len - matched ||
+		    memcmp (folded, job->folded_text + matched, folded_len) != 0)
+		{
+			return FALSE;
+		}
+
+		matched += folded_len;
+		pos = g_utf8_next_char (text + pos) - text;
+	}
+
+	*end_byte = pos;
+	return TRUE;
+}
+
+/* Finds the first occurrence from @pos, or only at @pos if @anchored. */
+static gboolean
+find_match (CountJob     *job,
+	    LineAttrs    *line,
+	    const gchar  *text,
+	    gsize         len,
+	    gsize         pos,
+	    gboolean      anchored,
+	    GCancellable *cancellable,
+	    gsize        *start_byte,
+	    gsize        *end_byte)
+{
+	guint n_tried = 0;
+
+	while (pos < len)
+	{
+		gboolean found;
+
+		if (job->folded_text != NULL)
+		{
+			if (++n_tried % CANCEL_CHECK_INTERVAL == 0 &&
+			    g_cancellable_is_cancelled (cancellable))
+			{
+				return FALSE;
+			}
+
+			*start_byte = pos;
+			found = folded_match_at (job, text, len, pos, end_byte);
+		}
+		else
+		{
+			GMatchInfo *match_info = NULL;
+			gint match_start;
+			gint match_end;
+
+			if (!g_regex_match_full (job->regex,
+						 text,
+						 len,
+						 pos,
+						 anchored ? G_REGEX_MATCH_ANCHORED : 0,
+						 &match_info,
+						 NULL))
+			{
+				g_match_info_free (match_info);
+				return FALSE;
+			}
+
+			g_match_info_fetch_pos (match_info, 0, &match_start, &match_end);
+			g_match_info_free (match_info);
+
+			*start_byte = match_start;
+			*end_byte = match_end;
+			found = TRUE;
+		}
+
+		if (found &&
+		    (!job->check_word_boundaries ||
+		     (starts_extra_natural_word (line, text, len, *start_byte) &&
+		      ends_extra_natural_word (line, text, len, *end_byte))))
+		{
+			return TRUE;
+		}
+
+		if (anchored)
+		{
+			return FALSE;
+		}
+
+		pos = g_utf8_next_char (text + (found ? *start_byte : pos)) - text;
+	}
+
+	return FALSE;
+}
+
+static void
+publish_matches (CountJob *job,
+		 GArray   *batch)
+{
+	if (batch->len == 0)
+	{
+		return;
+	}
+
+	g_mutex_lock (&job->mutex);
+	g_array_append_vals (job->matches, batch->data, batch->len);
+	g_atomic_int_set (&job->n_matches, job->matches->len);
+	g_mutex_unlock (&job->mutex);
+
+	g_array_set_size (batch, 0);
+}
+
+/* Returns the character offset of the end of the match. */
+static gint
+add_match (CountJob    *job,
+	   GArray      *batch,
+	   const gchar *text,
+	   gsize        start_byte,
+	   gsize        end_byte,
+	   gint         start)
+{
+	Match match;
+
+	match.start_byte = start_byte;
+	match.end_byte = end_byte;
+	match.start = start;
+	match.end = start + g_utf8_strlen (text + start_byte, end_byte - start_byte);
+
+	g_array_append_val (batch, match);
+
+	if (batch->len >= PUBLISH_BATCH_SIZE)
+	{
+		publish_matches (job, batch);
+	}
+
+	return match.end;
+}
+
+static void
+scan_snapshot (CountJob     *job,
+	       GArray       *batch,
+	       GCancellable *cancellable)
+{
+	const gchar *text;
+	gsize len;
+	gsize pos = 0;
+	gsize last_byte = 0;
+	gint last_char = 0;
+	LineAttrs line = { 0 };
+
+	text = g_bytes_get_data (job->snapshot, &len);
+
+	while (pos < len && !g_cancellable_is_cancelled (cancellable))
+	{
+		gsize start_byte;
+		gsize end_byte;
+
+		if (!find_match (job, &line, text, len, pos, FALSE, cancellable,
+				 &start_byte, &end_byte))
+		{
+			break;
+		}
+
+		/* The character offsets are computed incrementally from the
+		 * previous match, so the snapshot is walked only once.
+		 */
+		last_char += g_utf8_strlen (text + last_byte, start_byte - last_byte);
+		last_char = add_match (job, batch, text, start_byte, end_byte, last_char);
+		last_byte = end_byte;
+		pos = end_byte;
+	}
+
+	g_free (line.attrs);
+}
+
+static void
+verify_candidates (CountJob     *job,
+		   GArray       *batch,
+		   GCancellable *cancellable)
+{
+	const gchar *text;
+	gsize len;
+	gsize pos = 0;
+	guint i;
+	LineAttrs line = { 0 };
+
+	text = g_bytes_get_data (job->snapshot, &len);
+
+	for (i = 0; i < job->candidates->len; i++)
+	{
+		const Match *candidate = &g_array_index (job->candidates, Match, i);
+		gsize start_byte;
+		gsize end_byte;
+
+		if (i % PUBLISH_BATCH_SIZE == 0 &&
+		    g_cancellable_is_cancelled (cancellable))
+		{
+			break;
+		}
+
+		/* Overlaps the previous match. */
+		if (candidate->start_byte < pos)
+		{
+			continue;
+		}
+
+		if (find_match (job, &line, text, len, candidate->start_byte, TRUE, cancellable,
+				&start_byte, &end_byte))
+		{
+			/* Anchored, so start_byte is the candidate's. */
+			add_match (job, batch, text, start_byte, end_byte, candidate->start);
+			pos = end_byte;
+		}
+	}
+
+	g_free (line.attrs);
+}
+
+static void
+count_job_thread (GTask        *task,
+		  gpointer      source_object,
+		  gpointer      task_data,
+		  GCancellable *cancellable)
+{
+	CountJob *job = task_data;
+	GArray *batch;
+
+	/* The job owns its snapshot, the counter takes it once the job is
+	 * done.
+	 */
+	if (job->edits != NULL)
+	{
+		GBytes *snapshot = apply_edits (job->snapshot, job->edits);
+
+		g_bytes_unref (job->snapshot);
+		job->snapshot = snapshot;
+	}
+
+	batch = g_array_sized_new (FALSE, FALSE, sizeof (Match), PUBLISH_BATCH_SIZE);
+
+	if (job->candidates != NULL)
+	{
+		verify_candidates (job, batch, cancellable);
+	}
+	else
+	{
+		scan_snapshot (job, batch, cancellable);
+	}
+
+	publish_matches (job, batch);
+	g_array_unref (batch);
+
+	g_task_return_boolean (task, !g_cancellable_is_cancelled (cancellable));
+}
+
+/* Whether the text has a non-empty proper prefix which is also a suffix. If
+ * not, two occurrences of the text can never overlap, so the previous scan
+ * found all of them, not only the non-overlapping ones.
+ */
+static gboolean
+has_border (const gchar *text)
+{
+	gsize len = strlen (text);
+	gsize border_len;
+
+	for (border_len = 1; border_len < len; border_len++)
+	{
+		if (memcmp (text, text + len - border_len, border_len) == 0)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gchar *
+get_comparable_text (const gchar *text,
+		     gboolean     case_sensitive)
+{
+	return case_sensitive ? g_strdup (text) : fold_text (text, -1);
+}
+
+static gboolean
+is_same_search (CountJob *job1,
+		CountJob *job2)
+{
+	return (job1->regex_enabled == job2->regex_enabled &&
+		job1->case_sensitive == job2->case_sensitive &&
+		job1->at_word_boundaries == job2->at_word_boundaries &&
+		g_strcmp0 (job1->search_text, job2->search_text) == 0);
+}
+
+static gboolean
+is_refinement (CountJob *previous_job,
+	       CountJob *job)
+{
+	gchar *previous_text;
+	gchar *text;
+	gboolean ret = FALSE;
+
+	/* With word boundaries, "foo" doesn't match the beginning of
+	 * "foobar", so the matches of "foobar" are not a subset.
+	 */
+	if (previous_job->regex_enabled ||
+	    previous_job->at_word_boundaries ||
+	    previous_job->search_text == NULL ||
+	    previous_job->search_text[0] == '\0' ||
+	    previous_job->case_sensitive != job->case_sensitive ||
+	    job->regex_enabled ||
+	    job->at_word_boundaries)
+	{
+		return FALSE;
+	}
+
+	previous_text = get_comparable_text (previous_job->search_text, job->case_sensitive);
+	text = get_comparable_text (job->search_text, job->case_sensitive);
+
+	if (g_str_has_prefix (text, previous_text) &&
+	    !has_border (previous_text))
+	{
+		ret = TRUE;
+	}
+
+	g_free (previous_text);
+	g_free (text);
+
+	return ret;
+}
+
+static CountJob *
+lookup_cache (GeditSearchCounter *counter,
+	      CountJob           *job)
+{
+	GList *l;
+
+	for (l = counter->cache.head; l != NULL; l = l->next)
+	{
+		CountJob *cached_job = l->data;
+
+		if (is_same_search (cached_job, job))
+		{
+			/* Most recently used first. */
+			g_queue_unlink (&counter->cache, l);
+			g_queue_push_head_link (&counter->cache, l);
+
+			return cached_job;
+		}
+	}
+
+	return NULL;
+}
+
+/* Returns the cached job with the fewest matches that @job refines. */
+static CountJob *
+lookup_refined_job (GeditSearchCounter *counter,
+		    CountJob           *job)
+{
+	CountJob *best = NULL;
+	GList *l;
+
+	for (l = counter->cache.head; l != NULL; l = l->next)
+	{
+		CountJob *cached_job = l->data;
+
+		if (is_refinement (cached_job, job) &&
+		    (best == NULL || cached_job->matches->len < best->matches->len))
+		{
+			best = cached_job;
+		}
+	}
+
+	return best;
+}
+
+static void
+add_to_cache (GeditSearchCounter *counter,
+	      CountJob           *job)
+{
+	g_queue_push_head (&counter->cache, count_job_ref (job));
+	counter->cache_n_matches += job->matches->len;
+
+	while (counter->cache.length > 1 &&
+	       (counter->cache.length > CACHE_MAX_JOBS ||
+		counter->cache_n_matches > CACHE_MAX_MATCHES))
+	{
+		CountJob *oldest_job = g_queue_pop_tail (&counter->cache);
+
+		counter->cache_n_matches -= oldest_job->matches->len;
+		count_job_unref (oldest_job);
+	}
+}
+
+static void
+clear_cache (GeditSearchCounter *counter)
+{
+	g_queue_clear_full (&counter->cache, (GDestroyNotify) count_job_unref);
+	counter->cache_n_matches = 0;
+}
+
+static void
+remove_progress_timeout (GeditSearchCounter *counter)
+{
+	if (counter->progress_timeout_id != 0)
+	{
+		g_source_remove (counter->progress_timeout_id);
+		counter->progress_timeout_id = 0;
+	}
+}
+
+static void
+cancel_job (GeditSearchCounter *counter)
+{
+	if (counter->task != NULL)
+	{
+		g_cancellable_cancel (g_task_get_cancellable (counter->task));
+		g_clear_object (&counter->task);
+	}
+
+	remove_progress_timeout (counter);
+
+	count_job_unref (counter->job);
+	counter->job = NULL;
+}
+
+static gboolean
+progress_timeout_cb (GeditSearchCounter *counter)
+{
+	gint n_matches;
+
+	n_matches = g_atomic_int_get (&counter->job->n_matches);
+
+	if (n_matches != counter->last_notified_count)
+	{
+		counter->last_notified_count = n_matches;
+		g_signal_emit (counter, signals[CHANGED], 0);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+count_job_finished_cb (GeditSearchCounter *counter,
+		       GAsyncResult       *result,
+		       gpointer            user_data)
+{
+	GTask *task = G_TASK (result);
+
+	/* A newer job has been started, or the counter is disposed. */
+	if (task != counter->task ||
+	    !g_task_propagate_boolean (task, NULL))
+	{
+		return;
+	}
+
+	g_clear_object (&counter->task);
+	remove_progress_timeout (counter);
+
+	/* The edits are applied to the snapshot of the job. As the job is
+	 * cancelled by any later edit, there are no others.
+	 */
+	if (counter->job->edits != NULL)
+	{
+		g_bytes_unref (counter->snapshot);
+		counter->snapshot = g_bytes_ref (counter->job->snapshot);
+		g_array_set_size (counter->edits, 0);
+	}
+
+	counter->job->complete = TRUE;
+	add_to_cache (counter, counter->job);
+
+	counter->last_notified_count = counter->job->n_matches;
+	g_signal_emit (counter, signals[CHANGED], 0);
+}
+
+static void
+drop_snapshot (GeditSearchCounter *counter)
+{
+	if (counter->snapshot_idle_id != 0)
+	{
+		g_source_remove (counter->snapshot_idle_id);
+		counter->snapshot_idle_id = 0;
+	}
+
+	if (counter->partial != NULL)
+	{
+		g_string_free (counter->partial, TRUE);
+		counter->partial = NULL;
+	}
+
+	g_clear_pointer (&counter->snapshot, g_bytes_unref);
+	g_array_set_size (counter->edits, 0);
+}
+
+static gboolean
+snapshot_idle_cb (GeditSearchCounter *counter)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	gchar *text;
+
+	gtk_text_buffer_get_iter_at_offset (counter->buffer, &start, counter->partial_end);
+	end = start;
+	gtk_text_iter_forward_chars (&end, SNAPSHOT_CHUNK_CHARS);
+
+	/* With hidden chars, so that the character offsets are the same as in
+	 * the buffer.
+	 */
+	text = gtk_text_buffer_get_slice (counter->buffer, &start, &end, TRUE);
+	g_string_append (counter->partial, text);
+	g_free (text);
+
+	counter->partial_end = gtk_text_iter_get_offset (&end);
+
+	if (!gtk_text_iter_is_end (&end))
+	{
+		return G_SOURCE_CONTINUE;
+	}
+
+	counter->snapshot_idle_id = 0;
+	counter->snapshot = g_string_free_to_bytes (counter->partial);
+	counter->partial = NULL;
+
+	/* The count can be started now. */
+	g_signal_emit (counter, signals[CHANGED], 0);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Returns whether the snapshot is there, otherwise continues copying it. */
+static gboolean
+ensure_snapshot (GeditSearchCounter *counter)
+{
+	if (counter->snapshot != NULL)
+	{
+		return TRUE;
+	}
+
+	if (counter->partial == NULL)
+	{
+		counter->partial = g_string_new (NULL);
+		counter->partial_end = 0;
+	}
+
+	if (counter->snapshot_idle_id == 0)
+	{
+		counter->snapshot_idle_id = g_idle_add ((GSourceFunc) snapshot_idle_cb, counter);
+	}
+
+	return FALSE;
+}
+
+/* Records an edit of the buffer at @offset, to apply it to the snapshot. */
+static void
+record_edit (GeditSearchCounter *counter,
+	     gint                offset,
+	     gint                n_deleted,
+	     const gchar        *text,
+	     gint                len)
+{
+	Edit edit;
+
+	if (counter->snapshot == NULL && counter->partial == NULL)
+	{
+		return;
+	}
+
+	if (counter->partial != NULL)
+	{
+		/* The rest of the buffer is copied as it is after the edit. */
+		if (offset >= counter->partial_end)
+		{
+			return;
+		}
+
+		n_deleted = MIN (n_deleted, counter->partial_end - offset);
+	}
+
+	if (counter->edits->len >= EDITS_MAX)
+	{
+		drop_snapshot (counter);
+		return;
+	}
+
+	edit.offset = offset;
+	edit.n_deleted = n_deleted;
+	edit.text = text != NULL ? g_strndup (text, len) : NULL;
+	g_array_append_val (counter->edits, edit);
+
+	if (counter->partial != NULL)
+	{
+		counter->partial_end += (text != NULL ? g_utf8_strlen (text, len) : 0) - n_deleted;
+	}
+}
+
+static void
+insert_text_cb (GtkTextBuffer      *buffer,
+		GtkTextIter        *location,
+		const gchar        *text,
+		gint                len,
+		GeditSearchCounter *counter)
+{
+	record_edit (counter, gtk_text_iter_get_offset (location), 0, text, len);
+}
+
+/* Pixbufs and child anchors are U+FFFC in the text. */
+static void
+insert_object_cb (GtkTextBuffer      *buffer,
+		  GtkTextIter        *location,
+		  gpointer            object,
+		  GeditSearchCounter *counter)
+{
+	record_edit (counter, gtk_text_iter_get_offset (location), 0, "\xef\xbf\xbc", 3);
+}
+
+static void
+delete_range_cb (GtkTextBuffer      *buffer,
+		 GtkTextIter        *start,
+		 GtkTextIter        *end,
+		 GeditSearchCounter *counter)
+{
+	gint offset = gtk_text_iter_get_offset (start);
+
+	record_edit (counter, offset, gtk_text_iter_get_offset (end) - offset, NULL, 0);
+}
+
+/* Compiled like GtkSourceSearchContext does. */
+static GRegex *
+create_regex (GtkSourceSearchSettings *settings)
+{
+	const gchar *search_text;
+	GRegexCompileFlags flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+	gchar *pattern;
+	GRegex *regex;
+
+	search_text = gtk_source_search_settings_get_search_text (settings);
+
+	if (!gtk_source_search_settings_get_case_sensitive (settings))
+	{
+		flags |= G_REGEX_CASELESS;
+	}
+
+	if (gtk_source_search_settings_get_regex_enabled (settings))
+	{
+		if (gtk_source_search_settings_get_at_word_boundaries (settings))
+		{
+			pattern = g_strdup_printf ("\\b%s\\b", search_text);
+		}
+		else
+		{
+			pattern = g_strdup (search_text);
+		}
+	}
+	else
+	{
+		pattern = g_regex_escape_string (search_text, -1);
+	}
+
+	regex = g_regex_new (pattern, flags, G_REGEX_MATCH_NOTEMPTY, NULL);
+	g_free (pattern);
+
+	return regex;
+}
+
+static CountJob *
+count_job_new (GeditSearchCounter *counter)
+{
+	GtkSourceSearchSettings *settings = counter->settings;
+	CountJob *job;
+
+	job = g_slice_new0 (CountJob);
+	job->ref_count = 1;
+	job->snapshot = g_bytes_ref (counter->snapshot);
+	job->edits = counter->edits->len > 0 ? edits_copy (counter->edits) : NULL;
+	job->search_text = g_strdup (gtk_source_search_settings_get_search_text (settings));
+	job->regex_enabled = gtk_source_search_settings_get_regex_enabled (settings);
+	job->case_sensitive = gtk_source_search_settings_get_case_sensitive (settings);
+	job->at_word_boundaries = gtk_source_search_settings_get_at_word_boundaries (settings);
+	job->check_word_boundaries = job->at_word_boundaries && !job->regex_enabled;
+	job->folds = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+	job->matches = g_array_new (FALSE, FALSE, sizeof (Match));
+	g_mutex_init (&job->mutex);
+
+	return job;
+}
+
+static void
+start_job (GeditSearchCounter *counter)
+{
+	CountJob *job;
+	CountJob *cached_job;
+	CountJob *refined_job;
+	GCancellable *cancellable;
+
+	if (counter->buffer == NULL || counter->settings == NULL)
+	{
+		return;
+	}
+
+	/* Started again once the snapshot is copied. */
+	if (!ensure_snapshot (counter))
+	{
+		return;
+	}
+
+	job = count_job_new (counter);
+	counter->last_notified_count = 0;
+
+	cached_job = lookup_cache (counter, job);
+
+	if (cached_job != NULL)
+	{
+		count_job_unref (job);
+		counter->job = count_job_ref (cached_job);
+		counter->last_notified_count = cached_job->n_matches;
+		return;
+	}
+
+	counter->job = job;
+
+	if (job->search_text == NULL || job->search_text[0] == '\0')
+	{
+		job->complete = TRUE;
+		return;
+	}
+
+	/* Like gtk_text_iter_forward_search(), which GtkSourceSearchContext
+	 * uses for a plain text.
+	 */
+	if (!job->regex_enabled && !job->case_sensitive)
+	{
+		job->folded_text = fold_text (job->search_text, -1);
+		job->folded_len = strlen (job->folded_text);
+	}
+	else
+	{
+		job->regex = create_regex (counter->settings);
+
+		/* An invalid regex has no matches. */
+		if (job->regex == NULL)
+		{
+			job->complete = TRUE;
+			return;
+		}
+	}
+
+	/* The matches of the cached jobs are in the snapshot without the
+	 * edits.
+	 */
+	refined_job = job->edits == NULL ? lookup_refined_job (counter, job) : NULL;
+
+	if (refined_job != NULL)
+	{
+		job->candidates = g_array_ref (refined_job->matches);
+
+		if (job->candidates->len <= SYNC_VERIFY_MAX_CANDIDATES)
+		{
+			GArray *batch;
+
+			batch = g_array_new (FALSE, FALSE, sizeof (Match));
+			verify_candidates (job, batch, NULL);
+			publish_matches (job, batch);
+			g_array_unref (batch);
+
+			job->complete = TRUE;
+			counter->last_notified_count = job->n_matches;
+			add_to_cache (counter, job);
+			return;
+		}
+	}
+
+	cancellable = g_cancellable_new ();
+	counter->task = g_task_new (counter,
+				    cancellable,
+				    (GAsyncReadyCallback) count_job_finished_cb,
+				    NULL);
+	g_object_unref (cancellable);
+
+	g_task_set_task_data (counter->task,
+			      count_job_ref (job),
+			      (GDestroyNotify) count_job_unref);
+
+	g_task_run_in_thread (counter->task, count_job_thread);
+
+	counter->progress_timeout_id = g_timeout_add (PROGRESS_INTERVAL,
+						      (GSourceFunc) progress_timeout_cb,
+						      counter);
+}
+
+static void
+ensure_job (GeditSearchCounter *counter)
+{
+	if (counter->job == NULL && counter->restart_timeout_id == 0)
+	{
+		start_job (counter);
+	}
+}
+
+static void
+invalidate (GeditSearchCounter *counter)
+{
+	cancel_job (counter);
+	g_signal_emit (counter, signals[CHANGED], 0);
+}
+
+static gboolean
+restart_timeout_cb (GeditSearchCounter *counter)
+{
+	counter->restart_timeout_id = 0;
+	g_signal_emit (counter, signals[CHANGED], 0);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+buffer_changed_cb (GtkTextBuffer      *buffer,
+		   GeditSearchCounter *counter)
+{
+	clear_cache (counter);
+
+	/* Don't start a new count on each keystroke. */
+	if (counter->restart_timeout_id != 0)
+	{
+		g_source_remove (counter->restart_timeout_id);
+	}
+
+	counter->restart_timeout_id = g_timeout_add (RESTART_DELAY,
+						     (GSourceFunc) restart_timeout_cb,
+						     counter);
+
+	invalidate (counter);
+}
+
+static void
+gedit_search_counter_dispose (GObject *object)
+{
+	GeditSearchCounter *counter = GEDIT_SEARCH_COUNTER (object);
+
+	cancel_job (counter);
+	clear_cache (counter);
+
+	if (counter->restart_timeout_id != 0)
+	{
+		g_source_remove (counter->restart_timeout_id);
+		counter->restart_timeout_id = 0;
+	}
+
+	if (counter->settings != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (counter->settings,
+						      invalidate,
+						      counter);
+		g_clear_object (&counter->settings);
+	}
+
+	if (counter->buffer != NULL)
+	{
+		g_signal_handlers_disconnect_by_data (counter->buffer, counter);
+		g_object_remove_weak_pointer (G_OBJECT (counter->buffer),
+					      (gpointer *) &counter->buffer);
+		counter->buffer = NULL;
+	}
+
+	drop_snapshot (counter);
+
+	G_OBJECT_CLASS (gedit_search_counter_parent_class)->dispose (object);
+}
+
+static void
+gedit_search_counter_finalize (GObject *object)
+{
+	GeditSearchCounter *counter = GEDIT_SEARCH_COUNTER (object);
+
+	g_array_unref (counter->edits);
+
+	G_OBJECT_CLASS (gedit_search_counter_parent_class)->finalize (object);
+}
+
+static void
+gedit_search_counter_class_init (GeditSearchCounterClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gedit_search_counter_dispose;
+	object_class->finalize = gedit_search_counter_finalize;
+
+	/*
+	 * GeditSearchCounter::changed:
+	 * @counter: the #GeditSearchCounter.
+	 *
+	 * Emitted when the count, complete or partial, may have changed.
+	 */
+	signals[CHANGED] =
+		g_signal_new ("changed",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL, NULL,
+			      G_TYPE_NONE, 0);
+}
+
+static void
+gedit_search_counter_init (GeditSearchCounter *counter)
+{
+	g_queue_init (&counter->cache);
+	counter->edits = edits_new ();
+}
+
+GeditSearchCounter *
+gedit_search_counter_new (GtkTextBuffer *buffer)
+{
+	GeditSearchCounter *counter;
+
+	g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+	counter = g_object_new (GEDIT_TYPE_SEARCH_COUNTER, NULL);
+
+	counter->buffer = buffer;
+	g_object_add_weak_pointer (G_OBJECT (buffer),
+				   (gpointer *) &counter->buffer);
+
+	g_signal_connect (buffer,
+			  "changed",
+			  G_CALLBACK (buffer_changed_cb),
+			  counter);
+
+	/* Before the default handlers, while the iters are at the edit. */
+	g_signal_connect (buffer,
+			  "insert-text",
+			  G_CALLBACK (insert_text_cb),
+			  counter);
+
+	g_signal_connect (buffer,
+			  "insert-pixbuf",
+			  G_CALLBACK (insert_object_cb),
+			  counter);
+
+	g_signal_connect (buffer,
+			  "insert-child-anchor",
+			  G_CALLBACK (insert_object_cb),
+			  counter);
+
+	g_signal_connect (buffer,
+			  "delete-range",
+			  G_CALLBACK (delete_range_cb),
+			  counter);
+
+	return counter;
+}
+
+void
+gedit_search_counter_set_settings (GeditSearchCounter      *counter,
+				   GtkSourceSearchSettings *settings)
+{
+	g_return_if_fail (GEDIT_IS_SEARCH_COUNTER (counter));
+	g_return_if_fail (settings == NULL || GTK_SOURCE_IS_SEARCH_SETTINGS (settings));
+
+	if (counter->settings == settings)
+	{
+		return;
+	}
+
+	if (counter->settings != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (counter->settings,
+						      invalidate,
+						      counter);
+		g_object_unref (counter->settings);
+	}
+
+	counter->settings = settings != NULL ? g_object_ref (settings) : NULL;
+
+	if (settings != NULL)
+	{
+		g_signal_connect_swapped (settings,
+					  "notify",
+					  G_CALLBACK (invalidate),
+					  counter);
+	}
+
+	invalidate (counter);
+}
+
+/**
+ * gedit_search_counter_get_count:
+ * @counter: a #GeditSearchCounter.
+ * @complete: (out) (optional): whether the whole buffer has been scanned.
+ *
+ * Starts counting if needed.
+ *
+ * Returns: the number of occurrences found so far, or -1 if unknown.
+ */
+gint
+gedit_search_counter_get_count (GeditSearchCounter *counter,
+				gboolean           *complete)
+{
+	g_return_val_if_fail (GEDIT_IS_SEARCH_COUNTER (counter), -1);
+
+	if (complete != NULL)
+	{
+		*complete = FALSE;
+	}
+
+	ensure_job (counter);
+
+	if (counter->job == NULL)
+	{
+		return -1;
+	}
+
+	if (complete != NULL)
+	{
+		*complete = counter->job->complete;
+	}
+
+	return g_atomic_int_get (&counter->job->n_matches);
+}
+
+/* Returns the index of the first published match starting at or after
+ * @offset. Must be called with the job's mutex locked.
+ */
+static guint
+find_first_match_from (CountJob *job,
+		       gint      offset)
+{
+	guint low = 0;
+	guint high = job->matches->len;
+
+	while (low < high)
+	{
+		guint middle = low + (high - low) / 2;
+
+		if (g_array_index (job->matches, Match, middle).start < offset)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/**
+ * gedit_search_counter_get_position:
+ * @counter: a #GeditSearchCounter.
+ * @match_start: the start of the occurrence.
+ * @match_end: the end of the occurrence.
+ *
+ * Returns: the position of the occurrence, starting at 1; 0 if
+ * [@match_start, @match_end] is not an occurrence; -1 if it is not yet
+ * known.
+ */
+gint
+gedit_search_counter_get_position (GeditSearchCounter *counter,
+				   const GtkTextIter  *match_start,
+				   const GtkTextIter  *match_end)
+{
+	CountJob *job;
+	gint start;
+	gint end;
+	guint index;
+	gint ret;
+
+	g_return_val_if_fail (GEDIT_IS_SEARCH_COUNTER (counter), -1);
+
+	job = counter->job;
+
+	if (job == NULL)
+	{
+		return -1;
+	}
+
+	start = gtk_text_iter_get_offset (match_start);
+	end = gtk_text_iter_get_offset (match_end);
+
+	g_mutex_lock (&job->mutex);
+
+	index = find_first_match_from (job, start);
+
+	if (index < job->matches->len &&
+	    g_array_index (job->matches, Match, index).start == start)
+	{
+		ret = g_array_index (job->matches, Match, index).end == end ? (gint) index + 1 : 0;
+	}
+	else if (job->complete || index < job->matches->len)
+	{
+		/* The matches are found in order, so there can't be one at
+		 * @start anymore.
+		 */
+		ret = 0;
+	}
+	else
+	{
+		ret = -1;
+	}
+
+	g_mutex_unlock (&job->mutex);
+
+	return ret;
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,45 @@
+/*
+ * gedit-search-counter.h
+ * This file is part of gedit
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEDIT_SEARCH_COUNTER_H
+#define GEDIT_SEARCH_COUNTER_H
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_SEARCH_COUNTER (gedit_search_counter_get_type ())
+G_DECLARE_FINAL_TYPE (GeditSearchCounter, gedit_search_counter, GEDIT, SEARCH_COUNTER, GObject)
+
+GeditSearchCounter	*gedit_search_counter_new		(GtkTextBuffer           *buffer);
+
+void			 gedit_search_counter_set_settings	(GeditSearchCounter      *counter,
+								 GtkSourceSearchSettings *settings);
+
+gint			 gedit_search_counter_get_count		(GeditSearchCounter      *counter,
+								 gboolean                *complete);
+
+gint			 gedit_search_counter_get_position	(GeditSearchCounter      *counter,
+								 const GtkTextIter       *match_start,
+								 const GtkTextIter       *match_end);
+
+G_END_DECLS
+
+#endif /* GEDIT_SEARCH_COUNTER_H */
+
+/* ex:set ts=8 noet: */
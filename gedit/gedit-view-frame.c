@@ -31,6 +31,7 @@
 #include "gedit-debug.h"
 #include "gedit-utils.h"
 #include "gedit-settings.h"
+#include "gedit-search-counter.h"
 #include "libgd/gd.h"
 
 #define FLUSH_TIMEOUT_DURATION 30 /* in seconds */
@@ -77,6 +78,9 @@ struct _GeditViewFrame
 
 	GtkSourceSearchSettings *search_settings;
 
+	/* Counts the occurrences in a worker thread, for the entry tag. */
+	GeditSearchCounter *search_counter;
+
 	/* Used to restore the search state if an incremental search is
 	 * cancelled.
 	 */
@@ -159,6 +163,12 @@ gedit_view_frame_dispose (GObject *object)
 		gtk_source_file_set_mount_operation_factory (file, NULL, NULL, NULL);
 	}
 
+	if (frame->search_counter != NULL)
+	{
+		g_signal_handlers_disconnect_by_data (frame->search_counter, frame);
+		g_clear_object (&frame->search_counter);
+	}
+
 	g_clear_object (&frame->entry_tag);
 	g_clear_object (&frame->search_settings);
 	g_clear_object (&frame->old_search_settings);
@@ -602,6 +612,7 @@ update_entry_tag (GeditViewFrame *frame)
 	GtkTextIter select_end;
 	gint count;
 	gint pos;
+	gboolean complete;
 	gchar *label;
 
 	if (frame->search_mode == GOTO_LINE)
@@ -613,23 +624,28 @@ update_entry_tag (GeditViewFrame *frame)
 
 	search_context = get_search_context (frame);
 
-	if (search_context == NULL)
+	/* Don't count the occurrences while the search widget is hidden, the
+	 * tag is not visible anyway.
+	 */
+	if (search_context == NULL ||
+	    frame->search_counter == NULL ||
+	    !gtk_revealer_get_reveal_child (frame->revealer))
 	{
 		return;
 	}
 
-	count = gtk_source_search_context_get_occurrences_count (search_context);
+	count = gedit_search_counter_get_count (frame->search_counter, &complete);
 
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (frame->view));
 	gtk_text_buffer_get_selection_bounds (buffer, &select_start, &select_end);
 
-	pos = gtk_source_search_context_get_occurrence_position (search_context,
-								 &select_start,
-								 &select_end);
+	pos = gedit_search_counter_get_position (frame->search_counter,
+						 &select_start,
+						 &select_end);
 
 	if (count == -1 || pos == -1)
 	{
-		/* The buffer is not fully scanned. Remove the tag after a short
+		/* The position is not known yet. Remove the tag after a short
 		 * delay. If we don't remove the tag at all, the information can
 		 * be outdated during a too long time (for big buffers). And if
 		 * the tag is removed directly, there is some flashing for small
@@ -661,11 +677,22 @@ update_entry_tag (GeditViewFrame *frame)
 		frame->remove_entry_tag_timeout_id = 0;
 	}
 
-	/* Translators: the first %d is the position of the current search
-	 * occurrence, and the second %d is the total number of search
-	 * occurrences.
-	 */
-	label = g_strdup_printf (_("%d of %d"), pos, count);
+	if (complete)
+	{
+		/* Translators: the first %d is the position of the current
+		 * search occurrence, and the second %d is the total number of
+		 * search occurrences.
+		 */
+		label = g_strdup_printf (_("%d of %d"), pos, count);
+	}
+	else
+	{
+		/* Translators: the first %d is the position of the current
+		 * search occurrence, and the second %d is the number of search
+		 * occurrences found so far, the buffer is still being scanned.
+		 */
+		label = g_strdup_printf (_("%'d of %'d+"), pos, count);
+	}
 
 	gd_tagged_entry_tag_set_label (frame->entry_tag, label);
 
@@ -858,6 +885,12 @@ search_entry_escaped (GtkSearchEntry *entry,
 		gedit_document_set_search_context (GEDIT_DOCUMENT (buffer), search_context);
 		g_object_unref (search_context);
 
+		if (frame->search_counter != NULL)
+		{
+			gedit_search_counter_set_settings (frame->search_counter,
+							   frame->search_settings);
+		}
+
 		g_free (frame->search_text);
 		frame->search_text = NULL;
 
@@ -1264,14 +1297,22 @@ init_search_entry (GeditViewFrame *frame)
 			gedit_document_set_search_context (GEDIT_DOCUMENT (buffer),
 							   search_context);
 
-			g_signal_connect_swapped (search_context,
-						  "notify::occurrences-count",
+			g_object_unref (search_context);
+		}
+
+		if (frame->search_counter == NULL)
+		{
+			frame->search_counter = gedit_search_counter_new (buffer);
+
+			g_signal_connect_swapped (frame->search_counter,
+						  "changed",
 						  G_CALLBACK (install_update_entry_tag_idle),
 						  frame);
-
-			g_object_unref (search_context);
 		}
 
+		gedit_search_counter_set_settings (frame->search_counter,
+						   frame->search_settings);
+
 		selection_exists = get_selected_text (buffer,
 		                                      &search_text,
 		                                      &selection_len);
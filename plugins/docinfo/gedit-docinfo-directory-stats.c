@@ -0,0 +1,535 @@
+/*
+ * gedit-docinfo-directory-stats.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The statistics of a directory are the sum of the statistics of the text
+ * files below it. A worker thread walks the tree and queues the files in a
+ * thread pool, which reads and counts them in parallel. The totals are
+ * shared under a mutex, so that partial results can be shown while the
+ * count is in progress.
+ *
+ * Hidden and backup files are skipped, like in the file browser, and
+ * symbolic links are not followed.
+ */
+
+#include "gedit-docinfo-directory-stats.h"
+
+#include <string.h>
+
+#define ENUMERATE_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+			     G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+			     G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+			     G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+			     G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+
+#define READ_BUFFER_SIZE 65536
+
+/* In milliseconds. */
+#define PROGRESS_INTERVAL 250
+
+/* Shared with the worker threads. */
+typedef struct
+{
+	GFile *location;
+	GCancellable *cancellable;
+
+	GMutex mutex;
+	GeditDocinfoCounts totals;
+	guint n_files;
+
+	/* Content type -> GeditDocinfoCounts */
+	GHashTable *content_types;
+} CountData;
+
+typedef struct
+{
+	GFile *file;
+	gchar *content_type;
+} FileJob;
+
+struct _GeditDocinfoDirectoryStats
+{
+	GCancellable *cancellable;
+	GTask *task;
+
+	guint progress_id;
+
+	GeditDocinfoDirectoryStatsFunc func;
+	gpointer user_data;
+};
+
+static CountData *
+count_data_new (GFile        *location,
+		GCancellable *cancellable)
+{
+	CountData *data;
+
+	data = g_slice_new0 (CountData);
+	data->location = g_object_ref (location);
+	data->cancellable = g_object_ref (cancellable);
+	data->content_types = g_hash_table_new_full (g_str_hash,
+						     g_str_equal,
+						     g_free,
+						     g_free);
+	g_mutex_init (&data->mutex);
+
+	return data;
+}
+
+static void
+count_data_free (CountData *data)
+{
+	g_object_unref (data->location);
+	g_object_unref (data->cancellable);
+	g_hash_table_unref (data->content_types);
+	g_mutex_clear (&data->mutex);
+
+	g_slice_free (CountData, data);
+}
+
+static void
+file_job_free (FileJob *job)
+{
+	g_object_unref (job->file);
+	g_free (job->content_type);
+
+	g_slice_free (FileJob, job);
+}
+
+static gboolean
+content_type_is_text (const gchar *content_type)
+{
+	/* Unknown files are checked for NUL bytes when read. */
+	if (content_type == NULL || g_content_type_is_unknown (content_type))
+	{
+		return TRUE;
+	}
+
+	return g_content_type_is_a (content_type, "text/plain");
+}
+
+/* Returns the length of @buffer without a UTF-8 sequence cut at the end,
+ * which is kept for the next read.
+ */
+static gsize
+get_complete_length (const guchar *buffer,
+		     gsize         len)
+{
+	gsize i;
+
+	for (i = 1; i <= 3 && i <= len; i++)
+	{
+		guchar c = buffer[len - i];
+		gsize seq_len;
+
+		if ((c & 0xC0) == 0x80)
+		{
+			continue;
+		}
+
+		if (c < 0xC0)
+		{
+			return len;
+		}
+
+		seq_len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+
+		return seq_len > i ? len - i : len;
+	}
+
+	return len;
+}
+
+static gboolean
+count_file (FileJob            *job,
+	    GCancellable       *cancellable,
+	    GeditDocinfoCounts *counts)
+{
+	GFileInputStream *stream;
+	guchar *buffer;
+	gsize carry = 0;
+	gunichar prev_chars[2] = { 0, 0 };
+	gboolean first_read = TRUE;
+	gboolean ret = TRUE;
+
+	stream = g_file_read (job->file, cancellable, NULL);
+
+	if (stream == NULL)
+	{
+		return FALSE;
+	}
+
+	buffer = g_malloc (READ_BUFFER_SIZE);
+
+	while (TRUE)
+	{
+		gssize n_read;
+		gsize len;
+		gsize complete;
+
+		n_read = g_input_stream_read (G_INPUT_STREAM (stream),
+					      buffer + carry,
+					      READ_BUFFER_SIZE - carry,
+					      cancellable,
+					      NULL);
+
+		if (n_read <= 0)
+		{
+			ret = n_read == 0;
+			break;
+		}
+
+		/* Same heuristic as for the content type: binary files
+		 * have NUL bytes near the beginning.
+		 */
+		if (first_read && memchr (buffer, '\0', n_read) != NULL)
+		{
+			ret = FALSE;
+			break;
+		}
+
+		first_read = FALSE;
+
+		len = carry + n_read;
+		complete = get_complete_length (buffer, len);
+
+		gedit_docinfo_counts_add_text (counts,
+					       (const gchar *) buffer,
+					       complete,
+					       prev_chars);
+
+		carry = len - complete;
+		memmove (buffer, buffer + complete, carry);
+	}
+
+	if (ret)
+	{
+		if (carry > 0)
+		{
+			gedit_docinfo_counts_add_text (counts,
+						       (const gchar *) buffer,
+						       carry,
+						       prev_chars);
+		}
+
+		/* The last line, if not terminated. */
+		if (counts->chars > 0 && prev_chars[0] != '\n')
+		{
+			counts->lines++;
+		}
+	}
+
+	g_free (buffer);
+	g_input_stream_close (G_INPUT_STREAM (stream), NULL, NULL);
+	g_object_unref (stream);
+
+	return ret;
+}
+
+static void
+count_file_func (gpointer job_data,
+		 gpointer user_data)
+{
+	FileJob *job = job_data;
+	CountData *data = user_data;
+	GeditDocinfoCounts counts = { 0 };
+
+	if (!g_cancellable_is_cancelled (data->cancellable) &&
+	    count_file (job, data->cancellable, &counts))
+	{
+		GeditDocinfoCounts *type_counts;
+
+		g_mutex_lock (&data->mutex);
+
+		gedit_docinfo_counts_add (&data->totals, &counts);
+		data->n_files++;
+
+		type_counts = g_hash_table_lookup (data->content_types, job->content_type);
+
+		if (type_counts == NULL)
+		{
+			type_counts = g_new0 (GeditDocinfoCounts, 1);
+			g_hash_table_insert (data->content_types,
+					     g_strdup (job->content_type),
+					     type_counts);
+		}
+
+		gedit_docinfo_counts_add (type_counts, &counts);
+
+		g_mutex_unlock (&data->mutex);
+	}
+
+	file_job_free (job);
+}
+
+static void
+enumerate_directory (GFile        *dir,
+		     GQueue       *dirs,
+		     GThreadPool  *pool,
+		     GCancellable *cancellable)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+
+	enumerator = g_file_enumerate_children (dir,
+						ENUMERATE_ATTRIBUTES,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						cancellable,
+						NULL);
+
+	if (enumerator == NULL)
+	{
+		return;
+	}
+
+	while ((info = g_file_enumerator_next_file (enumerator, cancellable, NULL)) != NULL)
+	{
+		GFileType type = g_file_info_get_file_type (info);
+		const gchar *content_type;
+
+		if (g_file_info_get_is_hidden (info) ||
+		    g_file_info_get_is_backup (info))
+		{
+			g_object_unref (info);
+			continue;
+		}
+
+		content_type = g_file_info_get_attribute_string (info,
+								 G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+
+		if (type == G_FILE_TYPE_DIRECTORY)
+		{
+			g_queue_push_tail (dirs, g_file_enumerator_get_child (enumerator, info));
+		}
+		else if (type == G_FILE_TYPE_REGULAR && content_type_is_text (content_type))
+		{
+			FileJob *job;
+
+			job = g_slice_new (FileJob);
+			job->file = g_file_enumerator_get_child (enumerator, info);
+			job->content_type = g_strdup (content_type != NULL ? content_type : "text/plain");
+
+			g_thread_pool_push (pool, job, NULL);
+		}
+
+		g_object_unref (info);
+	}
+
+	g_object_unref (enumerator);
+}
+
+static void
+count_directory_thread (GTask        *task,
+			gpointer      source_object,
+			gpointer      task_data,
+			GCancellable *cancellable)
+{
+	CountData *data = task_data;
+	GThreadPool *pool;
+	GQueue dirs = G_QUEUE_INIT;
+	GFile *dir;
+
+	pool = g_thread_pool_new (count_file_func,
+				  data,
+				  g_get_num_processors (),
+				  FALSE,
+				  NULL);
+
+	g_queue_push_tail (&dirs, g_object_ref (data->location));
+
+	while ((dir = g_queue_pop_head (&dirs)) != NULL)
+	{
+		if (!g_cancellable_is_cancelled (cancellable))
+		{
+			enumerate_directory (dir, &dirs, pool, cancellable);
+		}
+
+		g_object_unref (dir);
+	}
+
+	/* Wait for the files already queued. */
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	if (g_task_return_error_if_cancelled (task))
+	{
+		return;
+	}
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+count_directory_finished_cb (GObject      *source_object,
+			     GAsyncResult *result,
+			     gpointer      user_data)
+{
+	GeditDocinfoDirectoryStats *stats;
+
+	/* The stats are freed if the task has been cancelled. */
+	if (!g_task_propagate_boolean (G_TASK (result), NULL))
+	{
+		return;
+	}
+
+	stats = user_data;
+
+	if (stats->progress_id != 0)
+	{
+		g_source_remove (stats->progress_id);
+		stats->progress_id = 0;
+	}
+
+	stats->func (stats, TRUE, stats->user_data);
+}
+
+static gboolean
+progress_cb (gpointer user_data)
+{
+	GeditDocinfoDirectoryStats *stats = user_data;
+
+	stats->func (stats, FALSE, stats->user_data);
+
+	return G_SOURCE_CONTINUE;
+}
+
+/**
+ * gedit_docinfo_directory_stats_new:
+ * @location: the directory.
+ * @func: called periodically with partial totals, and when finished.
+ * @user_data: user data for @func.
+ *
+ * Starts counting the text files below @location.
+ */
+GeditDocinfoDirectoryStats *
+gedit_docinfo_directory_stats_new (GFile                          *location,
+				   GeditDocinfoDirectoryStatsFunc  func,
+				   gpointer                        user_data)
+{
+	GeditDocinfoDirectoryStats *stats;
+
+	g_return_val_if_fail (G_IS_FILE (location), NULL);
+	g_return_val_if_fail (func != NULL, NULL);
+
+	stats = g_slice_new0 (GeditDocinfoDirectoryStats);
+	stats->cancellable = g_cancellable_new ();
+	stats->func = func;
+	stats->user_data = user_data;
+
+	stats->task = g_task_new (NULL,
+				  stats->cancellable,
+				  count_directory_finished_cb,
+				  stats);
+	g_task_set_task_data (stats->task,
+			      count_data_new (location, stats->cancellable),
+			      (GDestroyNotify) count_data_free);
+
+	g_task_run_in_thread (stats->task, count_directory_thread);
+
+	stats->progress_id = g_timeout_add (PROGRESS_INTERVAL, progress_cb, stats);
+
+	return stats;
+}
+
+void
+gedit_docinfo_directory_stats_free (GeditDocinfoDirectoryStats *stats)
+{
+	if (stats == NULL)
+	{
+		return;
+	}
+
+	if (stats->progress_id != 0)
+	{
+		g_source_remove (stats->progress_id);
+	}
+
+	/* The task keeps the shared data alive until the threads are done. */
+	g_cancellable_cancel (stats->cancellable);
+	g_object_unref (stats->task);
+	g_object_unref (stats->cancellable);
+
+	g_slice_free (GeditDocinfoDirectoryStats, stats);
+}
+
+/**
+ * gedit_docinfo_directory_stats_get_counts:
+ * @stats: a #GeditDocinfoDirectoryStats.
+ * @counts: (out): the totals of the files counted so far.
+ *
+ * Returns: the number of files counted so far.
+ */
+guint
+gedit_docinfo_directory_stats_get_counts (GeditDocinfoDirectoryStats *stats,
+					  GeditDocinfoCounts         *counts)
+{
+	CountData *data;
+	guint n_files;
+
+	g_return_val_if_fail (stats != NULL, 0);
+	g_return_val_if_fail (counts != NULL, 0);
+
+	data = g_task_get_task_data (stats->task);
+
+	g_mutex_lock (&data->mutex);
+	*counts = data->totals;
+	n_files = data->n_files;
+	g_mutex_unlock (&data->mutex);
+
+	return n_files;
+}
+
+/**
+ * gedit_docinfo_directory_stats_get_content_types:
+ * @stats: a #GeditDocinfoDirectoryStats.
+ *
+ * Returns: (transfer full): a new hash table from the content types of the
+ * files counted so far to their #GeditDocinfoCounts.
+ */
+GHashTable *
+gedit_docinfo_directory_stats_get_content_types (GeditDocinfoDirectoryStats *stats)
+{
+	CountData *data;
+	GHashTable *content_types;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+
+	g_return_val_if_fail (stats != NULL, NULL);
+
+	content_types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	data = g_task_get_task_data (stats->task);
+
+	g_mutex_lock (&data->mutex);
+
+	g_hash_table_iter_init (&iter, data->content_types);
+
+	while (g_hash_table_iter_next (&iter, &key, &value))
+	{
+		GeditDocinfoCounts *counts = g_new (GeditDocinfoCounts, 1);
+
+		*counts = *(GeditDocinfoCounts *)value;
+		g_hash_table_insert (content_types, g_strdup (key), counts);
+	}
+
+	g_mutex_unlock (&data->mutex);
+
+	return content_types;
+}
+
+/* ex:set ts=8 noet: */
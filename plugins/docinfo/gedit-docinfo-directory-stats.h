@@ -0,0 +1,51 @@
+/*
+ * gedit-docinfo-directory-stats.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef GEDIT_DOCINFO_DIRECTORY_STATS_H
+#define GEDIT_DOCINFO_DIRECTORY_STATS_H
+
+#include <gio/gio.h>
+
+#include "gedit-docinfo-stats.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GeditDocinfoDirectoryStats GeditDocinfoDirectoryStats;
+
+typedef void (* GeditDocinfoDirectoryStatsFunc) (GeditDocinfoDirectoryStats *stats,
+						 gboolean                    finished,
+						 gpointer                    user_data);
+
+GeditDocinfoDirectoryStats *
+			 gedit_docinfo_directory_stats_new		(GFile                          *location,
+									 GeditDocinfoDirectoryStatsFunc  func,
+									 gpointer                        user_data);
+
+void			 gedit_docinfo_directory_stats_free		(GeditDocinfoDirectoryStats     *stats);
+
+guint			 gedit_docinfo_directory_stats_get_counts	(GeditDocinfoDirectoryStats     *stats,
+									 GeditDocinfoCounts             *counts);
+
+GHashTable		*gedit_docinfo_directory_stats_get_content_types
+									(GeditDocinfoDirectoryStats     *stats);
+
+G_END_DECLS
+
+#endif /* GEDIT_DOCINFO_DIRECTORY_STATS_H */
+
+/* ex:set ts=8 noet: */
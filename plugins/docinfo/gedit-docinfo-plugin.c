@@ -25,7 +25,6 @@
 #include <string.h> /* For strlen (...) */
 
 #include <glib/gi18n.h>
-#include <pango/pango-break.h>
 #include <gmodule.h>
 
 #include <gedit/gedit-app.h>
@@ -36,6 +35,11 @@
 #include <gedit/gedit-app-activatable.h>
 #include <gedit/gedit-window-activatable.h>
 
+#include "gedit-docinfo-stats.h"
+#include "gedit-docinfo-directory-stats.h"
+
+#define RESPONSE_DIRECTORY 1
+
 struct _GeditDocinfoPluginPrivate
 {
 	GeditWindow *window;
@@ -61,6 +65,21 @@ struct _GeditDocinfoPluginPrivate
 	GtkWidget *selected_chars_label;
 	GtkWidget *selected_chars_ns_label;
 	GtkWidget *selected_bytes_label;
+	GtkWidget *directory_label;
+	GtkWidget *directory_lines_label;
+	GtkWidget *directory_words_label;
+	GtkWidget *directory_chars_label;
+	GtkWidget *directory_chars_ns_label;
+	GtkWidget *directory_bytes_label;
+	GtkWidget *directory_languages_label;
+
+	/* GeditDocument -> GeditDocinfoDocumentStats, for the documents of
+	 * the window shown in the dialog at least once.
+	 */
+	GHashTable *document_stats;
+
+	/* The directory selected in the file browser, if requested. */
+	GeditDocinfoDirectoryStats *directory_stats;
 
 	GeditApp  *app;
 	GeditMenuExtension *menu_ext;
@@ -87,15 +106,13 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditDocinfoPlugin,
 				G_ADD_PRIVATE_DYNAMIC (GeditDocinfoPlugin))
 
 static void
-calculate_info (GeditDocument *doc,
-		GtkTextIter   *start,
-		GtkTextIter   *end,
-		gint          *chars,
-		gint          *words,
-		gint          *white_chars,
-		gint          *bytes)
+calculate_info (GeditDocument      *doc,
+		GtkTextIter        *start,
+		GtkTextIter        *end,
+		GeditDocinfoCounts *counts)
 {
 	gchar *text;
+	gunichar prev_chars[2] = { 0, 0 };
 
 	gedit_debug (DEBUG_PLUGINS);
 
@@ -104,41 +121,56 @@ calculate_info (GeditDocument *doc,
 					  end,
 					  TRUE);
 
-	*chars = g_utf8_strlen (text, -1);
-	*bytes = strlen (text);
+	gedit_docinfo_counts_add_text (counts, text, strlen (text), prev_chars);
 
-	if (*chars > 0)
-	{
-		PangoLogAttr *attrs;
-		gint i;
+	g_free (text);
+}
 
-		attrs = g_new0 (PangoLogAttr, *chars + 1);
+static void
+set_count_label (GtkWidget *label,
+		 gint64     count)
+{
+	gchar *tmp_str;
 
-		pango_get_log_attrs (text,
-				     -1,
-				     0,
-				     pango_language_from_string ("C"),
-				     attrs,
-				     *chars + 1);
+	tmp_str = g_strdup_printf ("%" G_GINT64_FORMAT, count);
+	gtk_label_set_text (GTK_LABEL (label), tmp_str);
+	g_free (tmp_str);
+}
 
-		for (i = 0; i < (*chars); i++)
-		{
-			if (attrs[i].is_white)
-				++(*white_chars);
+static void update_document_info (GeditDocinfoPlugin *plugin,
+				  GeditDocument      *doc);
 
-			if (attrs[i].is_word_start)
-				++(*words);
-		}
+static void
+document_stats_ready_cb (GeditDocinfoDocumentStats *stats,
+			 GeditDocument             *doc,
+			 gpointer                   user_data)
+{
+	GeditDocinfoPlugin *plugin = GEDIT_DOCINFO_PLUGIN (user_data);
 
-		g_free (attrs);
+	if (plugin->priv->dialog != NULL &&
+	    gedit_window_get_active_document (plugin->priv->window) == doc)
+	{
+		update_document_info (plugin, doc);
 	}
-	else
+}
+
+static GeditDocinfoDocumentStats *
+get_document_stats (GeditDocinfoPlugin *plugin,
+		    GeditDocument      *doc)
+{
+	GeditDocinfoDocumentStats *stats;
+
+	stats = g_hash_table_lookup (plugin->priv->document_stats, doc);
+
+	if (stats == NULL)
 	{
-		*white_chars = 0;
-		*words = 0;
+		stats = gedit_docinfo_document_stats_new (doc,
+							  document_stats_ready_cb,
+							  plugin);
+		g_hash_table_insert (plugin->priv->document_stats, doc, stats);
 	}
 
-	g_free (text);
+	return stats;
 }
 
 static void
@@ -146,63 +178,45 @@ update_document_info (GeditDocinfoPlugin *plugin,
 		      GeditDocument      *doc)
 {
 	GeditDocinfoPluginPrivate *priv;
-	GtkTextIter start, end;
-	gint words = 0;
-	gint chars = 0;
-	gint white_chars = 0;
-	gint lines = 0;
-	gint bytes = 0;
+	GeditDocinfoDocumentStats *stats;
+	GeditDocinfoCounts counts;
 	gchar *doc_name;
-	gchar *tmp_str;
 
 	gedit_debug (DEBUG_PLUGINS);
 
 	priv = plugin->priv;
 
-	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc),
-				    &start,
-				    &end);
-
-	lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (doc));
-
-	calculate_info (doc,
-			&start, &end,
-			&chars, &words, &white_chars, &bytes);
-
-	if (chars == 0)
-	{
-		lines = 0;
-	}
-
-	gedit_debug_message (DEBUG_PLUGINS, "Chars: %d", chars);
-	gedit_debug_message (DEBUG_PLUGINS, "Lines: %d", lines);
-	gedit_debug_message (DEBUG_PLUGINS, "Words: %d", words);
-	gedit_debug_message (DEBUG_PLUGINS, "Chars non-space: %d", chars - white_chars);
-	gedit_debug_message (DEBUG_PLUGINS, "Bytes: %d", bytes);
-
 	doc_name = gedit_document_get_short_name_for_display (doc);
 	gtk_header_bar_set_subtitle (GTK_HEADER_BAR (priv->header_bar), doc_name);
 	g_free (doc_name);
 
-	tmp_str = g_strdup_printf("%d", lines);
-	gtk_label_set_text (GTK_LABEL (priv->document_lines_label), tmp_str);
-	g_free (tmp_str);
+	stats = get_document_stats (plugin, doc);
 
-	tmp_str = g_strdup_printf("%d", words);
-	gtk_label_set_text (GTK_LABEL (priv->document_words_label), tmp_str);
-	g_free (tmp_str);
+	if (!gedit_docinfo_document_stats_get_counts (stats, &counts))
+	{
+		/* Updated by document_stats_ready_cb(). */
+		gedit_debug_message (DEBUG_PLUGINS, "Counting in progress");
 
-	tmp_str = g_strdup_printf("%d", chars);
-	gtk_label_set_text (GTK_LABEL (priv->document_chars_label), tmp_str);
-	g_free (tmp_str);
+		gtk_label_set_text (GTK_LABEL (priv->document_lines_label), "…");
+		gtk_label_set_text (GTK_LABEL (priv->document_words_label), "…");
+		gtk_label_set_text (GTK_LABEL (priv->document_chars_label), "…");
+		gtk_label_set_text (GTK_LABEL (priv->document_chars_ns_label), "…");
+		gtk_label_set_text (GTK_LABEL (priv->document_bytes_label), "…");
 
-	tmp_str = g_strdup_printf("%d", chars - white_chars);
-	gtk_label_set_text (GTK_LABEL (priv->document_chars_ns_label), tmp_str);
-	g_free (tmp_str);
+		return;
+	}
 
-	tmp_str = g_strdup_printf("%d", bytes);
-	gtk_label_set_text (GTK_LABEL (priv->document_bytes_label), tmp_str);
-	g_free (tmp_str);
+	gedit_debug_message (DEBUG_PLUGINS, "Chars: %" G_GINT64_FORMAT, counts.chars);
+	gedit_debug_message (DEBUG_PLUGINS, "Lines: %" G_GINT64_FORMAT, counts.lines);
+	gedit_debug_message (DEBUG_PLUGINS, "Words: %" G_GINT64_FORMAT, counts.words);
+	gedit_debug_message (DEBUG_PLUGINS, "Chars non-space: %" G_GINT64_FORMAT, counts.chars - counts.white_chars);
+	gedit_debug_message (DEBUG_PLUGINS, "Bytes: %" G_GINT64_FORMAT, counts.bytes);
+
+	set_count_label (priv->document_lines_label, counts.lines);
+	set_count_label (priv->document_words_label, counts.words);
+	set_count_label (priv->document_chars_label, counts.chars);
+	set_count_label (priv->document_chars_ns_label, counts.chars - counts.white_chars);
+	set_count_label (priv->document_bytes_label, counts.bytes);
 }
 
 static void
@@ -212,12 +226,8 @@ update_selection_info (GeditDocinfoPlugin *plugin,
 	GeditDocinfoPluginPrivate *priv;
 	gboolean sel;
 	GtkTextIter start, end;
-	gint words = 0;
-	gint chars = 0;
-	gint white_chars = 0;
-	gint lines = 0;
-	gint bytes = 0;
-	gchar *tmp_str;
+	GeditDocinfoCounts counts = { 0 };
+	gint64 lines = 0;
 
 	gedit_debug (DEBUG_PLUGINS);
 
@@ -229,17 +239,27 @@ update_selection_info (GeditDocinfoPlugin *plugin,
 
 	if (sel)
 	{
+		GeditDocinfoDocumentStats *stats;
+
 		lines = gtk_text_iter_get_line (&end) - gtk_text_iter_get_line (&start) + 1;
 
-		calculate_info (doc,
-				&start, &end,
-				&chars, &words, &white_chars, &bytes);
+		stats = g_hash_table_lookup (priv->document_stats, doc);
+
+		/* Select All: no need to count again. */
+		if (!gtk_text_iter_is_start (&start) ||
+		    !gtk_text_iter_is_end (&end) ||
+		    stats == NULL ||
+		    !gedit_docinfo_document_stats_get_counts (stats, &counts))
+		{
+			memset (&counts, 0, sizeof (GeditDocinfoCounts));
+			calculate_info (doc, &start, &end, &counts);
+		}
 
-		gedit_debug_message (DEBUG_PLUGINS, "Selected chars: %d", chars);
-		gedit_debug_message (DEBUG_PLUGINS, "Selected lines: %d", lines);
-		gedit_debug_message (DEBUG_PLUGINS, "Selected words: %d", words);
-		gedit_debug_message (DEBUG_PLUGINS, "Selected chars non-space: %d", chars - white_chars);
-		gedit_debug_message (DEBUG_PLUGINS, "Selected bytes: %d", bytes);
+		gedit_debug_message (DEBUG_PLUGINS, "Selected chars: %" G_GINT64_FORMAT, counts.chars);
+		gedit_debug_message (DEBUG_PLUGINS, "Selected lines: %" G_GINT64_FORMAT, lines);
+		gedit_debug_message (DEBUG_PLUGINS, "Selected words: %" G_GINT64_FORMAT, counts.words);
+		gedit_debug_message (DEBUG_PLUGINS, "Selected chars non-space: %" G_GINT64_FORMAT, counts.chars - counts.white_chars);
+		gedit_debug_message (DEBUG_PLUGINS, "Selected bytes: %" G_GINT64_FORMAT, counts.bytes);
 
 		gtk_widget_set_sensitive (priv->selection_label, TRUE);
 		gtk_widget_set_sensitive (priv->selected_words_label, TRUE);
@@ -260,28 +280,227 @@ update_selection_info (GeditDocinfoPlugin *plugin,
 		gtk_widget_set_sensitive (priv->selected_chars_ns_label, FALSE);
 	}
 
-	if (chars == 0)
+	if (counts.chars == 0)
 		lines = 0;
 
-	tmp_str = g_strdup_printf("%d", lines);
-	gtk_label_set_text (GTK_LABEL (priv->selected_lines_label), tmp_str);
-	g_free (tmp_str);
+	set_count_label (priv->selected_lines_label, lines);
+	set_count_label (priv->selected_words_label, counts.words);
+	set_count_label (priv->selected_chars_label, counts.chars);
+	set_count_label (priv->selected_chars_ns_label, counts.chars - counts.white_chars);
+	set_count_label (priv->selected_bytes_label, counts.bytes);
+}
 
-	tmp_str = g_strdup_printf("%d", words);
-	gtk_label_set_text (GTK_LABEL (priv->selected_words_label), tmp_str);
-	g_free (tmp_str);
+static gint
+compare_language_lines (gconstpointer a,
+			gconstpointer b,
+			gpointer      user_data)
+{
+	GHashTable *languages = user_data;
+	const GeditDocinfoCounts *counts_a = g_hash_table_lookup (languages, a);
+	const GeditDocinfoCounts *counts_b = g_hash_table_lookup (languages, b);
 
-	tmp_str = g_strdup_printf("%d", chars);
-	gtk_label_set_text (GTK_LABEL (priv->selected_chars_label), tmp_str);
-	g_free (tmp_str);
+	if (counts_a->lines != counts_b->lines)
+	{
+		return counts_a->lines > counts_b->lines ? -1 : 1;
+	}
 
-	tmp_str = g_strdup_printf("%d", chars - white_chars);
-	gtk_label_set_text (GTK_LABEL (priv->selected_chars_ns_label), tmp_str);
-	g_free (tmp_str);
+	return g_utf8_collate (a, b);
+}
 
-	tmp_str = g_strdup_printf("%d", bytes);
-	gtk_label_set_text (GTK_LABEL (priv->selected_bytes_label), tmp_str);
-	g_free (tmp_str);
+/* Several content types can map to the same language. */
+static GHashTable *
+get_directory_languages (GeditDocinfoDirectoryStats *stats)
+{
+	GtkSourceLanguageManager *manager;
+	GHashTable *content_types;
+	GHashTable *languages;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+
+	manager = gtk_source_language_manager_get_default ();
+	content_types = gedit_docinfo_directory_stats_get_content_types (stats);
+	languages = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	g_hash_table_iter_init (&iter, content_types);
+
+	while (g_hash_table_iter_next (&iter, &key, &value))
+	{
+		GtkSourceLanguage *language;
+		const gchar *name;
+		GeditDocinfoCounts *counts;
+
+		language = gtk_source_language_manager_guess_language (manager, NULL, key);
+		name = language != NULL ? gtk_source_language_get_name (language) : _("Plain Text");
+
+		counts = g_hash_table_lookup (languages, name);
+
+		if (counts == NULL)
+		{
+			counts = g_new0 (GeditDocinfoCounts, 1);
+			g_hash_table_insert (languages, g_strdup (name), counts);
+		}
+
+		gedit_docinfo_counts_add (counts, value);
+	}
+
+	g_hash_table_unref (content_types);
+
+	return languages;
+}
+
+static void
+update_directory_info (GeditDocinfoPlugin *plugin,
+		       gboolean            finished)
+{
+	GeditDocinfoPluginPrivate *priv;
+	GeditDocinfoCounts counts;
+	GHashTable *languages;
+	GList *names;
+	GList *l;
+	GString *str;
+	guint n_files;
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	priv = plugin->priv;
+
+	n_files = gedit_docinfo_directory_stats_get_counts (priv->directory_stats, &counts);
+
+	set_count_label (priv->directory_lines_label, counts.lines);
+	set_count_label (priv->directory_words_label, counts.words);
+	set_count_label (priv->directory_chars_label, counts.chars);
+	set_count_label (priv->directory_chars_ns_label, counts.chars - counts.white_chars);
+	set_count_label (priv->directory_bytes_label, counts.bytes);
+
+	str = g_string_new (NULL);
+	g_string_append_printf (str,
+				ngettext ("%u text file", "%u text files", n_files),
+				n_files);
+
+	if (!finished)
+	{
+		g_string_append (str, "…");
+	}
+
+	languages = get_directory_languages (priv->directory_stats);
+	names = g_list_sort_with_data (g_hash_table_get_keys (languages),
+				       compare_language_lines,
+				       languages);
+
+	for (l = names; l != NULL; l = l->next)
+	{
+		const GeditDocinfoCounts *language_counts;
+		gchar *lines;
+
+		language_counts = g_hash_table_lookup (languages, l->data);
+		lines = g_strdup_printf ("%" G_GINT64_FORMAT, language_counts->lines);
+
+		g_string_append_c (str, '\n');
+		g_string_append_printf (str,
+					/* Translators: the first %s is a language
+					 * name, the second one a number of lines. */
+					ngettext ("%s: %s line", "%s: %s lines",
+						  (gulong) language_counts->lines),
+					(const gchar *) l->data,
+					lines);
+
+		g_free (lines);
+	}
+
+	g_list_free (names);
+	g_hash_table_unref (languages);
+
+	gtk_label_set_text (GTK_LABEL (priv->directory_languages_label), str->str);
+	g_string_free (str, TRUE);
+}
+
+static void
+directory_stats_cb (GeditDocinfoDirectoryStats *stats,
+		    gboolean                    finished,
+		    gpointer                    user_data)
+{
+	update_directory_info (GEDIT_DOCINFO_PLUGIN (user_data), finished);
+}
+
+static GFile *
+get_file_browser_directory (GeditDocinfoPlugin *plugin)
+{
+	GeditMessageBus *bus;
+	GeditMessage *message;
+	GFile *location = NULL;
+
+	bus = gedit_window_get_message_bus (plugin->priv->window);
+
+	if (!gedit_message_bus_is_registered (bus,
+					      "/plugins/filebrowser",
+					      "get_selected_directory"))
+	{
+		return NULL;
+	}
+
+	message = gedit_message_bus_send_sync (bus,
+					       "/plugins/filebrowser",
+					       "get_selected_directory",
+					       NULL);
+
+	g_object_get (message, "location", &location, NULL);
+	g_object_unref (message);
+
+	return location;
+}
+
+static void
+count_directory (GeditDocinfoPlugin *plugin)
+{
+	GeditDocinfoPluginPrivate *priv;
+	GFile *location;
+	gchar *name;
+	gchar *parse_name;
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	priv = plugin->priv;
+
+	location = get_file_browser_directory (plugin);
+
+	if (location == NULL)
+	{
+		gedit_debug_message (DEBUG_PLUGINS, "No directory in the file browser");
+		return;
+	}
+
+	gedit_docinfo_directory_stats_free (priv->directory_stats);
+	priv->directory_stats = gedit_docinfo_directory_stats_new (location,
+								   directory_stats_cb,
+								   plugin);
+
+	name = g_file_get_basename (location);
+	parse_name = g_file_get_parse_name (location);
+	gtk_label_set_text (GTK_LABEL (priv->directory_label), name);
+	gtk_widget_set_tooltip_text (priv->directory_label, parse_name);
+	g_free (name);
+	g_free (parse_name);
+
+	gtk_widget_show (priv->directory_label);
+	gtk_widget_show (priv->directory_lines_label);
+	gtk_widget_show (priv->directory_words_label);
+	gtk_widget_show (priv->directory_chars_label);
+	gtk_widget_show (priv->directory_chars_ns_label);
+	gtk_widget_show (priv->directory_bytes_label);
+	gtk_widget_show (priv->directory_languages_label);
+
+	update_directory_info (plugin, FALSE);
+
+	g_object_unref (location);
+}
+
+static void
+docinfo_dialog_destroy_cb (GtkWidget          *widget,
+			   GeditDocinfoPlugin *plugin)
+{
+	g_clear_pointer (&plugin->priv->directory_stats,
+			 gedit_docinfo_directory_stats_free);
 }
 
 static void
@@ -319,6 +538,15 @@ docinfo_dialog_response_cb (GtkDialog          *widget,
 
 			break;
 		}
+
+		case RESPONSE_DIRECTORY:
+		{
+			gedit_debug_message (DEBUG_PLUGINS, "RESPONSE_DIRECTORY");
+
+			count_directory (plugin);
+
+			break;
+		}
 	}
 }
 
@@ -353,6 +581,13 @@ create_docinfo_dialog (GeditDocinfoPlugin *plugin)
 	priv->selected_lines_label = GTK_WIDGET (gtk_builder_get_object (builder, "selected_lines_label"));
 	priv->selected_chars_label = GTK_WIDGET (gtk_builder_get_object (builder, "selected_chars_label"));
 	priv->selected_chars_ns_label = GTK_WIDGET (gtk_builder_get_object (builder, "selected_chars_ns_label"));
+	priv->directory_label = GTK_WIDGET (gtk_builder_get_object (builder, "directory_label"));
+	priv->directory_words_label = GTK_WIDGET (gtk_builder_get_object (builder, "directory_words_label"));
+	priv->directory_bytes_label = GTK_WIDGET (gtk_builder_get_object (builder, "directory_bytes_label"));
+	priv->directory_lines_label = GTK_WIDGET (gtk_builder_get_object (builder, "directory_lines_label"));
+	priv->directory_chars_label = GTK_WIDGET (gtk_builder_get_object (builder, "directory_chars_label"));
+	priv->directory_chars_ns_label = GTK_WIDGET (gtk_builder_get_object (builder, "directory_chars_ns_label"));
+	priv->directory_languages_label = GTK_WIDGET (gtk_builder_get_object (builder, "directory_languages_label"));
 	g_object_unref (builder);
 
 	gtk_dialog_set_default_response (GTK_DIALOG (priv->dialog),
@@ -364,6 +599,10 @@ create_docinfo_dialog (GeditDocinfoPlugin *plugin)
 			  "destroy",
 			  G_CALLBACK (gtk_widget_destroyed),
 			  &priv->dialog);
+	g_signal_connect (priv->dialog,
+			  "destroy",
+			  G_CALLBACK (docinfo_dialog_destroy_cb),
+			  plugin);
 	g_signal_connect (priv->dialog,
 			  "response",
 			  G_CALLBACK (docinfo_dialog_response_cb),
@@ -392,6 +631,13 @@ create_docinfo_dialog (GeditDocinfoPlugin *plugin)
 	gtk_widget_set_can_focus (priv->selected_lines_label, FALSE);
 	gtk_widget_set_can_focus (priv->selected_chars_label, FALSE);
 	gtk_widget_set_can_focus (priv->selected_chars_ns_label, FALSE);
+	gtk_widget_set_can_focus (priv->directory_label, FALSE);
+	gtk_widget_set_can_focus (priv->directory_words_label, FALSE);
+	gtk_widget_set_can_focus (priv->directory_bytes_label, FALSE);
+	gtk_widget_set_can_focus (priv->directory_lines_label, FALSE);
+	gtk_widget_set_can_focus (priv->directory_chars_label, FALSE);
+	gtk_widget_set_can_focus (priv->directory_chars_ns_label, FALSE);
+	gtk_widget_set_can_focus (priv->directory_languages_label, FALSE);
 }
 
 static void
@@ -429,6 +675,12 @@ gedit_docinfo_plugin_init (GeditDocinfoPlugin *plugin)
 	gedit_debug_message (DEBUG_PLUGINS, "GeditDocinfoPlugin initializing");
 
 	plugin->priv = gedit_docinfo_plugin_get_instance_private (plugin);
+
+	plugin->priv->document_stats =
+		g_hash_table_new_full (NULL,
+				       NULL,
+				       NULL,
+				       (GDestroyNotify) gedit_docinfo_document_stats_free);
 }
 
 static void
@@ -450,8 +702,12 @@ gedit_docinfo_plugin_dispose (GObject *object)
 static void
 gedit_docinfo_plugin_finalize (GObject *object)
 {
+	GeditDocinfoPlugin *plugin = GEDIT_DOCINFO_PLUGIN (object);
+
 	gedit_debug_message (DEBUG_PLUGINS, "GeditDocinfoPlugin finalizing");
 
+	g_hash_table_unref (plugin->priv->document_stats);
+
 	G_OBJECT_CLASS (gedit_docinfo_plugin_parent_class)->finalize (object);
 }
 
@@ -549,6 +805,15 @@ gedit_docinfo_plugin_app_deactivate (GeditAppActivatable *activatable)
 	g_clear_object (&priv->menu_ext);
 }
 
+static void
+tab_removed_cb (GeditWindow        *window,
+		GeditTab           *tab,
+		GeditDocinfoPlugin *plugin)
+{
+	g_hash_table_remove (plugin->priv->document_stats,
+			     gedit_tab_get_document (tab));
+}
+
 static void
 gedit_docinfo_plugin_window_activate (GeditWindowActivatable *activatable)
 {
@@ -564,6 +829,11 @@ gedit_docinfo_plugin_window_activate (GeditWindowActivatable *activatable)
 	g_action_map_add_action (G_ACTION_MAP (priv->window),
 	                         G_ACTION (priv->action));
 
+	g_signal_connect (priv->window,
+			  "tab-removed",
+			  G_CALLBACK (tab_removed_cb),
+			  activatable);
+
 	update_ui (GEDIT_DOCINFO_PLUGIN (activatable));
 }
 
@@ -577,6 +847,10 @@ gedit_docinfo_plugin_window_deactivate (GeditWindowActivatable *activatable)
 	priv = GEDIT_DOCINFO_PLUGIN (activatable)->priv;
 
 	g_action_map_remove_action (G_ACTION_MAP (priv->window), "docinfo");
+
+	g_signal_handlers_disconnect_by_func (priv->window, tab_removed_cb, activatable);
+	g_hash_table_remove_all (priv->document_stats);
+	g_clear_pointer (&priv->directory_stats, gedit_docinfo_directory_stats_free);
 }
 
 static void
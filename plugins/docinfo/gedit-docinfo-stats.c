@@ -0,0 +1,619 @@
+/*
+ * gedit-docinfo-stats.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The statistics of a document are computed once, and then maintained from
+ * the insert-text and delete-range signals, with a cost proportional to the
+ * size of the change.
+ *
+ * For the first count, the buffer contents are copied in idle time slices,
+ * by chunks of whole lines, and counted in a worker thread. The buffer can
+ * be modified meanwhile:
+ * - before the part already copied, the change is counted as a delta;
+ * - after it, it will be part of the copy;
+ * - across it, the copy is restarted.
+ * Since the chunks start at the beginning of a line, they can be counted
+ * independently of each other.
+ */
+
+#include "gedit-docinfo-stats.h"
+
+#include <string.h>
+
+/* In microseconds. */
+#define SNAPSHOT_TIME_SLICE 5000
+
+#define SNAPSHOT_CHUNK_LINES 4096
+
+typedef enum
+{
+	STATE_SNAPSHOT,
+	STATE_COUNTING,
+	STATE_READY
+} State;
+
+struct _GeditDocinfoDocumentStats
+{
+	GeditDocument *doc;
+
+	State state;
+
+	/* In STATE_READY, the counts of the document. Before, the changes
+	 * made to the part of the document already copied.
+	 */
+	GeditDocinfoCounts counts;
+
+	/* The chunks copied so far, and where to continue. */
+	GPtrArray *chunks;
+	GtkTextMark *snapshot_mark;
+	guint snapshot_idle_id;
+
+	GCancellable *cancellable;
+
+	GeditDocinfoStatsReadyFunc ready_func;
+	gpointer user_data;
+};
+
+/* The words are counted like the word starts of pango, following the word
+ * boundaries of Unicode (UAX #29) without a dictionary:
+ * - a run of letters and digits is one word;
+ * - an apostrophe, a period or a colon between two letters, and an
+ *   apostrophe, a period, a comma or a semicolon between two digits, do not
+ *   break the word, otherwise they are not part of words;
+ * - each ideograph and hiragana is a word.
+ * A word start depends only on the two previous characters, so that the
+ * counts can be updated locally when the buffer is modified.
+ */
+typedef enum
+{
+	WORD_CLASS_NONE,
+	WORD_CLASS_LETTER,
+	WORD_CLASS_DIGIT,
+	WORD_CLASS_IDEOGRAPH
+} WordClass;
+
+static inline WordClass
+get_word_class (gunichar c)
+{
+	GUnicodeScript script;
+
+	if (c < 0x80)
+	{
+		if (g_ascii_isdigit (c))
+		{
+			return WORD_CLASS_DIGIT;
+		}
+
+		return (g_ascii_isalpha (c) || c == '_') ? WORD_CLASS_LETTER : WORD_CLASS_NONE;
+	}
+
+	if (g_unichar_isdigit (c))
+	{
+		return WORD_CLASS_DIGIT;
+	}
+
+	if (!g_unichar_isalpha (c) && !g_unichar_ismark (c))
+	{
+		return WORD_CLASS_NONE;
+	}
+
+	script = g_unichar_get_script (c);
+
+	if (script == G_UNICODE_SCRIPT_HAN || script == G_UNICODE_SCRIPT_HIRAGANA)
+	{
+		return WORD_CLASS_IDEOGRAPH;
+	}
+
+	return WORD_CLASS_LETTER;
+}
+
+/* Whether @c does not break a word between two characters of @word_class */
+static inline gboolean
+is_word_separator (gunichar  c,
+		   WordClass word_class)
+{
+	switch (c)
+	{
+		case '\'':
+		case '.':
+		case 0x2019: /* Right single quotation mark, as apostrophe */
+			return TRUE;
+		case ':':
+		case 0x00B7: /* Middle dot */
+			return word_class == WORD_CLASS_LETTER;
+		case ',':
+		case ';':
+			return word_class == WORD_CLASS_DIGIT;
+		default:
+			return FALSE;
+	}
+}
+
+static inline gboolean
+is_white_char (gunichar c)
+{
+	if (c < 0x80)
+	{
+		return g_ascii_isspace (c);
+	}
+
+	return g_unichar_isspace (c);
+}
+
+static inline gint
+starts_word (gunichar c,
+	     gunichar prev_char,
+	     gunichar prev_prev_char)
+{
+	WordClass word_class = get_word_class (c);
+	WordClass prev_class;
+
+	if (word_class == WORD_CLASS_NONE)
+	{
+		return 0;
+	}
+
+	if (word_class == WORD_CLASS_IDEOGRAPH)
+	{
+		return 1;
+	}
+
+	prev_class = get_word_class (prev_char);
+
+	if (prev_class == WORD_CLASS_LETTER || prev_class == WORD_CLASS_DIGIT)
+	{
+		return 0;
+	}
+
+	if (is_word_separator (prev_char, word_class) &&
+	    get_word_class (prev_prev_char) == word_class)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+/* @prev_chars are the last two chars before @text, the last one first, or
+ * 0. They are updated to the last two chars of @text.
+ */
+void
+gedit_docinfo_counts_add_text (GeditDocinfoCounts *counts,
+			       const gchar        *text,
+			       gsize               len,
+			       gunichar            prev_chars[2])
+{
+	const guchar *p = (const guchar *) text;
+	const guchar *end = p + len;
+	gunichar prev = prev_chars[0];
+	gunichar prev_prev = prev_chars[1];
+
+	counts->bytes += len;
+
+	while (p < end)
+	{
+		gunichar c;
+
+		if (*p < 0x80)
+		{
+			c = *p;
+			p++;
+		}
+		else
+		{
+			c = g_utf8_get_char_validated ((const gchar *) p, end - p);
+
+			if (c == (gunichar) -1 || c == (gunichar) -2)
+			{
+				/* Invalid UTF-8, counted as one char. */
+				c = 0xFFFD;
+				p++;
+			}
+			else
+			{
+				p = (const guchar *) g_utf8_next_char (p);
+			}
+		}
+
+		counts->chars++;
+
+		if (c == '\n')
+		{
+			counts->lines++;
+		}
+
+		if (is_white_char (c))
+		{
+			counts->white_chars++;
+		}
+
+		counts->words += starts_word (c, prev, prev_prev);
+
+		prev_prev = prev;
+		prev = c;
+	}
+
+	prev_chars[0] = prev;
+	prev_chars[1] = prev_prev;
+}
+
+void
+gedit_docinfo_counts_add (GeditDocinfoCounts       *counts,
+			  const GeditDocinfoCounts *other)
+{
+	counts->lines += other->lines;
+	counts->words += other->words;
+	counts->chars += other->chars;
+	counts->white_chars += other->white_chars;
+	counts->bytes += other->bytes;
+}
+
+static void
+counts_sub (GeditDocinfoCounts       *counts,
+	    const GeditDocinfoCounts *other)
+{
+	counts->lines -= other->lines;
+	counts->words -= other->words;
+	counts->chars -= other->chars;
+	counts->white_chars -= other->white_chars;
+	counts->bytes -= other->bytes;
+}
+
+/* The two chars before @iter, the last one first. */
+static void
+get_chars_before (const GtkTextIter *iter,
+		  gunichar           prev_chars[2])
+{
+	GtkTextIter prev = *iter;
+
+	prev_chars[0] = gtk_text_iter_backward_char (&prev) ? gtk_text_iter_get_char (&prev) : 0;
+	prev_chars[1] = gtk_text_iter_backward_char (&prev) ? gtk_text_iter_get_char (&prev) : 0;
+}
+
+static void
+get_chars_from (const GtkTextIter *iter,
+		gunichar           next_chars[2])
+{
+	GtkTextIter next = *iter;
+
+	next_chars[0] = gtk_text_iter_get_char (&next);
+	next_chars[1] = gtk_text_iter_forward_char (&next) ? gtk_text_iter_get_char (&next) : 0;
+}
+
+/* The word starts of the two chars after a change, which depend on the two
+ * chars before them. */
+static gint
+starts_words_after (const gunichar next_chars[2],
+		    const gunichar prev_chars[2])
+{
+	return starts_word (next_chars[0], prev_chars[0], prev_chars[1]) +
+	       starts_word (next_chars[1], next_chars[0], prev_chars[0]);
+}
+
+static void
+count_chunks_thread (GTask        *task,
+		     gpointer      source_object,
+		     gpointer      task_data,
+		     GCancellable *cancellable)
+{
+	GPtrArray *chunks = task_data;
+	GeditDocinfoCounts *counts;
+	guint i;
+
+	counts = g_new0 (GeditDocinfoCounts, 1);
+
+	for (i = 0; i < chunks->len; i++)
+	{
+		const gchar *chunk = g_ptr_array_index (chunks, i);
+		gunichar prev_chars[2] = { 0, 0 };
+
+		if (g_task_return_error_if_cancelled (task))
+		{
+			g_free (counts);
+			return;
+		}
+
+		gedit_docinfo_counts_add_text (counts, chunk, strlen (chunk), prev_chars);
+	}
+
+	g_task_return_pointer (task, counts, g_free);
+}
+
+static void
+count_chunks_finished_cb (GObject      *source_object,
+			  GAsyncResult *result,
+			  gpointer      user_data)
+{
+	GeditDocinfoDocumentStats *stats;
+	GeditDocinfoCounts *counts;
+
+	/* The stats are freed if the task has been cancelled. */
+	counts = g_task_propagate_pointer (G_TASK (result), NULL);
+
+	if (counts == NULL)
+	{
+		return;
+	}
+
+	stats = user_data;
+	stats->state = STATE_READY;
+	g_clear_object (&stats->cancellable);
+
+	gedit_docinfo_counts_add (&stats->counts, counts);
+	g_free (counts);
+
+	if (stats->ready_func != NULL)
+	{
+		stats->ready_func (stats, stats->doc, stats->user_data);
+	}
+}
+
+static void
+start_counting (GeditDocinfoDocumentStats *stats)
+{
+	GTask *task;
+
+	stats->state = STATE_COUNTING;
+	stats->cancellable = g_cancellable_new ();
+
+	task = g_task_new (NULL, stats->cancellable, count_chunks_finished_cb, stats);
+	g_task_set_task_data (task, stats->chunks, (GDestroyNotify) g_ptr_array_unref);
+	stats->chunks = NULL;
+
+	g_task_run_in_thread (task, count_chunks_thread);
+	g_object_unref (task);
+}
+
+static gboolean
+snapshot_idle_cb (gpointer user_data)
+{
+	GeditDocinfoDocumentStats *stats = user_data;
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (stats->doc);
+	gint64 deadline = g_get_monotonic_time () + SNAPSHOT_TIME_SLICE;
+	GtkTextIter start;
+	GtkTextIter end;
+
+	gtk_text_buffer_get_iter_at_mark (buffer, &start, stats->snapshot_mark);
+
+	do
+	{
+		end = start;
+		gtk_text_iter_forward_lines (&end, SNAPSHOT_CHUNK_LINES);
+
+		g_ptr_array_add (stats->chunks,
+				 gtk_text_buffer_get_slice (buffer, &start, &end, TRUE));
+
+		start = end;
+	}
+	while (!gtk_text_iter_is_end (&start) && g_get_monotonic_time () < deadline);
+
+	gtk_text_buffer_move_mark (buffer, stats->snapshot_mark, &start);
+
+	if (!gtk_text_iter_is_end (&start))
+	{
+		return G_SOURCE_CONTINUE;
+	}
+
+	stats->snapshot_idle_id = 0;
+	start_counting (stats);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+restart_snapshot (GeditDocinfoDocumentStats *stats)
+{
+	GtkTextIter start;
+
+	g_ptr_array_set_size (stats->chunks, 0);
+	memset (&stats->counts, 0, sizeof (GeditDocinfoCounts));
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (stats->doc), &start);
+	gtk_text_buffer_move_mark (GTK_TEXT_BUFFER (stats->doc), stats->snapshot_mark, &start);
+}
+
+/* Returns whether the change must be counted as a delta. */
+static gboolean
+check_snapshot_position (GeditDocinfoDocumentStats *stats,
+			 const GtkTextIter         *start,
+			 const GtkTextIter         *end)
+{
+	GtkTextIter snapshot_iter;
+
+	if (stats->state != STATE_SNAPSHOT)
+	{
+		return TRUE;
+	}
+
+	gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (stats->doc),
+					  &snapshot_iter,
+					  stats->snapshot_mark);
+
+	if (gtk_text_iter_compare (end, &snapshot_iter) < 0)
+	{
+		return TRUE;
+	}
+
+	if (gtk_text_iter_compare (start, &snapshot_iter) < 0)
+	{
+		restart_snapshot (stats);
+	}
+
+	return FALSE;
+}
+
+static void
+insert_text_cb (GtkTextBuffer             *buffer,
+		GtkTextIter               *location,
+		const gchar               *text,
+		gint                       len,
+		GeditDocinfoDocumentStats *stats)
+{
+	GeditDocinfoCounts inserted = { 0 };
+	gunichar prev_chars[2];
+	gunichar next_chars[2];
+
+	if (!check_snapshot_position (stats, location, location))
+	{
+		return;
+	}
+
+	get_chars_before (location, prev_chars);
+	get_chars_from (location, next_chars);
+
+	stats->counts.words -= starts_words_after (next_chars, prev_chars);
+
+	gedit_docinfo_counts_add_text (&inserted, text, len, prev_chars);
+	inserted.words += starts_words_after (next_chars, prev_chars);
+
+	gedit_docinfo_counts_add (&stats->counts, &inserted);
+}
+
+static void
+delete_range_cb (GtkTextBuffer             *buffer,
+		 GtkTextIter               *start,
+		 GtkTextIter               *end,
+		 GeditDocinfoDocumentStats *stats)
+{
+	GeditDocinfoCounts deleted = { 0 };
+	gunichar prev_chars[2];
+	gunichar next_chars[2];
+	gunichar chars_before_start[2];
+	gchar *text;
+
+	if (!check_snapshot_position (stats, start, end))
+	{
+		return;
+	}
+
+	get_chars_before (start, chars_before_start);
+	get_chars_from (end, next_chars);
+	prev_chars[0] = chars_before_start[0];
+	prev_chars[1] = chars_before_start[1];
+
+	text = gtk_text_buffer_get_slice (buffer, start, end, TRUE);
+	gedit_docinfo_counts_add_text (&deleted, text, strlen (text), prev_chars);
+	deleted.words += starts_words_after (next_chars, prev_chars);
+	g_free (text);
+
+	counts_sub (&stats->counts, &deleted);
+	stats->counts.words += starts_words_after (next_chars, chars_before_start);
+}
+
+GeditDocinfoDocumentStats *
+gedit_docinfo_document_stats_new (GeditDocument              *doc,
+				  GeditDocinfoStatsReadyFunc  ready_func,
+				  gpointer                    user_data)
+{
+	GeditDocinfoDocumentStats *stats;
+	GtkTextIter start;
+
+	g_return_val_if_fail (GEDIT_IS_DOCUMENT (doc), NULL);
+
+	stats = g_slice_new0 (GeditDocinfoDocumentStats);
+	stats->doc = doc;
+	stats->state = STATE_SNAPSHOT;
+	stats->chunks = g_ptr_array_new_with_free_func (g_free);
+	stats->ready_func = ready_func;
+	stats->user_data = user_data;
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (doc), &start);
+	stats->snapshot_mark = gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (doc),
+							    NULL,
+							    &start,
+							    TRUE);
+
+	/* Before the default handlers, while the iters still point to the
+	 * text being modified.
+	 */
+	g_signal_connect (doc,
+			  "insert-text",
+			  G_CALLBACK (insert_text_cb),
+			  stats);
+
+	g_signal_connect (doc,
+			  "delete-range",
+			  G_CALLBACK (delete_range_cb),
+			  stats);
+
+	stats->snapshot_idle_id = g_idle_add (snapshot_idle_cb, stats);
+
+	return stats;
+}
+
+/* Must be called before the document is finalized. */
+void
+gedit_docinfo_document_stats_free (GeditDocinfoDocumentStats *stats)
+{
+	if (stats == NULL)
+	{
+		return;
+	}
+
+	if (stats->snapshot_idle_id != 0)
+	{
+		g_source_remove (stats->snapshot_idle_id);
+	}
+
+	if (stats->cancellable != NULL)
+	{
+		g_cancellable_cancel (stats->cancellable);
+		g_object_unref (stats->cancellable);
+	}
+
+	g_signal_handlers_disconnect_by_data (stats->doc, stats);
+	gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (stats->doc), stats->snapshot_mark);
+
+	if (stats->chunks != NULL)
+	{
+		g_ptr_array_unref (stats->chunks);
+	}
+
+	g_slice_free (GeditDocinfoDocumentStats, stats);
+}
+
+/**
+ * gedit_docinfo_document_stats_get_counts:
+ * @stats: a #GeditDocinfoDocumentStats.
+ * @counts: (out): the counts of the whole document.
+ *
+ * Returns: %FALSE if the first count is still in progress, in which case
+ * the ready function will be called when it is done.
+ */
+gboolean
+gedit_docinfo_document_stats_get_counts (GeditDocinfoDocumentStats *stats,
+					 GeditDocinfoCounts        *counts)
+{
+	g_return_val_if_fail (stats != NULL, FALSE);
+	g_return_val_if_fail (counts != NULL, FALSE);
+
+	if (stats->state != STATE_READY)
+	{
+		return FALSE;
+	}
+
+	*counts = stats->counts;
+
+	/* Maintained by the buffer. */
+	counts->lines = stats->counts.chars > 0 ?
+			gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (stats->doc)) : 0;
+
+	return TRUE;
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,65 @@
+/*
+ * gedit-docinfo-stats.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef GEDIT_DOCINFO_STATS_H
+#define GEDIT_DOCINFO_STATS_H
+
+#include <gedit/gedit-document.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GeditDocinfoCounts GeditDocinfoCounts;
+typedef struct _GeditDocinfoDocumentStats GeditDocinfoDocumentStats;
+
+struct _GeditDocinfoCounts
+{
+	gint64 lines;
+	gint64 words;
+	gint64 chars;
+	gint64 white_chars;
+	gint64 bytes;
+};
+
+typedef void (* GeditDocinfoStatsReadyFunc) (GeditDocinfoDocumentStats *stats,
+					     GeditDocument             *doc,
+					     gpointer                   user_data);
+
+void			 gedit_docinfo_counts_add_text		(GeditDocinfoCounts         *counts,
+								 const gchar                *text,
+								 gsize                       len,
+								 gunichar                    prev_chars[2]);
+
+void			 gedit_docinfo_counts_add		(GeditDocinfoCounts         *counts,
+								 const GeditDocinfoCounts   *other);
+
+GeditDocinfoDocumentStats *
+			 gedit_docinfo_document_stats_new	(GeditDocument              *doc,
+								 GeditDocinfoStatsReadyFunc  ready_func,
+								 gpointer                    user_data);
+
+void			 gedit_docinfo_document_stats_free	(GeditDocinfoDocumentStats  *stats);
+
+gboolean		 gedit_docinfo_document_stats_get_counts
+								(GeditDocinfoDocumentStats  *stats,
+								 GeditDocinfoCounts         *counts);
+
+G_END_DECLS
+
+#endif /* GEDIT_DOCINFO_STATS_H */
+
+/* ex:set ts=8 noet: */
@@ -24,6 +24,7 @@ import signal
 import locale
 import subprocess
 import fcntl
+import codecs
 from gi.repository import GLib, GObject
 
 try:
@@ -41,6 +42,11 @@ class Capture(GObject.Object):
     CAPTURE_NEEDS_SHELL = 0x04
 
     WRITE_BUFFER_SIZE = 0x4000
+    READ_BUFFER_SIZE = 0x10000
+
+    # Maximum number of reads per wake up, so that a tool writing faster
+    # than we can read does not starve the main loop
+    MAX_READS = 16
 
     __gsignals__ = {
         'stdout-line': (GObject.SignalFlags.RUN_LAST, GObject.TYPE_NONE, (GObject.TYPE_STRING,)),
@@ -52,6 +58,7 @@ class Capture(GObject.Object):
     def __init__(self, command, cwd=None, env={}):
         GObject.GObject.__init__(self)
         self.pipe = None
+        self.pid = None
         self.env = env
         self.cwd = cwd
         self.flags = self.CAPTURE_BOTH | self.CAPTURE_NEEDS_SHELL
@@ -68,7 +75,10 @@ class Capture(GObject.Object):
         self.flags = flags
 
     def set_input(self, text):
-        self.input_text = text.encode("UTF-8") if text else None
+        # Only encoded chunk by chunk, as the child reads it
+        self.input_text = text if text else None
+        self.input_offset = 0
+        self.input_buffer = None
 
     def set_cwd(self, cwd):
         self.cwd = cwd
@@ -99,6 +109,15 @@ class Capture(GObject.Object):
         self.out_channel_id = 0
         self.err_channel_id = 0
 
+        # The std*-line signals are emitted with complete lines only, the
+        # end of the last line read is kept until the next read
+        self.decoders = {}
+        self.partial = {}
+
+        for signalname in ('stdout-line', 'stderr-line'):
+            self.decoders[signalname] = codecs.getincrementaldecoder('utf-8')('replace')
+            self.partial[signalname] = ''
+
         try:
             self.pipe = subprocess.Popen(self.command, **popen_args)
         except OSError as e:
@@ -106,6 +125,7 @@ class Capture(GObject.Object):
             self.emit('stderr-line', _('Could not execute command: %s') % (e, ))
             return
 
+        self.pid = self.pipe.pid
         self.emit('begin-execute')
 
         if self.input_text is not None:
@@ -146,20 +166,25 @@ class Capture(GObject.Object):
 
     def write_chunk(self, dest, condition):
         if condition & (GObject.IO_OUT):
-            status = GLib.IOStatus.NORMAL
-            l = len(self.input_text)
-            while status == GLib.IOStatus.NORMAL:
-                if l == 0:
-                    return False
-                m = min(l, self.WRITE_BUFFER_SIZE)
+            fd = dest.unix_get_fd()
+
+            while True:
+                if not self.input_buffer:
+                    if self.input_offset >= len(self.input_text):
+                        return False
+
+                    chunk = self.input_text[self.input_offset:self.input_offset + self.WRITE_BUFFER_SIZE]
+                    self.input_offset += len(chunk)
+                    self.input_buffer = memoryview(chunk.encode("UTF-8"))
+
                 try:
-                    (status, length) = dest.write_chars(self.input_text, m)
-                    self.input_text = self.input_text[length:]
-                    l -= length
-                except Exception as e:
+                    length = os.write(fd, self.input_buffer)
+                except BlockingIOError:
+                    break
+                except OSError:
                     return False
-            if status != GLib.IOStatus.AGAIN:
-                return False
+
+                self.input_buffer = self.input_buffer[length:]
 
         if condition & ~(GObject.IO_OUT):
             return False
@@ -170,6 +195,7 @@ class Capture(GObject.Object):
         ret = self.write_chunk(dest, condition)
         if ret is False:
             self.input_text = None
+            self.input_buffer = None
             try:
                 self.in_channel.shutdown(True)
             except:
@@ -181,19 +207,45 @@ class Capture(GObject.Object):
         return ret
 
     def handle_source(self, source, condition, signalname):
-        if condition & (GObject.IO_IN | GObject.IO_PRI):
-            status = GLib.IOStatus.NORMAL
-            while status == GLib.IOStatus.NORMAL:
+        if condition & (GObject.IO_IN | GObject.IO_PRI | GObject.IO_HUP):
+            decoder = self.decoders[signalname]
+            fd = source.unix_get_fd()
+            chunks = []
+            eof = False
+
+            # Read in large chunks rather than line by line, and emit all
+            # the lines read at once
+            for i in range(self.MAX_READS):
                 try:
-                    (status, buf, length, terminator_pos) = source.read_line()
-                except Exception as e:
-                    return False
-                if buf:
-                    self.emit(signalname, buf)
-            if status != GLib.IOStatus.AGAIN:
-                return False
+                    data = os.read(fd, self.READ_BUFFER_SIZE)
+                except BlockingIOError:
+                    break
+                except OSError:
+                    eof = True
+                    break
 
-        if condition & ~(GObject.IO_IN | GObject.IO_PRI):
+                if not data:
+                    eof = True
+                    break
+
+                chunks.append(decoder.decode(data))
+
+            text = self.partial[signalname] + ''.join(chunks)
+
+            if eof:
+                text += decoder.decode(b'', True)
+                self.partial[signalname] = ''
+            else:
+                pos = text.rfind('\n') + 1
+                self.partial[signalname] = text[pos:]
+                text = text[:pos]
+
+            if text:
+                self.emit(signalname, text)
+
+            if eof:
+                return False
+        elif condition & ~(GObject.IO_IN | GObject.IO_PRI):
             return False
 
         return True
@@ -245,22 +297,25 @@ class Capture(GObject.Object):
             GLib.source_remove(self.err_channel_id)
             self.err_channel.shutdown(True)
             self.err_channel = None
-            self.err_channel = 0
+            self.err_channel_id = 0
 
-        if self.pipe is not None:
+        # Until the child is gone, so that stopping again kills it
+        if self.pid is not None:
             if not self.tried_killing:
-                os.kill(self.pipe.pid, signal.SIGTERM)
+                os.kill(self.pid, signal.SIGTERM)
                 self.tried_killing = True
             else:
-                os.kill(self.pipe.pid, signal.SIGKILL)
+                os.kill(self.pid, signal.SIGKILL)
 
-            self.pipe = None
+        self.pipe = None
 
     def emit_end_execute(self, error_code):
         self.emit('end-execute', error_code)
         return False
 
     def on_child_end(self, pid, error_code):
+        self.pid = None
+
         # In an idle, so it is emitted after all the std*-line signals
         # have been intercepted
         GLib.idle_add(self.emit_end_execute, error_code)
@@ -17,8 +17,10 @@
 #    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 import os
+import difflib
 from gi.repository import Gio, Gtk, Gdk, GtkSource, Gedit
 from .capture import *
+from .jobs import Job
 
 try:
     import gettext
@@ -152,15 +154,6 @@ def run_external_tool(window, panel, node):
     input_type = node.input
     output_type = node.output
 
-    # Clear the panel
-    panel.clear()
-
-    if output_type == 'output-panel':
-        panel.show()
-
-    # Assign the error output to the output panel
-    panel.set_process(capture)
-
     if input_type != 'nothing' and view is not None:
         if input_type == 'document':
             start, end = document.get_bounds()
@@ -188,6 +181,7 @@ def run_external_tool(window, panel, node):
             start = document.get_iter_at_mark(document.get_insert())
             end = start.copy()
             if not start.inside_word():
+                panel.set_job(None)
                 panel.write(_('You must be inside a word to run this command'),
                             panel.error_tag)
                 return
@@ -199,6 +193,64 @@ def run_external_tool(window, panel, node):
         input_text = document.get_text(start, end, False)
         capture.set_input(input_text)
 
+    # The output is only assigned when the job is started, as it may have
+    # to wait for the previous runs of the tool. The text it replaces or
+    # the position it is inserted at are marked now, to be the ones the
+    # tool is given whatever is selected by then.
+    marks = None
+
+    if view is not None and output_type in ('replace-selection', 'insert'):
+        try:
+            start, end = document.get_selection_bounds()
+        except ValueError:
+            start = document.get_iter_at_mark(document.get_insert())
+            end = start.copy()
+
+        if output_type == 'insert':
+            start = document.get_iter_at_mark(document.get_insert())
+            end = start.copy()
+
+        marks = (document.create_mark(None, start, True),
+                 document.create_mark(None, end, False))
+
+    job = Job(panel, node, capture)
+    job.connect('started', job_started, window, view, document, output_type, marks)
+    job.connect('finished', job_finished, marks)
+
+    # A queued job is cancelled with the document it writes to
+    if view is not None:
+        handler_id = view.connect('destroy', job_view_destroyed, job)
+        job.connect('started', job_unwatch_view, view, handler_id)
+        job.connect('finished', job_unwatch_view, view, handler_id)
+
+    if output_type == 'output-panel':
+        panel.show()
+
+    panel.jobs.add(job)
+
+
+def job_view_destroyed(view, job):
+    if job.state == Job.QUEUED:
+        job.stop()
+
+
+def job_unwatch_view(job, view, handler_id):
+    if view.handler_is_connected(handler_id):
+        view.disconnect(handler_id)
+
+
+def job_finished(job, marks):
+    if marks is None:
+        return
+
+    for mark in marks:
+        if not mark.get_deleted():
+            mark.get_buffer().delete_mark(mark)
+
+
+def job_started(job, window, view, document, output_type, marks):
+    capture = job.capture
+
     # Assign the standard output to the chosen "file"
     if output_type == 'new-document':
         tab = window.create_tab(True)
@@ -206,47 +258,36 @@ def run_external_tool(window, panel, node):
         document = tab.get_document()
         pos = document.get_start_iter()
         capture.connect('stdout-line', capture_stdout_line_document, document, pos)
-        document.begin_user_action()
         view.set_editable(False)
         view.set_cursor_visible(False)
     elif output_type != 'output-panel' and output_type != 'nothing' and view is not None:
-        document.begin_user_action()
         view.set_editable(False)
         view.set_cursor_visible(False)
 
         if output_type.startswith('replace-'):
             if output_type == 'replace-selection':
-                try:
-                    start_iter, end_iter = document.get_selection_bounds()
-                except ValueError:
-                    start_iter = document.get_iter_at_mark(document.get_insert())
-                    end_iter = start_iter.copy()
+                capture.connect('stdout-line', capture_delayed_replace,
+                                document, marks[0], marks[1])
             elif output_type == 'replace-document':
-                start_iter, end_iter = document.get_bounds()
-            capture.connect('stdout-line', capture_delayed_replace,
-                            document, start_iter, end_iter)
+                # Applied as a whole once the tool is done, only changing
+                # the lines which differ
+                output = []
+                capture.connect('stdout-line', capture_stdout_line_collect, output)
+                capture.connect('end-execute', capture_end_execute_replace_document,
+                                document, output)
         else:
             if output_type == 'insert':
-                pos = document.get_iter_at_mark(document.get_insert())
+                pos = document.get_iter_at_mark(marks[0])
             else:
                 pos = document.get_end_iter()
             capture.connect('stdout-line', capture_stdout_line_document, document, pos)
     elif output_type != 'nothing':
-        capture.connect('stdout-line', capture_stdout_line_panel, panel)
-
-        if not document is None:
-            document.begin_user_action()
+        capture.connect('stdout-line', capture_stdout_line_panel, job)
 
-    capture.connect('stderr-line', capture_stderr_line_panel, panel)
-    capture.connect('begin-execute', capture_begin_execute_panel, panel, view, node.name)
-    capture.connect('end-execute', capture_end_execute_panel, panel, view, output_type)
+    capture.connect('stderr-line', capture_stderr_line_panel, job)
+    capture.connect('begin-execute', capture_begin_execute_panel, job, view, job.name)
+    capture.connect('end-execute', capture_end_execute_panel, job, view, output_type)
 
-    # Run the command
-    capture.execute()
-
-    if output_type != 'nothing':
-        if not document is None:
-            document.end_user_action()
 
 class MultipleDocumentsSaver:
     def __init__(self, window, panel, all_docs, node):
@@ -293,25 +334,25 @@ def capture_menu_action(action, parameter, window, panel, node):
     run_external_tool(window, panel, node)
 
 
-def capture_stderr_line_panel(capture, line, panel):
+def capture_stderr_line_panel(capture, line, job):
+    panel = job.panel
+
     if not panel.visible():
         panel.show()
 
-    panel.write(line, panel.error_tag)
+    job.write(line, panel.error_tag)
 
 
-def capture_begin_execute_panel(capture, panel, view, label):
+def capture_begin_execute_panel(capture, job, view, label):
     if view:
         view.get_window(Gtk.TextWindowType.TEXT).set_cursor(Gdk.Cursor.new(Gdk.CursorType.WATCH))
 
-    panel['stop'].set_sensitive(True)
-    panel.clear()
-    panel.write(_("Running tool:"), panel.italic_tag)
-    panel.write(" %s\n\n" % label, panel.bold_tag)
+    job.write(_("Running tool:"), job.panel.italic_tag)
+    job.write(" %s\n\n" % label, job.panel.bold_tag)
 
 
-def capture_end_execute_panel(capture, exit_code, panel, view, output_type):
-    panel['stop'].set_sensitive(False)
+def capture_end_execute_panel(capture, exit_code, job, view, output_type):
+    panel = job.panel
 
     if view:
         if output_type in ('new-document', 'replace-document'):
@@ -337,25 +378,102 @@ def capture_end_execute_panel(capture, exit_code, panel, view, output_type):
         view.set_editable(True)
 
     if exit_code == 0:
-        panel.write("\n" + _("Done.") + "\n", panel.italic_tag)
+        job.write("\n" + _("Done.") + "\n", panel.italic_tag)
     else:
-        panel.write("\n" + _("Exited") + ":", panel.italic_tag)
-        panel.write(" %d\n" % exit_code, panel.bold_tag)
+        job.write("\n" + _("Exited") + ":", panel.italic_tag)
+        job.write(" %d\n" % exit_code, panel.bold_tag)
 
 
-def capture_stdout_line_panel(capture, line, panel):
-    panel.write(line)
+def capture_stdout_line_panel(capture, line, job):
+    job.write(line)
 
 
 def capture_stdout_line_document(capture, line, document, pos):
     document.insert(pos, line)
 
 
-def capture_delayed_replace(capture, line, document, start_iter, end_iter):
-    document.delete(start_iter, end_iter)
+def capture_stdout_line_collect(capture, line, output):
+    output.append(line)
+
+
+def capture_end_execute_replace_document(capture, exit_code, document, output):
+    # Like with the other replace outputs, the document is left alone when
+    # the tool did not output anything
+    if output:
+        start, end = document.get_bounds()
+        replace_text_minimal(document, start, end, ''.join(output))
+
+
+def split_lines(text):
+    lines = [line + '\n' for line in text.split('\n')]
+    lines[-1] = lines[-1][:-1]
+
+    if not lines[-1]:
+        lines.pop()
+
+    return lines
+
+
+def replace_text_minimal(document, start, end, text):
+    """
+    Replaces the text between start and end by text in a single user
+    action, deleting and inserting only the lines which differ, so that
+    the marks in the unchanged lines stay where they are.
+    """
+    base = start.get_offset()
+    old_lines = split_lines(document.get_text(start, end, True))
+    new_lines = split_lines(text)
+
+    # Tools usually change a few lines only, skip the common ends before
+    # computing the difference
+    common = min(len(old_lines), len(new_lines))
+    prefix = 0
+
+    while prefix < common and old_lines[prefix] == new_lines[prefix]:
+        prefix += 1
+
+    suffix = 0
+
+    while suffix < common - prefix and old_lines[-1 - suffix] == new_lines[-1 - suffix]:
+        suffix += 1
+
+    matcher = difflib.SequenceMatcher(None,
+                                      old_lines[prefix:len(old_lines) - suffix],
+                                      new_lines[prefix:len(new_lines) - suffix],
+                                      autojunk=False)
+    changes = [op for op in matcher.get_opcodes() if op[0] != 'equal']
+
+    if not changes:
+        return
+
+    offsets = [0]
+
+    for line in old_lines:
+        offsets.append(offsets[-1] + len(line))
+
+    document.begin_user_action()
+
+    # From the end, so that the offsets of the changes left are still valid
+    for tag, i1, i2, j1, j2 in reversed(changes):
+        start_offset = base + offsets[prefix + i1]
+
+        if i2 > i1:
+            document.delete(document.get_iter_at_offset(start_offset),
+                            document.get_iter_at_offset(base + offsets[prefix + i2]))
+
+        if j2 > j1:
+            document.insert(document.get_iter_at_offset(start_offset),
+                            ''.join(new_lines[prefix + j1:prefix + j2]))
+
+    document.end_user_action()
+
+
+def capture_delayed_replace(capture, line, document, start_mark, end_mark):
+    document.delete(document.get_iter_at_mark(start_mark),
+                    document.get_iter_at_mark(end_mark))
 
     # Must be done after deleting the text
-    pos = document.get_iter_at_mark(document.get_insert())
+    pos = document.get_iter_at_mark(start_mark)
 
     capture_stdout_line_document(capture, line, document, pos)
 
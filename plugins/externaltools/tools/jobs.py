@@ -0,0 +1,203 @@
+# -*- coding: utf-8 -*-
+#    Gedit External Tools plugin
+#
+#    This program is free software; you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation; either version 2 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program; if not, write to the Free Software
+#    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+__all__ = ('Job', 'JobManager')
+
+import collections
+from gi.repository import GLib, GObject
+
+try:
+    import gettext
+    gettext.bindtextdomain('gedit')
+    gettext.textdomain('gedit')
+    _ = gettext.gettext
+except:
+    _ = lambda s: s
+
+
+class Job(GObject.Object):
+    """
+    A run of a tool. The capture is configured when the job is created, and
+    executed when the job manager starts the job, after the handlers of the
+    started signal have been called.
+    """
+
+    QUEUED = 0
+    RUNNING = 1
+    FINISHED = 2
+    CANCELLED = 3
+
+    __gsignals__ = {
+        'started': (GObject.SignalFlags.RUN_LAST, GObject.TYPE_NONE, tuple()),
+        'finished': (GObject.SignalFlags.RUN_LAST, GObject.TYPE_NONE, tuple())
+    }
+
+    def __init__(self, panel, tool, capture):
+        GObject.Object.__init__(self)
+        self.panel = panel
+        self.tool = tool
+        self.name = tool.name
+        self.capture = capture
+
+        self.state = Job.QUEUED
+        self.stopped = False
+        self.exit_code = None
+        self.start_time = 0
+        self.end_time = 0
+
+        # (text, tag, number of lines), the oldest chunks are dropped
+        # like the oldest lines of the panel
+        self.output = collections.deque()
+        self.output_lines = 0
+
+        # After the handlers of the tool, which may still write to the job
+        capture.connect_after('end-execute', self.on_end_execute)
+
+    def write(self, text, tag=None):
+        n_lines = text.count('\n')
+        self.output.append((text, tag, n_lines))
+        self.output_lines += n_lines
+
+        while len(self.output) > 1 and \
+              self.output_lines - self.output[0][2] >= self.panel.SCROLLBACK_LINES:
+            self.output_lines -= self.output.popleft()[2]
+
+        if self.panel.job is self:
+            self.panel.write(text, tag)
+
+    def is_active(self):
+        return self.state in (Job.QUEUED, Job.RUNNING)
+
+    def get_elapsed(self):
+        """Returns the time the job has been running for, in seconds."""
+        if self.state == Job.RUNNING:
+            end = GLib.get_monotonic_time()
+        else:
+            end = self.end_time
+
+        return (end - self.start_time) // 1000000
+
+    def get_status(self):
+        if self.state == Job.QUEUED:
+            return _('Queued')
+        elif self.state == Job.CANCELLED:
+            return _('Cancelled')
+
+        elapsed = self.get_elapsed()
+        elapsed = '%d:%02d' % (elapsed // 60, elapsed % 60)
+
+        if self.state == Job.RUNNING:
+            return elapsed
+        elif self.stopped:
+            return _('Stopped')
+        elif self.exit_code == 0:
+            return elapsed
+        else:
+            return _('Exited: %d') % self.exit_code
+
+    def start(self):
+        self.state = Job.RUNNING
+        self.start_time = GLib.get_monotonic_time()
+
+        self.emit('started')
+        self.capture.execute()
+
+        # The command could not be run, the error has been written already
+        if self.capture.pipe is None and self.state == Job.RUNNING:
+            self.finish(-1)
+
+    def stop(self):
+        """
+        Cancels the job if it is queued. Otherwise the tool is terminated,
+        and killed if it is stopped again.
+        """
+        if self.state == Job.QUEUED:
+            self.state = Job.CANCELLED
+            self.emit('finished')
+        elif self.state == Job.RUNNING:
+            self.stopped = True
+            self.capture.stop(-1)
+
+    def finish(self, exit_code):
+        self.state = Job.FINISHED
+        self.exit_code = exit_code
+        self.end_time = GLib.get_monotonic_time()
+
+        self.emit('finished')
+
+    def on_end_execute(self, capture, exit_code):
+        if self.state == Job.RUNNING:
+            self.finish(exit_code)
+
+
+class JobManager(GObject.Object):
+    """
+    Runs the jobs of a window in the order they are added, with no more
+    than MAX_RUNNING_PER_TOOL jobs of the same tool at a time, so that a
+    long running tool never delays the others.
+    """
+
+    MAX_RUNNING_PER_TOOL = 1
+
+    # Number of finished jobs kept with their output
+    MAX_FINISHED = 10
+
+    __gsignals__ = {
+        'job-added': (GObject.SignalFlags.RUN_LAST, GObject.TYPE_NONE, (GObject.TYPE_PYOBJECT,)),
+        'job-removed': (GObject.SignalFlags.RUN_LAST, GObject.TYPE_NONE, (GObject.TYPE_PYOBJECT,)),
+        'job-changed': (GObject.SignalFlags.RUN_LAST, GObject.TYPE_NONE, (GObject.TYPE_PYOBJECT,))
+    }
+
+    def __init__(self):
+        GObject.Object.__init__(self)
+        self.jobs = []
+
+    def add(self, job):
+        self.jobs.append(job)
+        job.connect('finished', self.on_job_finished)
+
+        self.emit('job-added', job)
+        self.schedule()
+
+    def get_running(self):
+        return [job for job in self.jobs if job.state == Job.RUNNING]
+
+    def schedule(self):
+        running = collections.Counter(job.tool for job in self.get_running())
+
+        for job in list(self.jobs):
+            if job.state != Job.QUEUED or running[job.tool] >= self.MAX_RUNNING_PER_TOOL:
+                continue
+
+            running[job.tool] += 1
+            job.start()
+
+            if job.state == Job.RUNNING:
+                self.emit('job-changed', job)
+
+    def on_job_finished(self, job):
+        self.emit('job-changed', job)
+
+        finished = [j for j in self.jobs if not j.is_active()]
+
+        for j in finished[:max(0, len(finished) - self.MAX_FINISHED)]:
+            self.jobs.remove(j)
+            self.emit('job-removed', j)
+
+        self.schedule()
+
+# ex:ts=4:et:
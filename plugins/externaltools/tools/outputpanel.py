@@ -25,6 +25,7 @@ from .capture import *
 import re
 from . import linkparsing
 from . import filelookup
+from .jobs import Job, JobManager
 from gi.repository import GLib, Gio, Gdk, Gtk, Pango, Gedit
 
 try:
@@ -51,6 +52,12 @@ class UniqueById:
 
 
 class OutputPanel(UniqueById):
+    # Output is inserted at most once per frame
+    FLUSH_INTERVAL = 16
+
+    # Number of lines kept, the oldest ones are dropped
+    SCROLLBACK_LINES = 10000
+
     def __init__(self, datadir, window):
         if UniqueById.__init__(self, window):
             return
@@ -58,7 +65,8 @@ class OutputPanel(UniqueById):
         callbacks = {
             'on_stop_clicked': self.on_stop_clicked,
             'on_view_visibility_notify_event': self.on_view_visibility_notify_event,
-            'on_view_motion_notify_event': self.on_view_motion_notify_event
+            'on_view_motion_notify_event': self.on_view_motion_notify_event,
+            'on_jobs_selection_changed': self.on_jobs_selection_changed
         }
 
         self.profile_settings = self.get_profile_settings()
@@ -93,16 +101,39 @@ class OutputPanel(UniqueById):
         self.link_tag = buffer.create_tag('link')
         self.link_tag.set_property('underline', Pango.Underline.SINGLE)
 
+        # Marks the lines whose links have been looked for
+        self.parsed_tag = buffer.create_tag('parsed')
+
+        self.end_mark = buffer.create_mark('end', buffer.get_end_iter(), False)
+
         self.link_cursor = Gdk.Cursor.new(Gdk.CursorType.HAND2)
         self.normal_cursor = Gdk.Cursor.new(Gdk.CursorType.XTERM)
 
-        self.process = None
+        # The job whose output is shown
+        self.job = None
+
+        self.jobs = JobManager()
+        self.jobs.connect('job-added', self.on_job_added)
+        self.jobs.connect('job-removed', self.on_job_removed)
+        self.jobs.connect('job-changed', self.on_job_changed)
 
-        self.links = []
+        self.jobs_store = Gtk.ListStore(object, str, str)
+        self['jobs-view'].set_model(self.jobs_store)
+        self.elapsed_id = 0
+
+        # (list of texts, tag) not inserted yet
+        self.pending = []
+        self.pending_lines = 0
+        self.flush_id = 0
+        self.update_links_id = 0
 
         self.link_parser = linkparsing.LinkParser()
         self.file_lookup = filelookup.FileLookup(window)
 
+        vadjustment = self['view'].get_vadjustment()
+        vadjustment.connect('value-changed', self.on_adjustment_changed)
+        vadjustment.connect('changed', self.on_adjustment_changed)
+
     def get_profile_settings(self):
         #FIXME return either the gnome-terminal settings or the gedit one
         return Gio.Settings.new("org.gnome.gedit.plugins.externaltools")
@@ -117,66 +148,228 @@ class OutputPanel(UniqueById):
 
         self["view"].override_font(font_desc)
 
-    def set_process(self, process):
-        self.process = process
-
     def __getitem__(self, key):
         # Convenience function to get an object from its name
         return self.ui.get_object(key)
 
     def on_stop_clicked(self, widget, *args):
-        if self.process is not None:
-            self.write("\n" + _('Stopped.') + "\n",
-                       self.italic_tag)
-            self.process.stop(-1)
+        if self.job is None:
+            return
+
+        if self.job.state == Job.RUNNING:
+            self.job.write("\n" + _('Stopped.') + "\n",
+                           self.italic_tag)
 
-    def scroll_to_end(self):
-        iter = self['view'].get_buffer().get_end_iter()
-        self['view'].scroll_to_iter(iter, 0.0, False, 0.5, 0.5)
-        return False  # don't requeue this handler
+        self.job.stop()
+
+    def set_job(self, job):
+        """
+        Shows the output of job, or nothing if job is None.
+        """
+        self.job = job
+        self.clear()
+
+        if job is not None:
+            for text, tag, n_lines in job.output:
+                self.write(text, tag)
+        else:
+            self['jobs-view'].get_selection().unselect_all()
+
+        self['stop'].set_sensitive(job is not None and job.is_active())
+
+    def find_job(self, job):
+        for row in self.jobs_store:
+            if row[0] is job:
+                return row
+
+        return None
+
+    def on_job_added(self, manager, job):
+        piter = self.jobs_store.append((job, job.name, job.get_status()))
+        self['jobs-sidebar'].set_visible(len(self.jobs_store) > 1)
+
+        # Show the output of the new job
+        self['jobs-view'].get_selection().select_iter(piter)
+
+    def on_job_removed(self, manager, job):
+        row = self.find_job(job)
+
+        if row is not None:
+            self.jobs_store.remove(row.iter)
+
+        self['jobs-sidebar'].set_visible(len(self.jobs_store) > 1)
+
+    def on_job_changed(self, manager, job):
+        row = self.find_job(job)
+
+        if row is not None:
+            row[2] = job.get_status()
+
+        if job is self.job:
+            self['stop'].set_sensitive(job.is_active())
+
+        if self.elapsed_id == 0 and job.state == Job.RUNNING:
+            self.elapsed_id = GLib.timeout_add_seconds(1, self.on_elapsed_timeout)
+
+    def on_elapsed_timeout(self):
+        running = self.jobs.get_running()
+
+        for job in running:
+            self.find_job(job)[2] = job.get_status()
+
+        if not running:
+            self.elapsed_id = 0
+
+        return bool(running)
+
+    def on_jobs_selection_changed(self, selection):
+        model, piter = selection.get_selected()
+
+        if piter is not None and model[piter][0] is not self.job:
+            self.set_job(model[piter][0])
 
     def clear(self):
+        if self.flush_id:
+            GLib.source_remove(self.flush_id)
+            self.flush_id = 0
+
+        self.pending = []
+        self.pending_lines = 0
+
         self['view'].get_buffer().set_text("")
-        self.links = []
+        self.file_lookup.clear_cache()
 
     def visible(self):
         panel = self.window.get_bottom_panel()
         return panel.props.visible and panel.props.visible_child == self.panel
 
     def write(self, text, tag=None):
+        if self.pending and self.pending[-1][1] is tag:
+            self.pending[-1][0].append(text)
+        else:
+            self.pending.append(([text], tag))
+
+        self.pending_lines += text.count('\n')
+
+        if self.flush_id == 0:
+            self.flush_id = GLib.timeout_add(self.FLUSH_INTERVAL, self.flush)
+
+    def trim_pending(self, pending):
+        """
+        Returns the end of the pending output which fits in the scrollback.
+        """
+        trimmed = []
+        lines = 0
+
+        for texts, tag in reversed(pending):
+            text = ''.join(texts)
+            n_lines = text.count('\n')
+
+            if lines + n_lines >= self.SCROLLBACK_LINES:
+                keep = self.SCROLLBACK_LINES - lines
+
+                if n_lines > keep:
+                    text = '\n'.join(text.rsplit('\n', keep + 1)[1:])
+
+                trimmed.append(([text], tag))
+                break
+
+            trimmed.append(([text], tag))
+            lines += n_lines
+
+        trimmed.reverse()
+        return trimmed
+
+    def flush(self):
+        self.flush_id = 0
+
         buffer = self['view'].get_buffer()
+        pending = self.pending
 
-        end_iter = buffer.get_end_iter()
-        insert = buffer.create_mark(None, end_iter, True)
+        if self.pending_lines >= self.SCROLLBACK_LINES:
+            buffer.set_text("")
+            pending = self.trim_pending(pending)
 
-        if tag is None:
-            buffer.insert(end_iter, text)
-        else:
-            buffer.insert_with_tags(end_iter, text, tag)
+        self.pending = []
+        self.pending_lines = 0
+
+        for texts, tag in pending:
+            text = ''.join(texts)
+
+            if tag is None:
+                buffer.insert(buffer.get_end_iter(), text)
+            else:
+                buffer.insert_with_tags(buffer.get_end_iter(), text, tag)
+
+        excess = buffer.get_line_count() - self.SCROLLBACK_LINES
 
-        # find all links and apply the appropriate tag for them
-        links = self.link_parser.parse(text)
-        for lnk in links:
-            insert_iter = buffer.get_iter_at_mark(insert)
-            lnk.start = insert_iter.get_offset() + lnk.start
-            lnk.end = insert_iter.get_offset() + lnk.end
+        if excess > 0:
+            buffer.delete(buffer.get_start_iter(), buffer.get_iter_at_line(excess))
 
-            start_iter = buffer.get_iter_at_offset(lnk.start)
-            end_iter = buffer.get_iter_at_offset(lnk.end)
+        self['view'].scroll_mark_onscreen(self.end_mark)
 
-            tag = None
+        return False
+
+    def on_adjustment_changed(self, adjustment):
+        # Not while the view is being laid out
+        if self.update_links_id == 0:
+            self.update_links_id = GLib.idle_add(self.on_update_links_idle)
+
+    def on_update_links_idle(self):
+        self.update_links_id = 0
+        self.update_links()
+
+        return False
+
+    def update_links(self):
+        """
+        Looks for links in the visible lines which have not been parsed yet.
+        The links in the rest of the output are only looked for when it is
+        scrolled into view.
+        """
+        view = self['view']
+        buffer = view.get_buffer()
+        rect = view.get_visible_rect()
+
+        first = view.get_line_at_y(rect.y)[0].get_line()
+        last = view.get_line_at_y(rect.y + rect.height)[0].get_line()
 
+        for line in range(first, last + 1):
+            start = buffer.get_iter_at_line(line)
+
+            if not start.has_tag(self.parsed_tag):
+                self.parse_line(buffer, line)
+
+    def parse_line(self, buffer, line):
+        start = buffer.get_iter_at_line(line)
+        end = start.copy()
+
+        if not end.ends_line():
+            end.forward_to_line_end()
+
+        # The last line may still be written to, so it is parsed again
+        # until it is complete
+        complete = not end.is_end()
+        offset = start.get_offset()
+
+        buffer.remove_tag(self.link_tag, start, end)
+        buffer.remove_tag(self.invalid_link_tag, start, end)
+
+        for lnk in self.link_parser.parse(start.get_text(end)):
             # if the link points to an existing file then it is a valid link
             if self.file_lookup.lookup(lnk.path) is not None:
-                self.links.append(lnk)
                 tag = self.link_tag
             else:
                 tag = self.invalid_link_tag
 
-            buffer.apply_tag(tag, start_iter, end_iter)
+            buffer.apply_tag(tag,
+                             buffer.get_iter_at_offset(offset + lnk.start),
+                             buffer.get_iter_at_offset(offset + lnk.end))
 
-        buffer.delete_mark(insert)
-        GLib.idle_add(self.scroll_to_end)
+        if complete:
+            buffer.apply_tag(self.parsed_tag,
+                             buffer.get_iter_at_line(line),
+                             buffer.get_iter_at_line(line + 1))
 
     def show(self):
         panel = self.window.get_bottom_panel()
@@ -214,15 +407,23 @@ class OutputPanel(UniqueById):
         None is returned.
         """
 
-        # get the offset within the buffer from the x,y coordinates
+        # get the iter within the buffer from the x,y coordinates
         buff_x, buff_y = view.window_to_buffer_coords(Gtk.TextWindowType.TEXT, x, y)
         (over_text, iter_at_xy) = view.get_iter_at_location(buff_x, buff_y)
-        if not over_text:
+        if not over_text or not iter_at_xy.has_tag(self.link_tag):
             return None
-        offset = iter_at_xy.get_offset()
 
-        # find the first link that contains the offset
-        for lnk in self.links:
+        offset = iter_at_xy.get_line_offset()
+
+        start = iter_at_xy.copy()
+        start.set_line_offset(0)
+        end = start.copy()
+
+        if not end.ends_line():
+            end.forward_to_line_end()
+
+        # find the first link of the line that contains the offset
+        for lnk in self.link_parser.parse(start.get_text(end)):
             if offset >= lnk.start and offset <= lnk.end:
                 return lnk
 
@@ -0,0 +1,331 @@
+/*
+ * gedit-file-browser-cache.c - Gedit plugin providing easy file access
+ * from the sidepanel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <time.h>
+#include <glib/gstdio.h>
+
+#include "gedit-file-browser-cache.h"
+
+/*
+ * The listings of the directories loaded in the file browser are kept in
+ * the user cache directory, one file per directory named after a checksum
+ * of its URI, so that they can be shown before the directory is enumerated
+ * again. A listing is only valid for the modification time of the
+ * directory it was made from, which is stored with it.
+ *
+ * The listing has the attributes of the files needed to add them to the
+ * store: the name, the type, whether the file is hidden or a backup, and
+ * the content type guessed from the name.
+ *
+ * Like git does for its racily clean entries, a listing made less than the
+ * granularity of the modification times after the directory was modified
+ * is not trusted: the directory could have been modified again without its
+ * modification time changing. It is stored with no modification time, so
+ * that the directory is enumerated again the next time it is loaded.
+ *
+ * The listings are touched when they are used. The ones which were not used
+ * for a month, and the least recently used ones above a maximum number of
+ * listings, are removed once per session.
+ */
+
+#define CACHE_VERSION 1
+#define CACHE_ENTRY_FORMAT "(ayubbs)"
+#define CACHE_FORMAT "(uta" CACHE_ENTRY_FORMAT ")"
+
+/* The largest granularity of the modification times, of FAT */
+#define CACHE_MTIME_GRANULARITY (2 * G_USEC_PER_SEC)
+
+#define CACHE_MAX_AGE (30 * 24 * 60 * 60)
+#define CACHE_MAX_LISTINGS 1000
+
+typedef struct
+{
+	gchar  *name;
+	time_t  mtime;
+} CacheListing;
+
+static gboolean cache_pruned = FALSE;
+
+static gchar *
+get_cache_filename (GFile *directory)
+{
+	gchar *uri;
+	gchar *checksum;
+	gchar *filename;
+
+	uri = g_file_get_uri (directory);
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+
+	filename = g_build_filename (g_get_user_cache_dir (),
+				     "gedit",
+				     "file-browser",
+				     checksum,
+				     NULL);
+
+	g_free (checksum);
+	g_free (uri);
+
+	return filename;
+}
+
+static gint
+compare_listings (gconstpointer a,
+		  gconstpointer b)
+{
+	CacheListing const *listing_a = a;
+	CacheListing const *listing_b = b;
+
+	if (listing_a->mtime != listing_b->mtime)
+		return listing_a->mtime < listing_b->mtime ? -1 : 1;
+
+	return 0;
+}
+
+static void
+prune_cache_thread (GTask        *task,
+		    gpointer      source_object,
+		    gpointer      task_data,
+		    GCancellable *cancellable)
+{
+	gchar const *dirname = task_data;
+	GDir *dir;
+	gchar const *name;
+	GArray *listings;
+	time_t now = time (NULL);
+
+	dir = g_dir_open (dirname, 0, NULL);
+
+	if (dir == NULL)
+		return;
+
+	listings = g_array_new (FALSE, FALSE, sizeof (CacheListing));
+
+	while ((name = g_dir_read_name (dir)) != NULL)
+	{
+		gchar *filename = g_build_filename (dirname, name, NULL);
+		GStatBuf buf;
+
+		if (g_stat (filename, &buf) != 0)
+		{
+			g_free (filename);
+		}
+		else if (now - buf.st_mtime > CACHE_MAX_AGE)
+		{
+			g_unlink (filename);
+			g_free (filename);
+		}
+		else
+		{
+			CacheListing listing = { filename, buf.st_mtime };
+
+			g_array_append_val (listings, listing);
+		}
+	}
+
+	g_dir_close (dir);
+
+	g_array_sort (listings, compare_listings);
+
+	for (guint i = 0; i < listings->len; ++i)
+	{
+		CacheListing *listing = &g_array_index (listings, CacheListing, i);
+
+		/* The most recently used ones are last */
+		if (listings->len - i > CACHE_MAX_LISTINGS)
+			g_unlink (listing->name);
+
+		g_free (listing->name);
+	}
+
+	g_array_free (listings, TRUE);
+}
+
+/* Removes the old listings in the background, once per session */
+static void
+prune_cache (gchar const *dirname)
+{
+	GTask *task;
+
+	if (cache_pruned)
+		return;
+
+	cache_pruned = TRUE;
+
+	task = g_task_new (NULL, NULL, NULL, NULL);
+	g_task_set_task_data (task, g_strdup (dirname), g_free);
+	g_task_set_priority (task, G_PRIORITY_LOW);
+	g_task_run_in_thread (task, prune_cache_thread);
+	g_object_unref (task);
+}
+
+/* Returns the modification time of a directory in microseconds, from an
+ * info with the time::modified and time::modified-usec attributes */
+guint64
+gedit_file_browser_cache_get_mtime (GFileInfo *info)
+{
+	return g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+	       g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+/* Returns the cached listing of @directory as a list of GFileInfo, and the
+ * modification time of the directory it was made from in @mtime, or NULL if
+ * the directory is not in the cache */
+GList *
+gedit_file_browser_cache_lookup (GFile   *directory,
+				 guint64 *mtime)
+{
+	gchar *filename;
+	gchar *contents;
+	gsize length;
+	GVariant *listing;
+	GVariantIter *iter;
+	guint32 version;
+	gchar const *name;
+	guint32 type;
+	gboolean hidden;
+	gboolean backup;
+	gchar const *content_type;
+	GList *infos = NULL;
+
+	filename = get_cache_filename (directory);
+
+	if (!g_file_get_contents (filename, &contents, &length, NULL))
+	{
+		g_free (filename);
+		return NULL;
+	}
+
+	/* Used, so not pruned */
+	g_utime (filename, NULL);
+	g_free (filename);
+
+	/* The data is checked when it is read, an invalid listing is empty */
+	listing = g_variant_new_from_data (G_VARIANT_TYPE (CACHE_FORMAT),
+					   contents,
+					   length,
+					   FALSE,
+					   g_free,
+					   contents);
+	g_variant_ref_sink (listing);
+
+	g_variant_get (listing, CACHE_FORMAT, &version, mtime, &iter);
+
+	while (version == CACHE_VERSION &&
+	       g_variant_iter_next (iter, "(^&ayubb&s)", &name, &type, &hidden, &backup, &content_type))
+	{
+		GFileInfo *info;
+
+		if (*name == '\0' || strchr (name, G_DIR_SEPARATOR) != NULL)
+			continue;
+
+		info = g_file_info_new ();
+		g_file_info_set_name (info, name);
+		g_file_info_set_file_type (info, type);
+		g_file_info_set_is_hidden (info, hidden);
+		g_file_info_set_is_backup (info, backup);
+
+		if (*content_type != '\0')
+		{
+			g_file_info_set_attribute_string (info,
+							  G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE,
+							  content_type);
+		}
+
+		infos = g_list_prepend (infos, info);
+	}
+
+	g_variant_iter_free (iter);
+	g_variant_unref (listing);
+
+	return g_list_reverse (infos);
+}
+
+/* Replaces the cached listing of @directory with @infos, a list of GFileInfo
+ * as enumerated when loading the directory. The cache is written in the
+ * background. */
+void
+gedit_file_browser_cache_store (GFile   *directory,
+				guint64  mtime,
+				GList   *infos)
+{
+	GVariantBuilder builder;
+	GVariant *listing;
+	GBytes *bytes;
+	gchar *filename;
+	gchar *dirname;
+
+	/* Racy, see above */
+	if ((gint64)mtime > g_get_real_time () - CACHE_MTIME_GRANULARITY)
+		mtime = 0;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" CACHE_ENTRY_FORMAT));
+
+	for (GList *item = infos; item; item = item->next)
+	{
+		GFileInfo *info = G_FILE_INFO (item->data);
+		gchar const *content_type;
+
+		content_type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+
+		g_variant_builder_add (&builder,
+				       "(^ayubbs)",
+				       g_file_info_get_name (info),
+				       g_file_info_get_file_type (info),
+				       g_file_info_get_is_hidden (info),
+				       g_file_info_get_is_backup (info),
+				       content_type != NULL ? content_type : "");
+	}
+
+	listing = g_variant_new ("(ut@a" CACHE_ENTRY_FORMAT ")",
+				 CACHE_VERSION,
+				 mtime,
+				 g_variant_builder_end (&builder));
+	g_variant_ref_sink (listing);
+
+	bytes = g_variant_get_data_as_bytes (listing);
+	filename = get_cache_filename (directory);
+	dirname = g_path_get_dirname (filename);
+
+	if (g_mkdir_with_parents (dirname, 0700) == 0)
+	{
+		GFile *file = g_file_new_for_path (filename);
+
+		g_file_replace_contents_bytes_async (file,
+						     bytes,
+						     NULL,
+						     FALSE,
+						     G_FILE_CREATE_PRIVATE | G_FILE_CREATE_REPLACE_DESTINATION,
+						     NULL,
+						     NULL,
+						     NULL);
+
+		g_object_unref (file);
+
+		prune_cache (dirname);
+	}
+
+	g_free (dirname);
+	g_free (filename);
+	g_bytes_unref (bytes);
+	g_variant_unref (listing);
+}
+
+/* ex:set ts=8 noet: */
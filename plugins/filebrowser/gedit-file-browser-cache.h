@@ -0,0 +1,36 @@
+/*
+ * gedit-file-browser-cache.h - Gedit plugin providing easy file access
+ * from the sidepanel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEDIT_FILE_BROWSER_CACHE_H
+#define GEDIT_FILE_BROWSER_CACHE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+GList		*gedit_file_browser_cache_lookup	(GFile     *directory,
+							 guint64   *mtime);
+void		 gedit_file_browser_cache_store		(GFile     *directory,
+							 guint64    mtime,
+							 GList     *infos);
+guint64		 gedit_file_browser_cache_get_mtime	(GFileInfo *info);
+
+G_END_DECLS
+
+#endif /* GEDIT_FILE_BROWSER_CACHE_H */
+/* ex:set ts=8 noet: */
@@ -188,6 +188,33 @@ message_get_root_cb (GeditMessageBus *bus,
 	}
 }
 
+static void
+message_get_selected_directory_cb (GeditMessageBus *bus,
+				   GeditMessage    *message,
+				   WindowData      *data)
+{
+	GeditFileBrowserStore *store;
+	GtkTreeIter iter;
+	GFile *location = NULL;
+
+	if (!gedit_file_browser_widget_get_selected_directory (data->widget, &iter))
+	{
+		return;
+	}
+
+	store = gedit_file_browser_widget_get_browser_store (data->widget);
+
+	gtk_tree_model_get (GTK_TREE_MODEL (store), &iter,
+			    GEDIT_FILE_BROWSER_STORE_COLUMN_LOCATION, &location,
+			    -1);
+
+	if (location)
+	{
+		g_object_set (message, "location", location, NULL);
+		g_object_unref (location);
+	}
+}
+
 static void
 message_set_root_cb (GeditMessageBus *bus,
 		     GeditMessage    *message,
@@ -668,6 +695,12 @@ register_methods (GeditWindow            *window,
 	                            MESSAGE_OBJECT_PATH,
 	                            "get_root");
 
+	/* The selected directory, or the root if nothing is selected */
+	gedit_message_bus_register (bus,
+	                            GEDIT_TYPE_FILE_BROWSER_MESSAGE_GET_ROOT,
+	                            MESSAGE_OBJECT_PATH,
+	                            "get_selected_directory");
+
 	gedit_message_bus_register (bus,
 	                            GEDIT_TYPE_FILE_BROWSER_MESSAGE_SET_ROOT,
 	                            MESSAGE_OBJECT_PATH,
@@ -744,6 +777,7 @@ register_methods (GeditWindow            *window,
 	                            "get_view");
 
 	BUS_CONNECT (bus, get_root, data);
+	BUS_CONNECT (bus, get_selected_directory, data);
 	BUS_CONNECT (bus, set_root, data);
 	BUS_CONNECT (bus, set_emblem, data);
 	BUS_CONNECT (bus, set_markup, data);
@@ -1047,6 +1081,7 @@ gedit_file_browser_messages_unregister (GeditWindow *window)
 	cleanup_signals (window);
 
 	BUS_DISCONNECT (bus, get_root, data);
+	BUS_DISCONNECT (bus, get_selected_directory, data);
 	BUS_DISCONNECT (bus, set_root, data);
 	BUS_DISCONNECT (bus, set_emblem, data);
 	BUS_DISCONNECT (bus, set_markup, data);
@@ -97,6 +97,10 @@ static void on_rename_cb		 (GeditFileBrowserStore         *model,
 					  GFile                         *oldfile,
 					  GFile                         *newfile,
 					  GeditWindow                   *window);
+static void on_delete_progress_cb        (GeditFileBrowserStore         *model,
+                                          guint                          n_done,
+                                          guint                          n_files,
+                                          GeditFileBrowserPlugin        *plugin);
 static void on_tab_added_cb              (GeditWindow                   *window,
                                           GeditTab                      *tab,
                                           GeditFileBrowserPlugin        *plugin);
@@ -555,6 +559,11 @@ gedit_file_browser_plugin_activate (GeditWindowActivatable *activatable)
 			  G_CALLBACK (on_rename_cb),
 			  priv->window);
 
+	g_signal_connect (store,
+	                  "delete-progress",
+	                  G_CALLBACK (on_delete_progress_cb),
+	                  plugin);
+
 	g_signal_connect (priv->window,
 	                  "tab-added",
 	                  G_CALLBACK (on_tab_added_cb),
@@ -572,6 +581,7 @@ gedit_file_browser_plugin_deactivate (GeditWindowActivatable *activatable)
 	GeditFileBrowserPlugin *plugin = GEDIT_FILE_BROWSER_PLUGIN (activatable);
 	GeditFileBrowserPluginPrivate *priv = plugin->priv;
 	GtkWidget *panel;
+	GeditFileBrowserStore *store;
 
 
 	/* Unregister messages from the bus */
@@ -582,6 +592,12 @@ gedit_file_browser_plugin_deactivate (GeditWindowActivatable *activatable)
 	                                      G_CALLBACK (on_tab_added_cb),
 	                                      plugin);
 
+	store = gedit_file_browser_widget_get_browser_store (priv->tree_widget);
+	g_signal_handlers_disconnect_by_func (store,
+	                                      G_CALLBACK (on_delete_progress_cb),
+	                                      plugin);
+	on_delete_progress_cb (store, 0, 0, plugin);
+
 	if (priv->click_policy_handle)
 	{
 		g_signal_handler_disconnect (priv->nautilus_settings,
@@ -819,6 +835,29 @@ on_virtual_root_changed_cb (GeditFileBrowserStore  *store,
 	g_free (uri_root);
 }
 
+/* Shows the progress of the deletions in the statusbar, until they end */
+static void
+on_delete_progress_cb (GeditFileBrowserStore  *store,
+		       guint                   n_done,
+		       guint                   n_files,
+		       GeditFileBrowserPlugin *plugin)
+{
+	GtkStatusbar *statusbar = GTK_STATUSBAR (gedit_window_get_statusbar (plugin->priv->window));
+	guint context_id = gtk_statusbar_get_context_id (statusbar, "file-browser-delete");
+
+	gtk_statusbar_remove_all (statusbar, context_id);
+
+	if (n_done < n_files)
+	{
+		gchar *message;
+
+		message = g_strdup_printf (_("Deleting files: %u of %u"),
+					   n_done, n_files);
+		gtk_statusbar_push (statusbar, context_id, message);
+		g_free (message);
+	}
+}
+
 static void
 on_tab_added_cb (GeditWindow            *window,
                  GeditTab               *tab,
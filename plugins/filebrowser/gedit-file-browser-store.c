@@ -29,6 +29,7 @@
 #include "gedit-file-browser-enum-types.h"
 #include "gedit-file-browser-error.h"
 #include "gedit-file-browser-utils.h"
+#include "gedit-file-browser-cache.h"
 
 #define NODE_IS_DIR(node)		(FILE_IS_DIR((node)->flags))
 #define NODE_IS_HIDDEN(node)		(FILE_IS_HIDDEN((node)->flags))
@@ -38,8 +39,16 @@
 #define NODE_IS_DUMMY(node)		(FILE_IS_DUMMY((node)->flags))
 
 #define FILE_BROWSER_NODE_DIR(node)	((FileBrowserNodeDir *)(node))
+#define DIR_CHILD(dir, i)		((FileBrowserNode *)g_ptr_array_index ((dir)->children, (i)))
+
+#define NAMES_CHUNK_SIZE 1024
+
+/* The number of files enumerated at a time when loading a directory is
+ * adapted so that adding them to the model takes about the given time */
+#define DIRECTORY_LOAD_ITEMS_PER_CALLBACK_MIN 32
+#define DIRECTORY_LOAD_ITEMS_PER_CALLBACK_MAX 4096
+#define DIRECTORY_LOAD_TIME_PER_CALLBACK (10 * 1000)
 
-#define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
 #define STANDARD_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
 				 G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
 			 	 G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
@@ -47,14 +56,70 @@
 				 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
 				 G_FILE_ATTRIBUTE_STANDARD_ICON
 
+/* Loading a directory only guesses the content types from the names, the
+ * rest is queried when the icon of a row is first needed, or before the row
+ * is shown when the binary files are hidden and the name was not enough */
+#define LOAD_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+			     G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+			     G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+			     G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+			     G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+
+/* The monitor events are handled in batches, at most every given ms */
+#define MONITOR_EVENTS_FLUSH_INTERVAL 100
+
+/* The deep filter enumerates that many directories at a time, and stops
+ * after finding the given number of files, or after enumerating the given
+ * number of directories. It does not go deeper than the given depth below
+ * the virtual root, nor in other file systems. */
+#define DEEP_FILTER_MAX_ENUMERATORS 4
+#define DEEP_FILTER_ITEMS_PER_CALLBACK 256
+#define DEEP_FILTER_MAX_MATCHES 1000
+#define DEEP_FILTER_MAX_DIRECTORIES 10000
+#define DEEP_FILTER_MAX_DEPTH 16
+
+#define DEEP_FILTER_ATTRIBUTE_TYPES LOAD_ATTRIBUTE_TYPES "," \
+				    G_FILE_ATTRIBUTE_ID_FILESYSTEM
+
+/* The directories to expand again are listed that many at a time, and the
+ * listings not used are dropped after the given number of seconds */
+#define PREFETCH_MAX_ENUMERATORS 8
+#define PREFETCH_LIFETIME 5
+
+/* Files are deleted that many at a time, and removed from the model at most
+ * every given ms. Only the first errors are reported. */
+#define DELETE_MAX_RUNNING 8
+#define DELETE_FLUSH_INTERVAL 100
+#define DELETE_MAX_ERRORS 10
+
+#define RESOLVE_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+				G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
+				G_FILE_ATTRIBUTE_STANDARD_ICON
+
 typedef struct _FileBrowserNode    FileBrowserNode;
 typedef struct _FileBrowserNodeDir FileBrowserNodeDir;
 typedef struct _AsyncData	   AsyncData;
 typedef struct _AsyncNode	   AsyncNode;
+typedef struct _MonitorQuery	   MonitorQuery;
+typedef struct _FilterPatterns	   FilterPatterns;
+typedef struct _DeepFilter	   DeepFilter;
+typedef struct _DeepFilterDir	   DeepFilterDir;
+typedef struct _Prefetch	   Prefetch;
+typedef struct _PrefetchDir	   PrefetchDir;
 
 typedef gint (*SortFunc) (FileBrowserNode *node1,
 			  FileBrowserNode *node2);
 
+/* What changed in the filtering, to refilter only the nodes it concerns */
+typedef enum
+{
+	FILTER_CHANGE_HIDDEN  = 1 << 0,
+	FILTER_CHANGE_BINARY  = 1 << 1,
+	FILTER_CHANGE_PATTERN = 1 << 2,
+	FILTER_CHANGE_DEEP    = 1 << 3,
+	FILTER_CHANGE_ALL     = ~0
+} FilterChange;
+
 struct _AsyncData
 {
 	GeditFileBrowserStore *model;
@@ -63,13 +128,127 @@ struct _AsyncData
 	GList                 *files;
 	GList                 *iter;
 	gboolean               removed;
+
+	/* The number of files being deleted, of files done, and of files to
+	 * delete in all */
+	gint                   running;
+	guint                  n_done;
+	guint                  n_files;
+
+	/* The deleted files not removed from the model yet */
+	GPtrArray             *deleted;
+	guint                  flush_id;
+
+	/* The files the trash is not supported for */
+	GList                 *no_trash;
+
+	/* The errors, reported together when the job is done */
+	GString               *errors;
+	guint                  n_errors;
 };
 
 struct _AsyncNode
 {
 	FileBrowserNodeDir *dir;
 	GCancellable       *cancellable;
-	GSList             *original_children;
+	gint                n_items;
+
+	/* The names of the children the directory had when the loading
+	 * started, NULL if it had none */
+	GHashTable         *original_children;
+
+	/* Whether the children were added from the cached listing, and the
+	 * modification time of the directory it was made from */
+	gboolean            cached;
+	guint64             cached_mtime;
+
+	/* The modification time of the directory before it is enumerated,
+	 * if known, and the files enumerated to update the cache */
+	gboolean            has_mtime;
+	guint64             mtime;
+	GList              *infos;
+
+	/* The names of the enumerated files, to remove the original children
+	 * which are gone */
+	GHashTable         *seen;
+};
+
+/* The queries of the files created in a directory, added to the model
+ * together when they are all done */
+struct _MonitorQuery
+{
+	FileBrowserNodeDir *dir;
+	GCancellable       *cancellable;
+	gint                n_pending;
+	GList              *infos;
+};
+
+/* A set of glob patterns compiled once, matched against the names of the
+ * nodes without copying them. The patterns without wildcards and those of
+ * the form "*suffix", like most binary patterns, are looked up in hash
+ * tables, the suffixes once for each of their lengths. */
+struct _FilterPatterns
+{
+	GHashTable *names;
+	GHashTable *suffixes;
+	GArray     *suffix_lengths;
+
+	/* The other patterns, as GPatternSpec */
+	GPtrArray  *specs;
+};
+
+/* The walk of the directories below the virtual root for the files matching
+ * the filter pattern. The model is NULL once the walk is stopped, it is then
+ * freed when the enumerations still running are done. */
+struct _DeepFilter
+{
+	GeditFileBrowserStore *model;
+	GCancellable          *cancellable;
+	GQueue                 pending;
+	gint                   running;
+	guint                  n_matches;
+	guint                  n_directories;
+
+	/* The file system of the virtual root, NULL until it is known */
+	gchar                 *filesystem;
+};
+
+struct _DeepFilterDir
+{
+	DeepFilter *deep;
+	GFile      *directory;
+	guint       depth;
+};
+
+/* The listings of the directories which are going to be expanded again, made
+ * in parallel before their nodes are loaded. The model is NULL once the
+ * prefetch is stopped, it is then freed when the enumerations still running
+ * are done. */
+struct _Prefetch
+{
+	GeditFileBrowserStore *model;
+	GCancellable          *cancellable;
+	GHashTable            *dirs;
+	GQueue                 pending;
+	gint                   running;
+	guint                  expire_id;
+};
+
+struct _PrefetchDir
+{
+	Prefetch  *prefetch;
+	GFile     *location;
+	guint      depth;
+	GList     *infos;
+
+	/* Whether the listing is complete, and whether it could not be made */
+	gboolean   done;
+	gboolean   failed;
+
+	/* Whether a load of the directory took the listing, and the load
+	 * waiting for it to be complete */
+	gboolean   used;
+	AsyncNode *async;
 };
 
 typedef struct {
@@ -79,30 +258,79 @@ typedef struct {
 	GCancellable          *cancellable;
 } MountInfo;
 
+/*
+ * A node is kept for every file of the loaded directories, so it only has
+ * what the model needs for the files which are not shown. The location of
+ * a file is made from the location of its directory when it is needed,
+ * and the markup of its row from its name.
+ */
 struct _FileBrowserNode
 {
-	GFile           *file;
-	guint            flags;
-	gchar           *icon_name;
-	gchar           *name;
-	gchar           *markup;
+	/* The name of the file, its name for display and the collate key of
+	 * the latter, in the names of the parent directory */
+	gchar const     *basename;
+	gchar const     *name;
+	gchar const     *collate_key;
+
+	/* Interned, possibly only guessed from the name */
+	gchar const     *content_type;
 
 	GdkPixbuf       *icon;
 	GdkPixbuf       *emblem;
 
 	FileBrowserNode *parent;
-	gint             pos;
-	gboolean         inserted;
+
+	/* The position of the node in the children of its parent */
+	guint            index;
+
+	guint            flags : 8;
+
+	/* Whether the icon has been made, or is being queried */
+	guint            resolved : 1;
+
+	/* Whether the name was not enough to guess the content type, which
+	 * is then still to be queried */
+	guint            type_unknown : 1;
+	guint            inserted : 1;
+
+	/* Whether the node is counted as a row in the index of the parent */
+	guint            indexed : 1;
+
+	/* Whether the row has the symbolic folder icon name, for the
+	 * directories above the virtual root */
+	guint            folder_icon_name : 1;
 };
 
 struct _FileBrowserNodeDir
 {
 	FileBrowserNode        node;
-	GSList                *children;
+	GFile                 *file;
+
+	/* The names of the children, each string stored once. They are only
+	 * freed with the directory. */
+	GStringChunk          *names;
+
+	/* Sorted with the sort function of the model, the dummy node first */
+	GPtrArray             *children;
+
+	/* Fenwick tree of the number of rows among the children, so that the
+	 * position of a row can be found in O(log n). It is rebuilt lazily
+	 * when children are added, removed or reordered. */
+	guint                 *rows;
+	gboolean               rows_valid;
 
 	GCancellable          *cancellable;
 	GFileMonitor          *monitor;
 	GeditFileBrowserStore *model;
+
+	/* The last monitor event of each file since the events were flushed,
+	 * by name, and the cancellable of the queries of created files */
+	GHashTable            *monitor_events;
+	GCancellable          *monitor_cancellable;
+
+	/* The names of the created files being queried, to their query, so
+	 * that the files deleted meanwhile are not added */
+	GHashTable            *monitor_pending;
 };
 
 struct _GeditFileBrowserStorePrivate
@@ -116,21 +344,56 @@ struct _GeditFileBrowserStorePrivate
 	gpointer                          filter_user_data;
 
 	gchar                           **binary_patterns;
-	GPtrArray                        *binary_pattern_specs;
+	FilterPatterns                   *binary_filter;
+
+	/* The pattern the names of the files are matched against */
+	gchar                            *filter_pattern;
+	FilterPatterns                   *pattern_filter;
 
 	SortFunc                          sort_func;
 
 	GSList                           *async_handles;
 	MountInfo                        *mount_info;
+
+	/* The markup of the rows which have one set, by node */
+	GHashTable                       *markups;
+
+	/* The nodes whose icon is being queried, to their GCancellable */
+	GHashTable                       *resolving;
+
+	/* The directories with monitor events to flush */
+	GHashTable                       *monitor_dirs;
+	guint                             monitor_flush_id;
+
+	/* The walk of the deep filter mode, if running */
+	DeepFilter                       *deep_filter;
+
+	/* The directories below the virtual root with files matching the deep
+	 * filter, the others being filtered, or NULL if it is not active */
+	GHashTable                       *deep_matches;
+
+	/* The listings of the directories to expand again */
+	Prefetch                         *prefetch;
 };
 
 static FileBrowserNode *model_find_node 		    (GeditFileBrowserStore  *model,
 							     FileBrowserNode        *node,
 							     GFile                  *uri);
+static void filter_patterns_free                            (FilterPatterns         *filter);
+static void model_deep_filter_start                         (GeditFileBrowserStore  *model);
+static void model_deep_filter_stop                          (GeditFileBrowserStore  *model);
+static void model_prefetch_stop                             (GeditFileBrowserStore  *model);
+static void model_remove_children_named                     (GeditFileBrowserStore  *model,
+							     FileBrowserNode        *parent,
+							     GHashTable             *names);
 static void model_remove_node                               (GeditFileBrowserStore  *model,
 							     FileBrowserNode        *node,
 							     GtkTreePath            *path,
 							     gboolean                free_nodes);
+static void model_resolve_node                              (GeditFileBrowserStore  *model,
+							     FileBrowserNode        *node);
+static void model_resolve_node_query                        (GeditFileBrowserStore  *model,
+							     FileBrowserNode        *node);
 
 static void set_virtual_root_from_node                      (GeditFileBrowserStore  *model,
 				                             FileBrowserNode        *node);
@@ -225,6 +488,8 @@ enum
 	END_REFRESH,
 	UNLOAD,
 	BEFORE_ROW_DELETED,
+	DELETE_PROGRESS,
+	DEEP_FILTER_MATCH,
 	NUM_SIGNALS
 };
 
@@ -246,14 +511,21 @@ gedit_file_browser_store_finalize (GObject *object)
 {
 	GeditFileBrowserStore *obj = GEDIT_FILE_BROWSER_STORE (object);
 
+	model_deep_filter_stop (obj);
+
+	if (obj->priv->deep_matches != NULL)
+		g_hash_table_destroy (obj->priv->deep_matches);
+
 	/* Free all the nodes */
 	file_browser_node_free (obj, obj->priv->root);
 
-	if (obj->priv->binary_patterns != NULL)
-	{
-		g_strfreev (obj->priv->binary_patterns);
-		g_ptr_array_unref (obj->priv->binary_pattern_specs);
-	}
+	/* After the nodes, which cancel the loads waiting for a listing */
+	model_prefetch_stop (obj);
+
+	g_strfreev (obj->priv->binary_patterns);
+	filter_patterns_free (obj->priv->binary_filter);
+	g_free (obj->priv->filter_pattern);
+	filter_patterns_free (obj->priv->pattern_filter);
 
 	/* Cancel any asynchronous operations */
 	for (GSList *item = obj->priv->async_handles; item; item = item->next)
@@ -262,14 +534,41 @@ gedit_file_browser_store_finalize (GObject *object)
 		g_cancellable_cancel (data->cancellable);
 
 		data->removed = TRUE;
+
+		if (data->flush_id != 0)
+		{
+			g_source_remove (data->flush_id);
+			data->flush_id = 0;
+		}
 	}
 
 	cancel_mount_operation (obj);
 
 	g_slist_free (obj->priv->async_handles);
+	g_hash_table_destroy (obj->priv->resolving);
+	g_hash_table_destroy (obj->priv->monitor_dirs);
+	g_hash_table_destroy (obj->priv->markups);
+
+	if (obj->priv->monitor_flush_id != 0)
+		g_source_remove (obj->priv->monitor_flush_id);
+
 	G_OBJECT_CLASS (gedit_file_browser_store_parent_class)->finalize (object);
 }
 
+/* Returns a new reference to the location of @node, or NULL for a dummy
+ * node. Only the directories keep theirs. */
+static GFile *
+node_get_file (FileBrowserNode *node)
+{
+	if (NODE_IS_DIR (node))
+		return g_object_ref (FILE_BROWSER_NODE_DIR (node)->file);
+
+	if (node->basename == NULL)
+		return NULL;
+
+	return g_file_get_child (FILE_BROWSER_NODE_DIR (node->parent)->file, node->basename);
+}
+
 static void
 set_gvalue_from_node (GValue          *value,
                       FileBrowserNode *node)
@@ -277,7 +576,7 @@ set_gvalue_from_node (GValue          *value,
 	if (node == NULL)
 		g_value_set_object (value, NULL);
 	else
-		g_value_set_object (value, node->file);
+		g_value_take_object (value, node_get_file (node));
 }
 
 static void
@@ -433,6 +732,20 @@ gedit_file_browser_store_class_init (GeditFileBrowserStoreClass *klass)
 			  NULL, NULL, NULL,
 			  G_TYPE_NONE, 1,
 			  GTK_TYPE_TREE_PATH | G_SIGNAL_TYPE_STATIC_SCOPE);
+	model_signals[DELETE_PROGRESS] =
+	    g_signal_new ("delete-progress",
+			  G_OBJECT_CLASS_TYPE (object_class),
+			  G_SIGNAL_RUN_LAST,
+			  G_STRUCT_OFFSET (GeditFileBrowserStoreClass, delete_progress),
+			  NULL, NULL, NULL,
+			  G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_UINT);
+	model_signals[DEEP_FILTER_MATCH] =
+	    g_signal_new ("deep-filter-match",
+			  G_OBJECT_CLASS_TYPE (object_class),
+			  G_SIGNAL_RUN_LAST,
+			  G_STRUCT_OFFSET (GeditFileBrowserStoreClass, deep_filter_match),
+			  NULL, NULL, NULL,
+			  G_TYPE_NONE, 1, GTK_TYPE_TREE_ITER);
 }
 
 static void
@@ -482,6 +795,13 @@ gedit_file_browser_store_init (GeditFileBrowserStore *obj)
 	/* Default filter mode is hiding the hidden files */
 	obj->priv->filter_mode = gedit_file_browser_store_filter_mode_get_default ();
 	obj->priv->sort_func = model_sort_default;
+
+	obj->priv->resolving = g_hash_table_new_full (g_direct_hash,
+						      g_direct_equal,
+						      NULL,
+						      g_object_unref);
+	obj->priv->monitor_dirs = g_hash_table_new (g_direct_hash, g_direct_equal);
+	obj->priv->markups = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
 }
 
 static gboolean
@@ -523,12 +843,118 @@ model_node_visibility (GeditFileBrowserStore *model,
 	return !NODE_IS_FILTERED (node);
 }
 
-static gboolean
-model_node_inserted (GeditFileBrowserStore *model,
-		     FileBrowserNode       *node)
+static void
+dir_invalidate_rows (FileBrowserNodeDir *dir)
+{
+	dir->rows_valid = FALSE;
+}
+
+static void
+dir_ensure_rows (FileBrowserNodeDir *dir)
+{
+	guint len = dir->children->len;
+
+	if (dir->rows_valid)
+		return;
+
+	g_free (dir->rows);
+	dir->rows = g_new0 (guint, len + 1);
+
+	for (guint i = 0; i < len; ++i)
+	{
+		FileBrowserNode *child = DIR_CHILD (dir, i);
+
+		child->index = i;
+		child->indexed = child->inserted && model_node_visibility (dir->model, child);
+
+		if (child->indexed)
+			dir->rows[i + 1] += 1;
+	}
+
+	for (guint i = 1; i <= len; ++i)
+	{
+		guint j = i + (i & -i);
+
+		if (j <= len)
+			dir->rows[j] += dir->rows[i];
+	}
+
+	dir->rows_valid = TRUE;
+}
+
+/* Returns the number of rows among the first @end children of @dir */
+static guint
+dir_count_rows (FileBrowserNodeDir *dir,
+		guint               end)
+{
+	guint count = 0;
+
+	dir_ensure_rows (dir);
+
+	for (guint i = end; i > 0; i -= i & -i)
+		count += dir->rows[i];
+
+	return count;
+}
+
+/* Returns the child of @dir which is the row at position @n */
+static FileBrowserNode *
+dir_nth_row (FileBrowserNodeDir *dir,
+	     guint               n)
+{
+	guint len = dir->children->len;
+	guint pos = 0;
+	guint bit = 1;
+
+	dir_ensure_rows (dir);
+
+	while (bit <= len / 2)
+		bit <<= 1;
+
+	for (; bit > 0 && len > 0; bit >>= 1)
+	{
+		if (pos + bit <= len && dir->rows[pos + bit] <= n)
+		{
+			pos += bit;
+			n -= dir->rows[pos];
+		}
+	}
+
+	if (pos >= len)
+		return NULL;
+
+	return DIR_CHILD (dir, pos);
+}
+
+/* Updates the row index of the parent of @node after @node has been inserted
+ * or deleted, or its visibility has changed */
+static void
+model_node_update_row (GeditFileBrowserStore *model,
+		       FileBrowserNode       *node)
 {
-	return node == model->priv->virtual_root ||
-	       (model_node_visibility (model, node) && node->inserted);
+	gboolean indexed = node->inserted && model_node_visibility (model, node);
+	FileBrowserNodeDir *dir;
+
+	if (indexed == node->indexed)
+		return;
+
+	node->indexed = indexed;
+
+	if (node->parent == NULL)
+		return;
+
+	dir = FILE_BROWSER_NODE_DIR (node->parent);
+
+	if (!dir->rows_valid)
+		return;
+
+	for (guint i = node->index + 1; i <= dir->children->len; i += i & -i)
+	{
+		if (indexed)
+			dir->rows[i] += 1;
+		else
+			dir->rows[i] -= 1;
+	}
 }
 
 /* Interface implementation */
@@ -578,32 +1004,16 @@ gedit_file_browser_store_get_iter (GtkTreeModel *tree_model,
 
 	for (guint i = 0; i < depth; ++i)
 	{
-		GSList *item;
-		gint num = 0;
-
 		if (node == NULL)
 			return FALSE;
 
 		if (!NODE_IS_DIR (node))
 			return FALSE;
 
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-		{
-			FileBrowserNode *child = (FileBrowserNode *)(item->data);
-
-			if (model_node_inserted (model, child))
-			{
-				if (num == indices[i])
-					break;
-
-				num++;
-			}
-		}
+		node = dir_nth_row (FILE_BROWSER_NODE_DIR (node), indices[i]);
 
-		if (item == NULL)
+		if (node == NULL)
 			return FALSE;
-
-		node = (FileBrowserNode *)(item->data);
 	}
 
 	iter->user_data = node;
@@ -618,42 +1028,32 @@ gedit_file_browser_store_get_path_real (GeditFileBrowserStore *model,
 					FileBrowserNode       *node)
 {
 	GtkTreePath *path = gtk_tree_path_new ();
-	gint num = 0;
 
 	while (node != model->priv->virtual_root)
 	{
+		FileBrowserNodeDir *dir;
+
 		if (node->parent == NULL)
 		{
 			gtk_tree_path_free (path);
 			return NULL;
 		}
 
-		num = 0;
-
-		for (GSList *item = FILE_BROWSER_NODE_DIR (node->parent)->children; item; item = item->next)
+		if (!model_node_visibility (model, node))
 		{
-			FileBrowserNode *check = (FileBrowserNode *)(item->data);
-
-			if (model_node_visibility (model, check) && (check == node || check->inserted))
-			{
-				if (check == node)
-				{
-					gtk_tree_path_prepend_index (path, num);
-					break;
-				}
-
-				++num;
-			}
-			else if (check == node)
-			{
-				if (NODE_IS_DUMMY (node))
-					g_warning ("Dummy not visible???");
+			if (NODE_IS_DUMMY (node))
+				g_warning ("Dummy not visible???");
 
-				gtk_tree_path_free (path);
-				return NULL;
-			}
+			gtk_tree_path_free (path);
+			return NULL;
 		}
 
+		/* The node may not be inserted yet, its position is the number
+		   of rows before it */
+		dir = FILE_BROWSER_NODE_DIR (node->parent);
+		dir_ensure_rows (dir);
+		gtk_tree_path_prepend_index (path, dir_count_rows (dir, node->index));
+
 		node = node->parent;
 	}
 
@@ -694,16 +1094,28 @@ gedit_file_browser_store_get_value (GtkTreeModel *tree_model,
 			set_gvalue_from_node (value, node);
 			break;
 		case GEDIT_FILE_BROWSER_STORE_COLUMN_MARKUP:
-			g_value_set_string (value, node->markup);
+		{
+			gchar const *markup;
+
+			markup = g_hash_table_lookup (GEDIT_FILE_BROWSER_STORE (tree_model)->priv->markups, node);
+
+			if (markup != NULL)
+				g_value_set_string (value, markup);
+			else if (node->name != NULL)
+				g_value_take_string (value, g_markup_escape_text (node->name, -1));
+
 			break;
+		}
 		case GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS:
 			g_value_set_uint (value, node->flags);
 			break;
 		case GEDIT_FILE_BROWSER_STORE_COLUMN_ICON:
+			/* Resolved for the visible rows by the view, the other
+			 * rows being measured in the background too */
 			g_value_set_object (value, node->icon);
 			break;
 		case GEDIT_FILE_BROWSER_STORE_COLUMN_ICON_NAME:
-			g_value_set_string (value, node->icon_name);
+			g_value_set_static_string (value, node->folder_icon_name ? "folder-symbolic" : NULL);
 			break;
 		case GEDIT_FILE_BROWSER_STORE_COLUMN_NAME:
 			g_value_set_string (value, node->name);
@@ -720,32 +1132,27 @@ static gboolean
 gedit_file_browser_store_iter_next (GtkTreeModel *tree_model,
 				    GtkTreeIter  *iter)
 {
-	GeditFileBrowserStore *model;
 	FileBrowserNode *node;
-	GSList *first;
+	FileBrowserNodeDir *dir;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), FALSE);
 	g_return_val_if_fail (iter != NULL, FALSE);
 	g_return_val_if_fail (iter->user_data != NULL, FALSE);
 
-	model = GEDIT_FILE_BROWSER_STORE (tree_model);
 	node = (FileBrowserNode *)(iter->user_data);
 
 	if (node->parent == NULL)
 		return FALSE;
 
-	first = g_slist_next (g_slist_find (FILE_BROWSER_NODE_DIR (node->parent)->children, node));
+	dir = FILE_BROWSER_NODE_DIR (node->parent);
+	dir_ensure_rows (dir);
+	node = dir_nth_row (dir, dir_count_rows (dir, node->index + 1));
 
-	for (GSList *item = first; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-		{
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
+	if (node == NULL)
+		return FALSE;
 
-	return FALSE;
+	iter->user_data = node;
+	return TRUE;
 }
 
 static gboolean
@@ -754,6 +1161,7 @@ gedit_file_browser_store_iter_children (GtkTreeModel *tree_model,
 					GtkTreeIter  *parent)
 {
 	FileBrowserNode *node;
+	FileBrowserNodeDir *dir;
 	GeditFileBrowserStore *model;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), FALSE);
@@ -772,32 +1180,28 @@ gedit_file_browser_store_iter_children (GtkTreeModel *tree_model,
 	if (!NODE_IS_DIR (node))
 		return FALSE;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-		{
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
+	dir = FILE_BROWSER_NODE_DIR (node);
+	node = dir_nth_row (dir, 0);
 
-	return FALSE;
+	if (node == NULL)
+		return FALSE;
+
+	iter->user_data = node;
+	return TRUE;
 }
 
 static gboolean
 filter_tree_model_iter_has_child_real (GeditFileBrowserStore *model,
 				       FileBrowserNode       *node)
 {
+	FileBrowserNodeDir *dir;
+
 	if (!NODE_IS_DIR (node))
 		return FALSE;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-			return TRUE;
-	}
+	dir = FILE_BROWSER_NODE_DIR (node);
 
-	return FALSE;
+	return dir_count_rows (dir, dir->children->len) > 0;
 }
 
 static gboolean
@@ -825,6 +1229,7 @@ gedit_file_browser_store_iter_n_children (GtkTreeModel *tree_model,
 					  GtkTreeIter  *iter)
 {
 	FileBrowserNode *node;
+	FileBrowserNodeDir *dir;
 	GeditFileBrowserStore *model;
 	gint num = 0;
 
@@ -841,11 +1246,8 @@ gedit_file_browser_store_iter_n_children (GtkTreeModel *tree_model,
 	if (!NODE_IS_DIR (node))
 		return 0;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-			++num;
-	}
+	dir = FILE_BROWSER_NODE_DIR (node);
+	num = dir_count_rows (dir, dir->children->len);
 
 	return num;
 }
@@ -857,8 +1259,8 @@ gedit_file_browser_store_iter_nth_child (GtkTreeModel *tree_model,
 					 gint          n)
 {
 	FileBrowserNode *node;
+	FileBrowserNodeDir *dir;
 	GeditFileBrowserStore *model;
-	gint num = 0;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), FALSE);
 	g_return_val_if_fail (parent == NULL || parent->user_data != NULL, FALSE);
@@ -873,18 +1275,13 @@ gedit_file_browser_store_iter_nth_child (GtkTreeModel *tree_model,
 	if (!NODE_IS_DIR (node))
 		return FALSE;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *)(item->data)))
-		{
-			if (num == n)
-			{
-				iter->user_data = item->data;
-				return TRUE;
-			}
+	dir = FILE_BROWSER_NODE_DIR (node);
+	node = dir_nth_row (dir, n);
 
-			++num;
-		}
+	if (node != NULL)
+	{
+		iter->user_data = node;
+		return TRUE;
 	}
 
 	return FALSE;
@@ -923,6 +1320,7 @@ gedit_file_browser_store_row_inserted (GtkTreeModel *tree_model,
 	FileBrowserNode *node = (FileBrowserNode *)(iter->user_data);
 
 	node->inserted = TRUE;
+	model_node_update_row (GEDIT_FILE_BROWSER_STORE (tree_model), node);
 }
 
 static gboolean
@@ -979,71 +1377,213 @@ gedit_file_browser_store_drag_data_get (GtkTreeDragSource *drag_source,
 
 #define FILTER_HIDDEN(mode) (mode & GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_HIDDEN)
 #define FILTER_BINARY(mode) (mode & GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_BINARY)
+#define FILTER_DEEP(mode) (mode & GEDIT_FILE_BROWSER_STORE_FILTER_MODE_DEEP)
 
-/* Private */
-static void
-model_begin_loading (GeditFileBrowserStore *model,
-		     FileBrowserNode       *node)
+static gboolean
+pattern_has_wildcards (const gchar *pattern)
 {
-	GtkTreeIter iter;
-
-	iter.user_data = node;
-	g_signal_emit (model, model_signals[BEGIN_LOADING], 0, &iter);
+	return strpbrk (pattern, "*?") != NULL;
 }
 
-static void
-model_end_loading (GeditFileBrowserStore *model,
-		   FileBrowserNode       *node)
+static FilterPatterns *
+filter_patterns_new (const gchar * const *patterns)
 {
-	GtkTreeIter iter;
-
-	iter.user_data = node;
-	g_signal_emit (model, model_signals[END_LOADING], 0, &iter);
-}
+	FilterPatterns *filter;
 
-static void
-model_node_update_visibility (GeditFileBrowserStore *model,
-			      FileBrowserNode       *node)
-{
-	GtkTreeIter iter;
+	if (patterns == NULL || patterns[0] == NULL)
+		return NULL;
 
-	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+	filter = g_slice_new (FilterPatterns);
+	filter->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	filter->suffixes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	filter->suffix_lengths = g_array_new (FALSE, FALSE, sizeof (gsize));
+	filter->specs = g_ptr_array_new_with_free_func ((GDestroyNotify)g_pattern_spec_free);
 
-	if (FILTER_HIDDEN (model->priv->filter_mode) &&
-	    NODE_IS_HIDDEN (node))
+	for (guint i = 0; patterns[i] != NULL; ++i)
 	{
-		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
-		return;
-	}
+		const gchar *pattern = patterns[i];
 
-	if (FILTER_BINARY (model->priv->filter_mode) && !NODE_IS_DIR (node))
-	{
-		if (!NODE_IS_TEXT (node))
+		if (!pattern_has_wildcards (pattern))
 		{
-			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
-			return;
+			g_hash_table_add (filter->names, g_strdup (pattern));
 		}
-		else if (model->priv->binary_patterns != NULL)
+		else if (pattern[0] == '*' && !pattern_has_wildcards (pattern + 1))
 		{
-			gssize name_length = strlen (node->name);
-			gchar *name_reversed = g_utf8_strreverse (node->name, name_length);
+			gsize length = strlen (pattern + 1);
+			guint j;
 
-			for (guint i = 0; i < model->priv->binary_pattern_specs->len; ++i)
-			{
-				GPatternSpec *spec = g_ptr_array_index (model->priv->binary_pattern_specs, i);
+			g_hash_table_add (filter->suffixes, g_strdup (pattern + 1));
 
-				if (g_pattern_match (spec, name_length, node->name, name_reversed))
-				{
-					node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
-					g_free (name_reversed);
-					return;
-				}
+			for (j = 0; j < filter->suffix_lengths->len; ++j)
+			{
+				if (g_array_index (filter->suffix_lengths, gsize, j) == length)
+					break;
 			}
 
-			g_free (name_reversed);
+			if (j == filter->suffix_lengths->len)
+				g_array_append_val (filter->suffix_lengths, length);
+		}
+		else
+		{
+			g_ptr_array_add (filter->specs, g_pattern_spec_new (pattern));
+		}
+	}
+
+	return filter;
+}
+
+static void
+filter_patterns_free (FilterPatterns *filter)
+{
+	if (filter == NULL)
+		return;
+
+	g_hash_table_destroy (filter->names);
+	g_hash_table_destroy (filter->suffixes);
+	g_array_unref (filter->suffix_lengths);
+	g_ptr_array_unref (filter->specs);
+
+	g_slice_free (FilterPatterns, filter);
+}
+
+static gboolean
+filter_patterns_match (FilterPatterns *filter,
+		       const gchar    *name)
+{
+	gsize length = strlen (name);
+
+	if (g_hash_table_contains (filter->names, name))
+		return TRUE;
+
+	for (guint i = 0; i < filter->suffix_lengths->len; ++i)
+	{
+		gsize suffix_length = g_array_index (filter->suffix_lengths, gsize, i);
+
+		if (suffix_length <= length &&
+		    g_hash_table_contains (filter->suffixes, name + length - suffix_length))
+		{
+			return TRUE;
+		}
+	}
+
+	/* The reversed name is only made by GLib for the patterns which
+	 * need it */
+	for (guint i = 0; i < filter->specs->len; ++i)
+	{
+		GPatternSpec *spec = g_ptr_array_index (filter->specs, i);
+
+#if GLIB_CHECK_VERSION (2, 70, 0)
+		if (g_pattern_spec_match (spec, length, name, NULL))
+#else
+		if (g_pattern_match (spec, length, name, NULL))
+#endif
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Returns whether the filtering of @node can be changed by @changes */
+static gboolean
+model_node_filter_can_change (FileBrowserNode *node,
+			      FilterChange     changes)
+{
+	/* Whether the dummy node is shown does not depend on the filters */
+	if (NODE_IS_DUMMY (node))
+		return FALSE;
+
+	if (changes == FILTER_CHANGE_ALL)
+		return TRUE;
+
+	if ((changes & FILTER_CHANGE_HIDDEN) && NODE_IS_HIDDEN (node))
+		return TRUE;
+
+	/* The deep filter only filters directories */
+	if ((changes & FILTER_CHANGE_DEEP) && NODE_IS_DIR (node))
+		return TRUE;
+
+	/* The binary files and the patterns only filter files */
+	return (changes & (FILTER_CHANGE_BINARY | FILTER_CHANGE_PATTERN)) && !NODE_IS_DIR (node);
+}
+
+/* Private */
+static void
+model_begin_loading (GeditFileBrowserStore *model,
+		     FileBrowserNode       *node)
+{
+	GtkTreeIter iter;
+
+	iter.user_data = node;
+	g_signal_emit (model, model_signals[BEGIN_LOADING], 0, &iter);
+}
+
+static void
+model_end_loading (GeditFileBrowserStore *model,
+		   FileBrowserNode       *node)
+{
+	GtkTreeIter iter;
+
+	iter.user_data = node;
+	g_signal_emit (model, model_signals[END_LOADING], 0, &iter);
+}
+
+static void
+model_node_update_filtered (GeditFileBrowserStore *model,
+			    FileBrowserNode       *node)
+{
+	GtkTreeIter iter;
+
+	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+
+	if (FILTER_HIDDEN (model->priv->filter_mode) &&
+	    NODE_IS_HIDDEN (node))
+	{
+		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+		return;
+	}
+
+	if (FILTER_BINARY (model->priv->filter_mode) && !NODE_IS_DIR (node))
+	{
+		/* Hidden until the content type is known, not to be shown
+		 * and then hidden again */
+		if (node->type_unknown)
+		{
+			if (!node->resolved)
+				model_resolve_node (model, node);
+
+			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+			return;
+		}
+
+		if (!NODE_IS_TEXT (node))
+		{
+			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+			return;
+		}
+		else if (model->priv->binary_filter != NULL &&
+			 filter_patterns_match (model->priv->binary_filter, node->name))
+		{
+			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+			return;
 		}
 	}
 
+	if (model->priv->pattern_filter != NULL && !NODE_IS_DIR (node) &&
+	    !NODE_IS_DUMMY (node) &&
+	    !filter_patterns_match (model->priv->pattern_filter, node->name))
+	{
+		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+		return;
+	}
+
+	if (model->priv->deep_matches != NULL && NODE_IS_DIR (node) &&
+	    node_in_tree (model, node) &&
+	    !g_hash_table_contains (model->priv->deep_matches, FILE_BROWSER_NODE_DIR (node)->file))
+	{
+		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+		return;
+	}
+
 	if (model->priv->filter_func)
 	{
 		iter.user_data = node;
@@ -1053,28 +1593,29 @@ model_node_update_visibility (GeditFileBrowserStore *model,
 	}
 }
 
+static void
+model_node_update_visibility (GeditFileBrowserStore *model,
+			      FileBrowserNode       *node)
+{
+	model_node_update_filtered (model, node);
+	model_node_update_row (model, node);
+}
+
 static gint
 collate_nodes (FileBrowserNode *node1,
 	       FileBrowserNode *node2)
 {
-	if (node1->name == NULL)
+	if (node1->collate_key == NULL)
 	{
 		return -1;
 	}
-	else if (node2->name == NULL)
+	else if (node2->collate_key == NULL)
 	{
 		return 1;
 	}
 	else
 	{
-		gchar *k1 = g_utf8_collate_key_for_filename (node1->name, -1);
-		gchar *k2 = g_utf8_collate_key_for_filename (node2->name, -1);
-		gint result = strcmp (k1, k2);
-
-		g_free (k1);
-		g_free (k2);
-
-		return result;
+		return strcmp (node1->collate_key, node2->collate_key);
 	}
 }
 
@@ -1099,6 +1640,24 @@ model_sort_default (FileBrowserNode *node1,
 	return collate_nodes (node1, node2);
 }
 
+static gint
+model_sort_nodes (gconstpointer a,
+		  gconstpointer b,
+		  gpointer      user_data)
+{
+	GeditFileBrowserStore *model = GEDIT_FILE_BROWSER_STORE (user_data);
+
+	return model->priv->sort_func (*(FileBrowserNode **)a, *(FileBrowserNode **)b);
+}
+
+static void
+model_sort_children (GeditFileBrowserStore *model,
+		     GPtrArray             *children)
+{
+	if (model->priv->sort_func != NULL)
+		g_ptr_array_sort_with_data (children, model_sort_nodes, model);
+}
+
 static void
 model_resort_node (GeditFileBrowserStore *model,
 		   FileBrowserNode       *node)
@@ -1108,7 +1667,8 @@ model_resort_node (GeditFileBrowserStore *model,
 	if (!model_node_visibility (model, node->parent))
 	{
 		/* Just sort the children of the parent */
-		dir->children = g_slist_sort (dir->children, (GCompareFunc)(model->priv->sort_func));
+		model_sort_children (model, dir->children);
+		dir_invalidate_rows (dir);
 	}
 	else
 	{
@@ -1117,26 +1677,28 @@ model_resort_node (GeditFileBrowserStore *model,
 		gint *neworder;
 		gint pos = 0;
 
-		/* Store current positions */
-		for (GSList *item = dir->children; item; item = item->next)
+		/* Store current positions, the children are indexed again
+		   after they are sorted */
+		for (guint i = 0; i < dir->children->len; ++i)
 		{
-			FileBrowserNode *child = (FileBrowserNode *)(item->data);
+			FileBrowserNode *child = DIR_CHILD (dir, i);
 
 			if (model_node_visibility (model, child))
-				child->pos = pos++;
+				child->index = pos++;
 		}
 
-		dir->children = g_slist_sort (dir->children, (GCompareFunc)(model->priv->sort_func));
+		model_sort_children (model, dir->children);
+		dir_invalidate_rows (dir);
 		neworder = g_new (gint, pos);
 		pos = 0;
 
 		/* Store the new positions */
-		for (GSList *item = dir->children; item; item = item->next)
+		for (guint i = 0; i < dir->children->len; ++i)
 		{
-			FileBrowserNode *child = (FileBrowserNode *)(item->data);
+			FileBrowserNode *child = DIR_CHILD (dir, i);
 
 			if (model_node_visibility (model, child))
-				neworder[pos++] = child->pos;
+				neworder[pos++] = child->index;
 		}
 
 		iter.user_data = node->parent;
@@ -1217,6 +1779,7 @@ row_deleted (GeditFileBrowserStore *model,
 	gtk_tree_path_free (copy);
 
 	node->inserted = FALSE;
+	model_node_update_row (model, node);
 
 	if (hidden)
 		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
@@ -1227,14 +1790,14 @@ row_deleted (GeditFileBrowserStore *model,
 }
 
 static void
-model_refilter_node (GeditFileBrowserStore  *model,
-		     FileBrowserNode        *node,
-		     GtkTreePath           **path)
+model_refilter_node_changes (GeditFileBrowserStore  *model,
+			     FileBrowserNode        *node,
+			     GtkTreePath           **path,
+			     FilterChange            changes)
 {
 	gboolean old_visible;
 	gboolean new_visible;
 	FileBrowserNodeDir *dir;
-	GSList *item;
 	GtkTreeIter iter;
 	GtkTreePath *tmppath = NULL;
 	gboolean in_tree;
@@ -1243,7 +1806,9 @@ model_refilter_node (GeditFileBrowserStore  *model,
 		return;
 
 	old_visible = model_node_visibility (model, node);
-	model_node_update_visibility (model, node);
+
+	if (model_node_filter_can_change (node, changes))
+		model_node_update_visibility (model, node);
 
 	in_tree = node_in_tree (model, node);
 
@@ -1264,8 +1829,8 @@ model_refilter_node (GeditFileBrowserStore  *model,
 
 		dir = FILE_BROWSER_NODE_DIR (node);
 
-		for (item = dir->children; item; item = item->next)
-			model_refilter_node (model, (FileBrowserNode *)(item->data), path);
+		for (guint i = 0; i < dir->children->len; ++i)
+			model_refilter_node_changes (model, DIR_CHILD (dir, i), path, changes);
 
 		if (in_tree)
 			gtk_tree_path_up (*path);
@@ -1301,26 +1866,53 @@ model_refilter_node (GeditFileBrowserStore  *model,
 }
 
 static void
-model_refilter (GeditFileBrowserStore *model)
+model_refilter_node (GeditFileBrowserStore  *model,
+		     FileBrowserNode        *node,
+		     GtkTreePath           **path)
+{
+	model_refilter_node_changes (model, node, path, FILTER_CHANGE_ALL);
+}
+
+static void
+model_refilter (GeditFileBrowserStore *model,
+		FilterChange           changes)
+{
+	model_refilter_node_changes (model, model->priv->root, NULL, changes);
+}
+
+/* Returns the string of the names of the parent of @node, or of @node itself
+ * for the root, equal to @str */
+static gchar const *
+file_browser_node_intern (FileBrowserNode *node,
+			  gchar const     *str)
 {
-	model_refilter_node (model, model->priv->root, NULL);
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node->parent != NULL ? node->parent : node);
+
+	if (dir->names == NULL)
+		dir->names = g_string_chunk_new (NAMES_CHUNK_SIZE);
+
+	return g_string_chunk_insert_const (dir->names, str);
 }
 
 static void
-file_browser_node_set_name (FileBrowserNode *node)
+file_browser_node_set_name (FileBrowserNode *node,
+			    GFile           *file)
 {
-	g_free (node->name);
-	g_free (node->markup);
+	gchar *basename;
+	gchar *name;
+	gchar *collate_key;
 
-	if (node->file)
-		node->name = gedit_file_browser_utils_file_basename (node->file);
-	else
-		node->name = NULL;
+	basename = g_file_get_basename (file);
+	name = gedit_file_browser_utils_file_basename (file);
+	collate_key = g_utf8_collate_key_for_filename (name, -1);
 
-	if (node->name)
-		node->markup = g_markup_escape_text (node->name, -1);
-	else
-		node->markup = NULL;
+	node->basename = file_browser_node_intern (node, basename);
+	node->name = file_browser_node_intern (node, name);
+	node->collate_key = file_browser_node_intern (node, collate_key);
+
+	g_free (collate_key);
+	g_free (name);
+	g_free (basename);
 }
 
 static void
@@ -1328,13 +1920,10 @@ file_browser_node_init (FileBrowserNode *node,
 			GFile           *file,
 			FileBrowserNode *parent)
 {
-	if (file != NULL)
-	{
-		node->file = g_object_ref (file);
-		file_browser_node_set_name (node);
-	}
-
 	node->parent = parent;
+
+	if (file != NULL)
+		file_browser_node_set_name (node, file);
 }
 
 static FileBrowserNode *
@@ -1354,27 +1943,50 @@ file_browser_node_dir_new (GeditFileBrowserStore *model,
 {
 	FileBrowserNode *node = (FileBrowserNode *)g_slice_new0 (FileBrowserNodeDir);
 
+	FILE_BROWSER_NODE_DIR (node)->file = g_object_ref (file);
 	file_browser_node_init (node, file, parent);
 
 	node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
 
+	FILE_BROWSER_NODE_DIR (node)->children = g_ptr_array_new ();
 	FILE_BROWSER_NODE_DIR (node)->model = model;
 
 	return node;
 }
 
+static void
+model_clear_monitor_events (GeditFileBrowserStore *model,
+			    FileBrowserNode       *node)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+
+	g_hash_table_remove (model->priv->monitor_dirs, node);
+	g_clear_pointer (&dir->monitor_events, g_hash_table_unref);
+	g_clear_pointer (&dir->monitor_pending, g_hash_table_unref);
+
+	if (dir->monitor_cancellable != NULL)
+	{
+		g_cancellable_cancel (dir->monitor_cancellable);
+		g_clear_object (&dir->monitor_cancellable);
+	}
+}
+
 static void
 file_browser_node_free_children (GeditFileBrowserStore *model,
 				 FileBrowserNode       *node)
 {
+	FileBrowserNodeDir *dir;
+
 	if (node == NULL || !NODE_IS_DIR (node))
 		return;
 
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-		file_browser_node_free (model, (FileBrowserNode *)(item->data));
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	for (guint i = 0; i < dir->children->len; ++i)
+		file_browser_node_free (model, DIR_CHILD (dir, i));
 
-	g_slist_free (FILE_BROWSER_NODE_DIR (node)->children);
-	FILE_BROWSER_NODE_DIR (node)->children = NULL;
+	g_ptr_array_set_size (dir->children, 0);
+	dir_invalidate_rows (dir);
 
 	/* This node is no longer loaded */
 	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
@@ -1384,9 +1996,19 @@ static void
 file_browser_node_free (GeditFileBrowserStore *model,
 			FileBrowserNode       *node)
 {
+	GCancellable *cancellable;
+
 	if (node == NULL)
 		return;
 
+	cancellable = g_hash_table_lookup (model->priv->resolving, node);
+
+	if (cancellable != NULL)
+	{
+		g_cancellable_cancel (cancellable);
+		g_hash_table_remove (model->priv->resolving, node);
+	}
+
 	if (NODE_IS_DIR (node))
 	{
 		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
@@ -1400,18 +2022,26 @@ file_browser_node_free (GeditFileBrowserStore *model,
 		}
 
 		file_browser_node_free_children (model, node);
+		g_ptr_array_unref (dir->children);
+		g_free (dir->rows);
 
 		if (dir->monitor)
 		{
 			g_file_monitor_cancel (dir->monitor);
 			g_object_unref (dir->monitor);
 		}
+
+		model_clear_monitor_events (model, node);
 	}
 
-	if (node->file)
+	/* Only made when someone wants it */
+	if (node->basename != NULL &&
+	    g_signal_has_handler_pending (model, model_signals[UNLOAD], 0, FALSE))
 	{
-		g_signal_emit (model, model_signals[UNLOAD], 0, node->file);
-		g_object_unref (node->file);
+		GFile *file = node_get_file (node);
+
+		g_signal_emit (model, model_signals[UNLOAD], 0, file);
+		g_object_unref (file);
 	}
 
 	if (node->icon)
@@ -1420,12 +2050,19 @@ file_browser_node_free (GeditFileBrowserStore *model,
 	if (node->emblem)
 		g_object_unref (node->emblem);
 
-	g_free (node->icon_name);
-	g_free (node->name);
-	g_free (node->markup);
+	g_hash_table_remove (model->priv->markups, node);
 
 	if (NODE_IS_DIR (node))
-		g_slice_free (FileBrowserNodeDir, (FileBrowserNodeDir *)node);
+	{
+		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+
+		g_object_unref (dir->file);
+
+		if (dir->names != NULL)
+			g_string_chunk_free (dir->names);
+
+		g_slice_free (FileBrowserNodeDir, dir);
+	}
 	else
 		g_slice_free (FileBrowserNode, (FileBrowserNode *)node);
 }
@@ -1449,14 +2086,14 @@ model_remove_node_children (GeditFileBrowserStore *model,
 {
 	FileBrowserNodeDir *dir;
 	GtkTreePath *path_child;
-	GSList *list;
+	GPtrArray *children;
 
 	if (node == NULL || !NODE_IS_DIR (node))
 		return;
 
 	dir = FILE_BROWSER_NODE_DIR (node);
 
-	if (dir->children == NULL)
+	if (dir->children->len == 0)
 		return;
 
 	if (!model_node_visibility (model, node))
@@ -1475,12 +2112,12 @@ model_remove_node_children (GeditFileBrowserStore *model,
 
 	gtk_tree_path_down (path_child);
 
-	list = g_slist_copy (dir->children);
+	children = g_ptr_array_copy (dir->children, NULL, NULL);
 
-	for (GSList *item = list; item; item = item->next)
-		model_remove_node (model, (FileBrowserNode *)(item->data), path_child, free_nodes);
+	for (guint i = 0; i < children->len; ++i)
+		model_remove_node (model, g_ptr_array_index (children, i), path_child, free_nodes);
 
-	g_slist_free (list);
+	g_ptr_array_unref (children);
 	gtk_tree_path_free (path_child);
 }
 
@@ -1524,8 +2161,10 @@ model_remove_node (GeditFileBrowserStore *model,
 
 	/* Remove the node from the parents children list */
 	if (free_nodes && parent)
-		FILE_BROWSER_NODE_DIR (node->parent)->children =
-			g_slist_remove (FILE_BROWSER_NODE_DIR (node->parent)->children, node);
+	{
+		g_ptr_array_remove (FILE_BROWSER_NODE_DIR (parent)->children, node);
+		dir_invalidate_rows (FILE_BROWSER_NODE_DIR (parent));
+	}
 
 	/* If this is the virtual root, than set the parent as the virtual root */
 	if (node == model->priv->virtual_root)
@@ -1561,9 +2200,9 @@ model_clear (GeditFileBrowserStore *model,
 	{
 		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (model->priv->virtual_root);
 
-		if (dir->children != NULL)
+		if (dir->children->len > 0)
 		{
-			FileBrowserNode *dummy = (FileBrowserNode *)(dir->children->data);
+			FileBrowserNode *dummy = DIR_CHILD (dir, 0);
 
 			if (NODE_IS_DUMMY (dummy) && model_node_visibility (model, dummy))
 			{
@@ -1610,6 +2249,8 @@ file_browser_node_unload (GeditFileBrowserStore *model,
 		dir->monitor = NULL;
 	}
 
+	model_clear_monitor_events (model, node);
+
 	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
 }
 
@@ -1618,77 +2259,58 @@ model_recomposite_icon_real (GeditFileBrowserStore *tree_model,
 			     FileBrowserNode       *node,
 			     GFileInfo             *info)
 {
-	GdkPixbuf *icon;
+	GIcon *gicon = NULL;
 
 	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
 	g_return_if_fail (node != NULL);
 
-	if (node->file == NULL)
+	if (node->basename == NULL)
 		return;
 
 	if (info)
 	{
-		GIcon *gicon = g_file_info_get_icon (info);
+		gicon = g_file_info_get_icon (info);
 
 		if (gicon != NULL)
-			icon = gedit_file_browser_utils_pixbuf_from_icon (gicon, GTK_ICON_SIZE_MENU);
-		else
-			icon = NULL;
+			g_object_ref (gicon);
 	}
-	else
+	else if (node->content_type != NULL)
 	{
-		icon = gedit_file_browser_utils_pixbuf_from_file (node->file, GTK_ICON_SIZE_MENU, FALSE);
+		gicon = g_content_type_get_icon (node->content_type);
+	}
+	else if (!g_hash_table_contains (tree_model->priv->resolving, node))
+	{
+		/* The row is changed once the icon is known */
+		model_resolve_node_query (tree_model, node);
 	}
-
-	/* Fallback to the same icon as the file browser */
-	if (!icon)
-		icon = gedit_file_browser_utils_pixbuf_from_theme ("text-x-generic", GTK_ICON_SIZE_MENU);
 
 	if (node->icon)
 		g_object_unref (node->icon);
 
-	if (node->emblem)
-	{
-		gint icon_size;
-
-		gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, NULL, &icon_size);
+	/* Shared with the other rows showing the same icon */
+	node->icon = gedit_file_browser_utils_pixbuf_from_icon_cached (gicon,
+								       node->emblem,
+								       GTK_ICON_SIZE_MENU);
 
-		if (icon == NULL)
-		{
-			node->icon = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (node->emblem),
-						     gdk_pixbuf_get_has_alpha (node->emblem),
-						     gdk_pixbuf_get_bits_per_sample (node->emblem),
-						     icon_size,
-						     icon_size);
-		}
-		else
-		{
-			node->icon = gdk_pixbuf_copy (icon);
-			g_object_unref (icon);
-		}
-
-		gdk_pixbuf_composite (node->emblem, node->icon,
-				      icon_size - 10, icon_size - 10, 10,
-				      10, icon_size - 10, icon_size - 10,
-				      1, 1, GDK_INTERP_NEAREST, 255);
-	}
-	else
-	{
-		node->icon = icon;
-	}
+	if (gicon != NULL)
+		g_object_unref (gicon);
 }
 
 static void
 model_recomposite_icon (GeditFileBrowserStore *tree_model,
 			GtkTreeIter           *iter)
 {
+	FileBrowserNode *node;
+
 	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
 	g_return_if_fail (iter != NULL);
 	g_return_if_fail (iter->user_data != NULL);
 
-	model_recomposite_icon_real (tree_model,
-				     (FileBrowserNode *)(iter->user_data),
-				     NULL);
+	node = (FileBrowserNode *)(iter->user_data);
+
+	/* Otherwise the icon is composited when it is resolved */
+	if (node->resolved)
+		model_recomposite_icon_real (tree_model, node, NULL);
 }
 
 static FileBrowserNode *
@@ -1698,8 +2320,7 @@ model_create_dummy_node (GeditFileBrowserStore *model,
 	FileBrowserNode *dummy;
 
 	dummy = file_browser_node_new (NULL, parent);
-	dummy->name = g_strdup (_("(Empty)"));
-	dummy->markup = g_markup_escape_text (dummy->name, -1);
+	dummy->name = file_browser_node_intern (dummy, _("(Empty)"));
 
 	dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_DUMMY;
 	dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
@@ -1734,40 +2355,44 @@ model_check_dummy (GeditFileBrowserStore *model,
 		FileBrowserNode *dummy;
 		GtkTreeIter iter;
 		GtkTreePath *path;
-		guint flags;
+		guint rows;
 
-		if (dir->children == NULL)
+		if (dir->children->len == 0)
 		{
 			model_add_dummy_node (model, node);
 			return;
 		}
 
-		dummy = (FileBrowserNode *)(dir->children->data);
+		dummy = DIR_CHILD (dir, 0);
 
 		if (!NODE_IS_DUMMY (dummy))
 		{
 			dummy = model_create_dummy_node (model, node);
-			dir->children = g_slist_prepend (dir->children, dummy);
+			g_ptr_array_insert (dir->children, 0, dummy);
+			dir_invalidate_rows (dir);
 		}
 
 		if (!model_node_visibility (model, node))
 		{
 			dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			model_node_update_row (model, dummy);
 			return;
 		}
 
-		/* Temporarily set the node to invisible to check
-		   for real children */
-		flags = dummy->flags;
-		dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+		/* The rows of the real children, without the dummy when it is
+		   shown. The index is rebuilt with the dummy as it is. */
+		rows = dir_count_rows (dir, dir->children->len);
 
-		if (!filter_tree_model_iter_has_child_real (model, node))
-		{
-			dummy->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+		if (dummy->indexed)
+			--rows;
 
-			if (FILE_IS_HIDDEN (flags))
+		if (rows == 0)
+		{
+			if (NODE_IS_HIDDEN (dummy))
 			{
 				/* Was hidden, needs to be inserted */
+				dummy->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+
 				iter.user_data = dummy;
 				path = gedit_file_browser_store_get_path_real (model, dummy);
 
@@ -1775,12 +2400,9 @@ model_check_dummy (GeditFileBrowserStore *model,
 				gtk_tree_path_free (path);
 			}
 		}
-		else if (!FILE_IS_HIDDEN (flags))
+		else if (!NODE_IS_HIDDEN (dummy))
 		{
 			/* Was shown, needs to be removed */
-
-			/* To get the path we need to set it to visible temporarily */
-			dummy->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 			path = gedit_file_browser_store_get_path_real (model, dummy);
 			dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 
@@ -1796,11 +2418,29 @@ insert_node_sorted (GeditFileBrowserStore *model,
 		    FileBrowserNode       *parent)
 {
 	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	guint low = 0;
+	guint high = dir->children->len;
+
+	dir_invalidate_rows (dir);
 
 	if (model->priv->sort_func == NULL)
-		dir->children = g_slist_append (dir->children, child);
-	else
-		dir->children = g_slist_insert_sorted (dir->children, child, (GCompareFunc)(model->priv->sort_func));
+	{
+		g_ptr_array_add (dir->children, child);
+		return;
+	}
+
+	/* Binary search of the first child sorted after the new one */
+	while (low < high)
+	{
+		guint mid = low + (high - low) / 2;
+
+		if (model->priv->sort_func (DIR_CHILD (dir, mid), child) > 0)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+
+	g_ptr_array_insert (dir->children, low, child);
 }
 
 static void
@@ -1828,90 +2468,77 @@ model_add_node (GeditFileBrowserStore *model,
 	model_check_dummy (model, child);
 }
 
+/* Adds the @nodes, which are not sorted, to the children of @parent. The
+ * nodes are sorted, then merged with the children in a single pass, and the
+ * rows are inserted in order once the children are complete.
+ */
 static void
 model_add_nodes_batch (GeditFileBrowserStore *model,
-		       GSList                *children,
+		       GPtrArray             *nodes,
 		       FileBrowserNode       *parent)
 {
 	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
-	GSList *sorted_children = g_slist_sort (children, (GCompareFunc)model->priv->sort_func);
-	GSList *child = sorted_children;
-	GSList *prev = NULL;
-	GSList *l = dir->children;
+	GPtrArray *children;
+	guint i = 0;
+	guint j = 0;
 
+	/* Makes sure the dummy is the first child */
 	model_check_dummy (model, parent);
+	model_sort_children (model, nodes);
 
-	while (child)
-	{
-		FileBrowserNode *node = child->data;
-		GtkTreeIter iter;
-		GtkTreePath *path;
+	children = g_ptr_array_sized_new (dir->children->len + nodes->len);
 
-		/* Reached the end of the first list, just append the second */
-		if (l == NULL)
-		{
-			dir->children = g_slist_concat (dir->children, child);
+	while (i < dir->children->len && j < nodes->len)
+	{
+		if (model->priv->sort_func != NULL &&
+		    model->priv->sort_func (DIR_CHILD (dir, i), g_ptr_array_index (nodes, j)) > 0)
+			g_ptr_array_add (children, g_ptr_array_index (nodes, j++));
+		else
+			g_ptr_array_add (children, DIR_CHILD (dir, i++));
+	}
 
-			for (l = child; l; l = l->next)
-			{
-				if (model_node_visibility (model, parent) &&
-				    model_node_visibility (model, l->data))
-				{
-					iter.user_data = l->data;
-					path = gedit_file_browser_store_get_path_real (model, l->data);
+	while (i < dir->children->len)
+		g_ptr_array_add (children, DIR_CHILD (dir, i++));
 
-					/* Emit row inserted */
-					row_inserted (model, &path, &iter);
-					gtk_tree_path_free (path);
-				}
+	while (j < nodes->len)
+		g_ptr_array_add (children, g_ptr_array_index (nodes, j++));
 
-				model_check_dummy (model, l->data);
-			}
+	g_ptr_array_unref (dir->children);
+	dir->children = children;
+	dir_invalidate_rows (dir);
 
-			break;
-		}
+	for (j = 0; j < nodes->len; ++j)
+	{
+		FileBrowserNode *node = g_ptr_array_index (nodes, j);
 
-		if (model->priv->sort_func (l->data, node) > 0)
+		if (model_node_visibility (model, parent) &&
+		    model_node_visibility (model, node))
 		{
-			GSList *next_child;
+			GtkTreeIter iter;
+			GtkTreePath *path;
 
-			if (prev == NULL)
-			{
-				/* Prepend to the list */
-				dir->children = g_slist_prepend (dir->children, child);
-			}
-			else
-			{
-				prev->next = child;
-			}
+			iter.user_data = node;
+			path = gedit_file_browser_store_get_path_real (model, node);
 
-			next_child = child->next;
-			prev = child;
-			child->next = l;
-			child = next_child;
+			/* Emit row inserted */
+			row_inserted (model, &path, &iter);
+			gtk_tree_path_free (path);
+		}
 
-			if (model_node_visibility (model, parent) &&
-			    model_node_visibility (model, node))
-			{
-				iter.user_data = node;
-				path = gedit_file_browser_store_get_path_real (model, node);
+		model_check_dummy (model, node);
+	}
 
-				/* Emit row inserted */
-				row_inserted (model, &path, &iter);
-				gtk_tree_path_free (path);
-			}
+	/* The dummy of the parent is hidden by the new rows */
+	model_check_dummy (model, parent);
+}
 
-			model_check_dummy (model, node);
+static gchar const *
+file_info_get_content_type (GFileInfo *info)
+{
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
+		return g_file_info_get_content_type (info);
 
-			/* Try again at the same l position with the next child */
-		}
-		else
-		{
-			/* Move to the next item in the list */
-			prev = l;
-			l = l->next;
-		}
-	}
+	return g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
 }
 
 static gchar const *
@@ -1922,7 +2549,7 @@ backup_content_type (GFileInfo *info)
 	if (!g_file_info_get_is_backup (info))
 		return NULL;
 
-	content = g_file_info_get_content_type (info);
+	content = file_info_get_content_type (info);
 
 	if (!content || g_content_type_equals (content, "application/x-trash"))
 		return "text/plain";
@@ -1958,13 +2585,150 @@ content_type_is_text (gchar const *content_type)
 #endif
 }
 
+static void
+file_browser_node_set_content_type (GeditFileBrowserStore *model,
+				    FileBrowserNode       *node,
+				    GFileInfo             *info)
+{
+	gchar const *content;
+
+	node->content_type = g_intern_string (file_info_get_content_type (info));
+	node->type_unknown = !NODE_IS_DIR (node) &&
+			     !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE) &&
+			     (node->content_type == NULL || g_content_type_is_unknown (node->content_type));
+
+	if (!NODE_IS_DIR (node))
+	{
+		if (!(content = backup_content_type (info)))
+			content = node->content_type;
+
+		if (content_type_is_text (content))
+			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT;
+		else
+			node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT;
+	}
+
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_ICON))
+	{
+		model_recomposite_icon_real (model, node, info);
+		node->resolved = TRUE;
+	}
+}
+
+static void
+model_resolve_node_cb (GFile           *file,
+		       GAsyncResult    *result,
+		       FileBrowserNode *node)
+{
+	GeditFileBrowserStore *model;
+	GFileInfo *info;
+	GError *error = NULL;
+	gboolean was_unknown;
+	gboolean was_text;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	info = g_file_query_info_finish (file, result, &error);
+
+	/* The node may have been freed */
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+	{
+		g_error_free (error);
+		return;
+	}
+
+	model = FILE_BROWSER_NODE_DIR (node->parent)->model;
+	g_hash_table_remove (model->priv->resolving, node);
+
+	was_unknown = node->type_unknown;
+	was_text = NODE_IS_TEXT (node);
+
+	if (info != NULL)
+	{
+		file_browser_node_set_content_type (model, node, info);
+		g_object_unref (info);
+	}
+	else
+	{
+		g_error_free (error);
+	}
+
+	/* The guess is kept when the query failed */
+	node->type_unknown = FALSE;
+
+	if (node->indexed)
+	{
+		iter.user_data = node;
+		path = gedit_file_browser_store_get_path_real (model, node);
+		row_changed (model, &path, &iter);
+		gtk_tree_path_free (path);
+	}
+
+	/* Whether the node is filtered may depend on it */
+	if (was_unknown || was_text != NODE_IS_TEXT (node))
+	{
+		model_refilter_node (model, node, NULL);
+		model_check_dummy (model, node->parent);
+	}
+}
+
+/* Queries the content type and icon of @node in the background */
+static void
+model_resolve_node_query (GeditFileBrowserStore *model,
+			  FileBrowserNode       *node)
+{
+	GCancellable *cancellable;
+	GFile *file;
+
+	if (node->parent == NULL)
+		return;
+
+	cancellable = g_cancellable_new ();
+	g_hash_table_insert (model->priv->resolving, node, cancellable);
+
+	file = node_get_file (node);
+	g_file_query_info_async (file,
+				 RESOLVE_ATTRIBUTE_TYPES,
+				 G_FILE_QUERY_INFO_NONE,
+				 G_PRIORITY_LOW,
+				 cancellable,
+				 (GAsyncReadyCallback)model_resolve_node_cb,
+				 node);
+	g_object_unref (file);
+}
+
+/* Makes the icon of @node the first time it is needed, from the content
+ * type guessed when the directory was loaded. When the name was not enough
+ * to guess the content type, and for directories which may have a special
+ * icon, the content type and icon are then queried in the background. */
+static void
+model_resolve_node (GeditFileBrowserStore *model,
+		    FileBrowserNode       *node)
+{
+	node->resolved = TRUE;
+
+	if (node->basename == NULL)
+		return;
+
+	if (node->content_type == NULL)
+	{
+		/* Made once the icon is queried */
+		model_resolve_node_query (model, node);
+		return;
+	}
+
+	model_recomposite_icon_real (model, node, NULL);
+
+	if (NODE_IS_DIR (node) || g_content_type_is_unknown (node->content_type))
+		model_resolve_node_query (model, node);
+}
+
 static void
 file_browser_node_set_from_info (GeditFileBrowserStore *model,
 				 FileBrowserNode       *node,
 				 GFileInfo             *info,
 				 gboolean               isadded)
 {
-	gchar const *content;
 	gboolean free_info = FALSE;
 	GtkTreePath *path;
 	gchar *uri;
@@ -1972,7 +2736,9 @@ file_browser_node_set_from_info (GeditFileBrowserStore *model,
 
 	if (info == NULL)
 	{
-		info = g_file_query_info (node->file,
+		GFile *file = node_get_file (node);
+
+		info = g_file_query_info (file,
 					  STANDARD_ATTRIBUTE_TYPES,
 					  G_FILE_QUERY_INFO_NONE,
 					  NULL,
@@ -1982,15 +2748,18 @@ file_browser_node_set_from_info (GeditFileBrowserStore *model,
 		{
 			if (!(error->domain == G_IO_ERROR && error->code == G_IO_ERROR_NOT_FOUND))
 			{
-				uri = g_file_get_uri (node->file);
+				uri = g_file_get_uri (file);
 				g_warning ("Could not get info for %s: %s", uri, error->message);
 				g_free (uri);
 			}
 
+			g_object_unref (file);
 			g_error_free (error);
 			return;
 		}
 
+		g_object_unref (file);
+
 		free_info = TRUE;
 	}
 
@@ -1998,19 +2767,9 @@ file_browser_node_set_from_info (GeditFileBrowserStore *model,
 		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 
 	if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
-	{
 		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
-	}
-	else
-	{
-		if (!(content = backup_content_type (info)))
-			content = g_file_info_get_content_type (info);
-
-		if (content_type_is_text (content))
-			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT;
-	}
 
-	model_recomposite_icon_real (model, node, info);
+	file_browser_node_set_content_type (model, node, info);
 
 	if (free_info)
 		g_object_unref (info);
@@ -2029,19 +2788,28 @@ file_browser_node_set_from_info (GeditFileBrowserStore *model,
 	}
 }
 
+/* Returns the node of @file among @children, the children of the parent
+ * of @file */
 static FileBrowserNode *
-node_list_contains_file (GSList *children,
-			 GFile  *file)
+node_list_contains_file (GPtrArray *children,
+			 GFile     *file)
 {
-	for (GSList *item = children; item; item = item->next)
+	gchar *basename = g_file_get_basename (file);
+	FileBrowserNode *result = NULL;
+
+	for (guint i = 0; i < children->len; ++i)
 	{
-		FileBrowserNode *node = (FileBrowserNode *)(item->data);
+		FileBrowserNode *node = g_ptr_array_index (children, i);
 
-		if (node->file != NULL && g_file_equal (node->file, file))
-			return node;
+		if (node->basename != NULL && strcmp (node->basename, basename) == 0)
+		{
+			result = node;
+			break;
+		}
 	}
 
-	return NULL;
+	g_free (basename);
+	return result;
 }
 
 static FileBrowserNode *
@@ -2093,16 +2861,16 @@ model_add_node_from_file (GeditFileBrowserStore *model,
 	return node;
 }
 
-/* We pass in a copy of the list of parent->children so that we do
+/* We pass in the names of the original children of parent so that we do
  * not have to check if a file already exists among the ones we just
  * added */
 static void
 model_add_nodes_from_files (GeditFileBrowserStore *model,
 			    FileBrowserNode       *parent,
-			    GSList                *original_children,
+			    GHashTable            *original_children,
 			    GList                 *files)
 {
-	GSList *nodes = NULL;
+	GPtrArray *nodes = g_ptr_array_new ();
 
 	for (GList *item = files; item; item = item->next)
 	{
@@ -2132,9 +2900,11 @@ model_add_nodes_from_files (GeditFileBrowserStore *model,
 			continue;
 		}
 
-		file = g_file_get_child (parent->file, name);
-		if (!(node = node_list_contains_file (original_children, file)))
+		if (original_children == NULL ||
+		    !g_hash_table_contains (original_children, name))
 		{
+			file = g_file_get_child (FILE_BROWSER_NODE_DIR (parent)->file, name);
+
 			if (type == G_FILE_TYPE_DIRECTORY)
 				node = file_browser_node_dir_new (model, file, parent);
 			else
@@ -2142,15 +2912,17 @@ model_add_nodes_from_files (GeditFileBrowserStore *model,
 
 			file_browser_node_set_from_info (model, node, info, FALSE);
 
-			nodes = g_slist_prepend (nodes, node);
+			g_ptr_array_add (nodes, node);
+			g_object_unref (file);
 		}
 
-		g_object_unref (file);
 		g_object_unref (info);
 	}
 
-	if (nodes)
+	if (nodes->len > 0)
 		model_add_nodes_batch (model, nodes, parent);
+
+	g_ptr_array_unref (nodes);
 }
 
 static FileBrowserNode *
@@ -2165,11 +2937,7 @@ model_add_node_from_dir (GeditFileBrowserStore *model,
 	{
 		node = file_browser_node_dir_new (model, file, parent);
 		file_browser_node_set_from_info (model, node, NULL, FALSE);
-
-		if (node->name == NULL)
-			file_browser_node_set_name (node);
-
-		node->icon_name = g_strdup ("folder-symbolic");
+		node->folder_icon_name = TRUE;
 
 		model_add_node (model, node, parent);
 	}
@@ -2177,202 +2945,1276 @@ model_add_node_from_dir (GeditFileBrowserStore *model,
 	return node;
 }
 
-static void
-on_directory_monitor_event (GFileMonitor      *monitor,
-			    GFile             *file,
-			    GFile             *other_file,
-			    GFileMonitorEvent  event_type,
-			    FileBrowserNode   *parent)
+static GHashTable *
+node_get_children_names (FileBrowserNode *node)
 {
-	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
-	FileBrowserNode *node;
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+	GHashTable *names = NULL;
 
-	switch (event_type)
+	for (guint i = 0; i < dir->children->len; ++i)
 	{
-		case G_FILE_MONITOR_EVENT_DELETED:
-			node = node_list_contains_file (dir->children, file);
+		FileBrowserNode *child = DIR_CHILD (dir, i);
 
-			if (node != NULL)
-				model_remove_node (dir->model, node, NULL, TRUE);
-			break;
-		case G_FILE_MONITOR_EVENT_CREATED:
-			if (g_file_query_exists (file, NULL))
-				model_add_node_from_file (dir->model, parent, file, NULL);
+		if (child->basename == NULL)
+			continue;
 
-			break;
-		default:
-			break;
+		/* The names are kept with the directory */
+		if (names == NULL)
+			names = g_hash_table_new (g_str_hash, g_str_equal);
+
+		g_hash_table_add (names, (gpointer)child->basename);
 	}
+
+	return names;
 }
 
 static void
-async_node_free (AsyncNode *async)
+monitor_query_free (MonitorQuery *query)
 {
-	g_object_unref (async->cancellable);
-	g_slist_free (async->original_children);
-	g_slice_free (AsyncNode, async);
+	g_object_unref (query->cancellable);
+	g_list_free_full (query->infos, g_object_unref);
+	g_slice_free (MonitorQuery, query);
 }
 
 static void
-model_iterate_next_files_cb (GFileEnumerator *enumerator,
-			     GAsyncResult    *result,
-			     AsyncNode       *async)
+monitor_query_info_cb (GFile        *file,
+		       GAsyncResult *result,
+		       MonitorQuery *query)
 {
-	GError *error = NULL;
-	GList *files = g_file_enumerator_next_files_finish (enumerator, result, &error);
-	FileBrowserNodeDir *dir = async->dir;
-	FileBrowserNode *parent = (FileBrowserNode *)dir;
+	GFileInfo *info = g_file_query_info_finish (file, result, NULL);
+	FileBrowserNode *parent = (FileBrowserNode *)query->dir;
+	GHashTable *pending;
+	GHashTable *names;
+	GList *infos = NULL;
 
-	if (files == NULL)
-	{
-		g_file_enumerator_close (enumerator, NULL, NULL);
-		g_object_unref (enumerator);
-		async_node_free (async);
+	/* The file may have been deleted again in the meantime */
+	if (info != NULL)
+		query->infos = g_list_prepend (query->infos, info);
 
-		if (!error)
-		{
-			/* We're done loading */
-			g_object_unref (dir->cancellable);
-			dir->cancellable = NULL;
+	if (--query->n_pending > 0)
+		return;
 
-/*
- * FIXME: This is temporarly, it is a bug in gio:
- * http://bugzilla.gnome.org/show_bug.cgi?id=565924
- */
-#ifndef G_OS_WIN32
-			if (g_file_is_native (parent->file) && dir->monitor == NULL)
-			{
-				dir->monitor = g_file_monitor_directory (parent->file,
-									 G_FILE_MONITOR_NONE,
-									 NULL,
-									 NULL);
-				if (dir->monitor != NULL)
-				{
-					g_signal_connect (dir->monitor,
-							  "changed",
-							  G_CALLBACK (on_directory_monitor_event),
-							  parent);
-				}
-			}
-#endif
+	/* Otherwise the directory may have been freed */
+	if (g_cancellable_is_cancelled (query->cancellable))
+	{
+		monitor_query_free (query);
+		return;
+	}
 
-			model_check_dummy (dir->model, parent);
-			model_end_loading (dir->model, parent);
-		}
-		else
-		{
-			/* Simply return if we were cancelled */
-			if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_CANCELLED)
-				return;
+	/* Not added if the file was deleted, or created again, since the
+	 * query was made */
+	pending = query->dir->monitor_pending;
 
-			/* Otherwise handle the error appropriately */
-			g_signal_emit (dir->model,
-				       model_signals[ERROR],
-				       0,
-				       GEDIT_FILE_BROWSER_ERROR_LOAD_DIRECTORY,
-				       error->message);
+	for (GList *item = query->infos; item != NULL; item = item->next)
+	{
+		gchar const *name = g_file_info_get_name (item->data);
 
-			file_browser_node_unload (dir->model, (FileBrowserNode *)parent, TRUE);
-			g_error_free (error);
+		if (pending != NULL && g_hash_table_lookup (pending, name) == query)
+		{
+			g_hash_table_remove (pending, name);
+			infos = g_list_prepend (infos, g_object_ref (item->data));
 		}
 	}
-	else if (g_cancellable_is_cancelled (async->cancellable))
-	{
-		/* Check cancel state manually */
-		g_file_enumerator_close (enumerator, NULL, NULL);
-		g_object_unref (enumerator);
-		async_node_free (async);
-	}
-	else
+
+	if (infos != NULL)
 	{
-		model_add_nodes_from_files (dir->model, parent, async->original_children, files);
+		names = node_get_children_names (parent);
 
-		g_list_free (files);
-		next_files_async (enumerator, async);
+		/* The infos are consumed */
+		model_add_nodes_from_files (query->dir->model, parent, names, infos);
+		g_list_free (infos);
+
+		if (names != NULL)
+			g_hash_table_unref (names);
 	}
-}
 
-static void
-next_files_async (GFileEnumerator *enumerator,
-		  AsyncNode       *async)
-{
-	g_file_enumerator_next_files_async (enumerator,
-					    DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-					    G_PRIORITY_DEFAULT,
-					    async->cancellable,
-					    (GAsyncReadyCallback)model_iterate_next_files_cb,
-					    async);
+	monitor_query_free (query);
 }
 
 static void
-model_iterate_children_cb (GFile        *file,
-			   GAsyncResult *result,
-			   AsyncNode    *async)
+model_flush_directory_events (GeditFileBrowserStore *model,
+			      FileBrowserNode       *parent)
 {
-	GError *error = NULL;
-	GFileEnumerator *enumerator;
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	GHashTable *events = dir->monitor_events;
+	GHashTable *children;
+	GHashTable *deleted = NULL;
+	MonitorQuery *query = NULL;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
 
-	if (g_cancellable_is_cancelled (async->cancellable))
-	{
-		async_node_free (async);
-		return;
-	}
+	dir->monitor_events = NULL;
 
-	if (!(enumerator = g_file_enumerate_children_finish (file, result, &error)))
-	{
-		/* Simply return if we were cancelled or if the dir is not there */
-		FileBrowserNodeDir *dir = async->dir;
+	if (events == NULL)
+		return;
 
-		/* Otherwise handle the error appropriately */
-		g_signal_emit (dir->model,
-			       model_signals[ERROR],
-			       0,
-			       GEDIT_FILE_BROWSER_ERROR_LOAD_DIRECTORY,
-			       error->message);
+	children = g_hash_table_new (g_str_hash, g_str_equal);
 
-		file_browser_node_unload (dir->model, (FileBrowserNode *)dir, TRUE);
-		g_error_free (error);
-		async_node_free (async);
-	}
-	else
+	for (guint i = 0; i < dir->children->len; ++i)
 	{
-		next_files_async (enumerator, async);
+		FileBrowserNode *child = DIR_CHILD (dir, i);
+
+		if (child->basename != NULL)
+			g_hash_table_insert (children, (gpointer)child->basename, child);
 	}
-}
 
-static void
-model_load_directory (GeditFileBrowserStore *model,
-		      FileBrowserNode       *node)
-{
-	FileBrowserNodeDir *dir;
-	AsyncNode *async;
+	g_hash_table_iter_init (&iter, events);
 
-	g_return_if_fail (NODE_IS_DIR (node));
+	while (g_hash_table_iter_next (&iter, &key, &value))
+	{
+		FileBrowserNode *child = g_hash_table_lookup (children, key);
+		GFile *file;
 
-	dir = FILE_BROWSER_NODE_DIR (node);
+		if (GPOINTER_TO_INT (value) == G_FILE_MONITOR_EVENT_DELETED)
+		{
+			if (dir->monitor_pending != NULL)
+				g_hash_table_remove (dir->monitor_pending, key);
 
-	/* Cancel a previous load */
-	if (dir->cancellable != NULL)
-		file_browser_node_unload (dir->model, node, TRUE);
+			/* Removed together, last as it may free the directory */
+			if (child != NULL)
+			{
+				if (deleted == NULL)
+					deleted = g_hash_table_new (g_str_hash, g_str_equal);
 
-	node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
-	model_begin_loading (model, node);
+				g_hash_table_add (deleted, key);
+			}
+		}
+		else if (child == NULL)
+		{
+			if (query == NULL)
+			{
+				if (dir->monitor_cancellable == NULL)
+					dir->monitor_cancellable = g_cancellable_new ();
 
-	dir->cancellable = g_cancellable_new ();
+				query = g_slice_new0 (MonitorQuery);
+				query->dir = dir;
+				query->cancellable = g_object_ref (dir->monitor_cancellable);
+			}
 
-	async = g_slice_new (AsyncNode);
-	async->dir = dir;
+			if (dir->monitor_pending == NULL)
+			{
+				dir->monitor_pending = g_hash_table_new_full (g_str_hash,
+									      g_str_equal,
+									      g_free,
+									      NULL);
+			}
+
+			g_hash_table_insert (dir->monitor_pending, g_strdup (key), query);
+
+			file = g_file_get_child (dir->file, key);
+			query->n_pending++;
+
+			g_file_query_info_async (file,
+						 LOAD_ATTRIBUTE_TYPES,
+						 G_FILE_QUERY_INFO_NONE,
+						 G_PRIORITY_DEFAULT,
+						 query->cancellable,
+						 (GAsyncReadyCallback)monitor_query_info_cb,
+						 query);
+
+			g_object_unref (file);
+		}
+	}
+
+	g_hash_table_unref (children);
+
+	if (deleted != NULL)
+	{
+		model_remove_children_named (model, parent, deleted);
+		g_hash_table_unref (deleted);
+	}
+
+	g_hash_table_unref (events);
+}
+
+static gboolean
+model_flush_monitor_events (GeditFileBrowserStore *model)
+{
+	GHashTableIter iter;
+	gpointer node;
+
+	model->priv->monitor_flush_id = 0;
+
+	/* One directory at a time, as flushing one may free another */
+	while (g_hash_table_size (model->priv->monitor_dirs) > 0)
+	{
+		g_hash_table_iter_init (&iter, model->priv->monitor_dirs);
+		g_hash_table_iter_next (&iter, &node, NULL);
+		g_hash_table_iter_remove (&iter);
+
+		model_flush_directory_events (model, node);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+/* The events are queued, only keeping the last one of each file, and
+ * flushed together after a short delay */
+static void
+on_directory_monitor_event (GFileMonitor      *monitor,
+			    GFile             *file,
+			    GFile             *other_file,
+			    GFileMonitorEvent  event_type,
+			    FileBrowserNode   *parent)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	GeditFileBrowserStore *model = dir->model;
+
+	if (event_type != G_FILE_MONITOR_EVENT_DELETED &&
+	    event_type != G_FILE_MONITOR_EVENT_CREATED)
+		return;
+
+	if (dir->monitor_events == NULL)
+		dir->monitor_events = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	g_hash_table_insert (dir->monitor_events,
+			     g_file_get_basename (file),
+			     GINT_TO_POINTER (event_type));
+	g_hash_table_add (model->priv->monitor_dirs, parent);
+
+	if (model->priv->monitor_flush_id == 0)
+	{
+		model->priv->monitor_flush_id = g_timeout_add (MONITOR_EVENTS_FLUSH_INTERVAL,
+							       (GSourceFunc)model_flush_monitor_events,
+							       model);
+	}
+}
+
+static void
+async_node_free (AsyncNode *async)
+{
+	g_object_unref (async->cancellable);
+
+	if (async->original_children != NULL)
+		g_hash_table_unref (async->original_children);
+
+	if (async->seen != NULL)
+		g_hash_table_unref (async->seen);
+
+	g_list_free_full (async->infos, g_object_unref);
+	g_slice_free (AsyncNode, async);
+}
+
+static void
+model_remove_gone_children (GeditFileBrowserStore *model,
+			    FileBrowserNode       *node,
+			    GHashTable            *seen)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+	GHashTable *gone = NULL;
+
+	for (guint i = 0; i < dir->children->len; ++i)
+	{
+		FileBrowserNode *child = DIR_CHILD (dir, i);
+
+		if (child->basename != NULL && !g_hash_table_contains (seen, child->basename))
+		{
+			if (gone == NULL)
+				gone = g_hash_table_new (g_str_hash, g_str_equal);
+
+			g_hash_table_add (gone, (gpointer)child->basename);
+		}
+	}
+
+	/* Removed together */
+	if (gone != NULL)
+	{
+		model_remove_children_named (model, node, gone);
+		g_hash_table_unref (gone);
+	}
+}
+
+static void
+model_directory_loaded (AsyncNode *async)
+{
+	FileBrowserNodeDir *dir = async->dir;
+	FileBrowserNode *parent = (FileBrowserNode *)dir;
+
+	g_object_unref (dir->cancellable);
+	dir->cancellable = NULL;
+
+/*
+ * FIXME: This is temporarly, it is a bug in gio:
+ * http://bugzilla.gnome.org/show_bug.cgi?id=565924
+ */
+#ifndef G_OS_WIN32
+	if (g_file_is_native (dir->file) && dir->monitor == NULL)
+	{
+		dir->monitor = g_file_monitor_directory (dir->file,
+							 G_FILE_MONITOR_NONE,
+							 NULL,
+							 NULL);
+		if (dir->monitor != NULL)
+		{
+			g_signal_connect (dir->monitor,
+					  "changed",
+					  G_CALLBACK (on_directory_monitor_event),
+					  parent);
+		}
+	}
+#endif
+
+	/* The children added before the directory was enumerated, from the
+	   cache for example, may be gone */
+	if (async->seen != NULL)
+		model_remove_gone_children (dir->model, parent, async->seen);
+
+	if (async->has_mtime)
+	{
+		async->infos = g_list_reverse (async->infos);
+		gedit_file_browser_cache_store (dir->file, async->mtime, async->infos);
+	}
+
+	model_check_dummy (dir->model, parent);
+	model_end_loading (dir->model, parent);
+}
+
+static void
+model_iterate_next_files_cb (GFileEnumerator *enumerator,
+			     GAsyncResult    *result,
+			     AsyncNode       *async)
+{
+	GError *error = NULL;
+	GList *files = g_file_enumerator_next_files_finish (enumerator, result, &error);
+	FileBrowserNodeDir *dir = async->dir;
+	FileBrowserNode *parent = (FileBrowserNode *)dir;
+
+	if (files == NULL)
+	{
+		g_file_enumerator_close (enumerator, NULL, NULL);
+		g_object_unref (enumerator);
+
+		if (!error)
+		{
+			/* We're done loading */
+			model_directory_loaded (async);
+			async_node_free (async);
+		}
+		else
+		{
+			async_node_free (async);
+
+			/* Simply return if we were cancelled */
+			if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_CANCELLED)
+				return;
+
+			/* Otherwise handle the error appropriately */
+			g_signal_emit (dir->model,
+				       model_signals[ERROR],
+				       0,
+				       GEDIT_FILE_BROWSER_ERROR_LOAD_DIRECTORY,
+				       error->message);
+
+			file_browser_node_unload (dir->model, (FileBrowserNode *)parent, TRUE);
+			g_error_free (error);
+		}
+	}
+	else if (g_cancellable_is_cancelled (async->cancellable))
+	{
+		/* Check cancel state manually */
+		g_file_enumerator_close (enumerator, NULL, NULL);
+		g_object_unref (enumerator);
+		async_node_free (async);
+	}
+	else
+	{
+		gint64 start = g_get_monotonic_time ();
+		gint64 elapsed;
+
+		for (GList *item = files; item; item = item->next)
+		{
+			GFileInfo *info = G_FILE_INFO (item->data);
+
+			if (async->has_mtime)
+				async->infos = g_list_prepend (async->infos, g_object_ref (info));
+
+			if (async->seen != NULL)
+				g_hash_table_add (async->seen, g_strdup (g_file_info_get_name (info)));
+		}
+
+		model_add_nodes_from_files (dir->model, parent, async->original_children, files);
+		g_list_free (files);
+
+		elapsed = g_get_monotonic_time () - start;
+
+		if (elapsed < DIRECTORY_LOAD_TIME_PER_CALLBACK / 2)
+			async->n_items = MIN (async->n_items * 2, DIRECTORY_LOAD_ITEMS_PER_CALLBACK_MAX);
+		else if (elapsed > DIRECTORY_LOAD_TIME_PER_CALLBACK)
+			async->n_items = MAX (async->n_items / 2, DIRECTORY_LOAD_ITEMS_PER_CALLBACK_MIN);
+
+		next_files_async (enumerator, async);
+	}
+}
+
+static void
+next_files_async (GFileEnumerator *enumerator,
+		  AsyncNode       *async)
+{
+	g_file_enumerator_next_files_async (enumerator,
+					    async->n_items,
+					    G_PRIORITY_DEFAULT,
+					    async->cancellable,
+					    (GAsyncReadyCallback)model_iterate_next_files_cb,
+					    async);
+}
+
+static void
+model_iterate_children_cb (GFile        *file,
+			   GAsyncResult *result,
+			   AsyncNode    *async)
+{
+	GError *error = NULL;
+	GFileEnumerator *enumerator;
+
+	if (g_cancellable_is_cancelled (async->cancellable))
+	{
+		async_node_free (async);
+		return;
+	}
+
+	if (!(enumerator = g_file_enumerate_children_finish (file, result, &error)))
+	{
+		/* Simply return if we were cancelled or if the dir is not there */
+		FileBrowserNodeDir *dir = async->dir;
+
+		/* Otherwise handle the error appropriately */
+		g_signal_emit (dir->model,
+			       model_signals[ERROR],
+			       0,
+			       GEDIT_FILE_BROWSER_ERROR_LOAD_DIRECTORY,
+			       error->message);
+
+		file_browser_node_unload (dir->model, (FileBrowserNode *)dir, TRUE);
+		g_error_free (error);
+		async_node_free (async);
+	}
+	else
+	{
+		next_files_async (enumerator, async);
+	}
+}
+
+static void
+model_query_directory_cb (GFile        *file,
+			  GAsyncResult *result,
+			  AsyncNode    *async)
+{
+	GFileInfo *info = g_file_query_info_finish (file, result, NULL);
+
+	if (g_cancellable_is_cancelled (async->cancellable))
+	{
+		g_clear_object (&info);
+		async_node_free (async);
+		return;
+	}
+
+	if (info != NULL && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+	{
+		async->has_mtime = TRUE;
+		async->mtime = gedit_file_browser_cache_get_mtime (info);
+	}
+
+	g_clear_object (&info);
+
+	/* The cached listing is up to date */
+	if (async->cached && async->has_mtime && async->mtime == async->cached_mtime)
+	{
+		async->has_mtime = FALSE;
+		model_directory_loaded (async);
+		async_node_free (async);
+		return;
+	}
+
+	if (async->original_children != NULL)
+		async->seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	g_file_enumerate_children_async (file,
+					 LOAD_ATTRIBUTE_TYPES,
+					 G_FILE_QUERY_INFO_NONE,
+					 G_PRIORITY_DEFAULT,
+					 async->cancellable,
+					 (GAsyncReadyCallback)model_iterate_children_cb,
+					 async);
+}
+
+/* Starts the load of @async, the directory is only enumerated if it changed
+ * since it was cached */
+static void
+model_query_directory (AsyncNode *async)
+{
+	g_file_query_info_async (async->dir->file,
+				 G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				 G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+				 G_FILE_QUERY_INFO_NONE,
+				 G_PRIORITY_DEFAULT,
+				 async->cancellable,
+				 (GAsyncReadyCallback)model_query_directory_cb,
+				 async);
+}
+
+static void
+prefetch_dir_free (PrefetchDir *pd)
+{
+	g_object_unref (pd->location);
+	g_list_free_full (pd->infos, g_object_unref);
+	g_slice_free (PrefetchDir, pd);
+}
+
+static void
+prefetch_free (Prefetch *prefetch)
+{
+	g_hash_table_destroy (prefetch->dirs);
+	g_queue_clear (&prefetch->pending);
+	g_object_unref (prefetch->cancellable);
+	g_slice_free (Prefetch, prefetch);
+}
+
+/* Completes the load of @async with the listing of @pd, or enumerates the
+ * directory if the listing could not be made */
+static void
+model_load_prefetched (AsyncNode   *async,
+		       PrefetchDir *pd)
+{
+	FileBrowserNodeDir *dir = async->dir;
+	GList *infos;
+
+	if (g_cancellable_is_cancelled (async->cancellable))
+	{
+		async_node_free (async);
+		return;
+	}
+
+	if (pd->failed)
+	{
+		model_query_directory (async);
+		return;
+	}
+
+	infos = pd->infos;
+	pd->infos = NULL;
+
+	/* The children the node had which are not listed are gone */
+	if (async->original_children != NULL)
+	{
+		async->seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+		for (GList *item = infos; item; item = item->next)
+			g_hash_table_add (async->seen, g_strdup (g_file_info_get_name (item->data)));
+	}
+
+	model_add_nodes_from_files (dir->model, (FileBrowserNode *)dir, async->original_children, infos);
+	g_list_free (infos);
+
+	model_directory_loaded (async);
+	async_node_free (async);
+}
+
+static void prefetch_next (Prefetch *prefetch);
+
+static void
+prefetch_dir_done (PrefetchDir *pd,
+		   gboolean     ok)
+{
+	Prefetch *prefetch = pd->prefetch;
+
+	pd->done = TRUE;
+	pd->failed = !ok;
+	prefetch->running--;
+
+	if (pd->async != NULL)
+	{
+		AsyncNode *async = pd->async;
+
+		pd->async = NULL;
+		model_load_prefetched (async, pd);
+	}
+
+	prefetch_next (prefetch);
+}
+
+static void
+prefetch_next_files_cb (GFileEnumerator *enumerator,
+			GAsyncResult    *result,
+			PrefetchDir     *pd)
+{
+	GError *error = NULL;
+	GList *files;
+
+	files = g_file_enumerator_next_files_finish (enumerator, result, &error);
+
+	if (files != NULL && pd->prefetch->model != NULL)
+	{
+		pd->infos = g_list_concat (files, pd->infos);
+
+		g_file_enumerator_next_files_async (enumerator,
+						    DIRECTORY_LOAD_ITEMS_PER_CALLBACK_MAX,
+						    G_PRIORITY_DEFAULT,
+						    pd->prefetch->cancellable,
+						    (GAsyncReadyCallback)prefetch_next_files_cb,
+						    pd);
+		return;
+	}
+
+	g_list_free_full (files, g_object_unref);
+
+	g_file_enumerator_close_async (enumerator, G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+	g_object_unref (enumerator);
+
+	prefetch_dir_done (pd, error == NULL && pd->prefetch->model != NULL);
+	g_clear_error (&error);
+}
+
+static void
+prefetch_children_cb (GFile        *file,
+		      GAsyncResult *result,
+		      PrefetchDir  *pd)
+{
+	GFileEnumerator *enumerator;
+
+	enumerator = g_file_enumerate_children_finish (file, result, NULL);
+
+	if (enumerator == NULL)
+	{
+		prefetch_dir_done (pd, FALSE);
+		return;
+	}
+
+	g_file_enumerator_next_files_async (enumerator,
+					    DIRECTORY_LOAD_ITEMS_PER_CALLBACK_MAX,
+					    G_PRIORITY_DEFAULT,
+					    pd->prefetch->cancellable,
+					    (GAsyncReadyCallback)prefetch_next_files_cb,
+					    pd);
+}
+
+static gboolean
+prefetch_expire (Prefetch *prefetch)
+{
+	prefetch->expire_id = 0;
+	model_prefetch_stop (prefetch->model);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+prefetch_next (Prefetch *prefetch)
+{
+	while (prefetch->model != NULL &&
+	       prefetch->running < PREFETCH_MAX_ENUMERATORS &&
+	       !g_queue_is_empty (&prefetch->pending))
+	{
+		PrefetchDir *pd = g_queue_pop_head (&prefetch->pending);
+
+		prefetch->running++;
+
+		g_file_enumerate_children_async (pd->location,
+						 LOAD_ATTRIBUTE_TYPES,
+						 G_FILE_QUERY_INFO_NONE,
+						 G_PRIORITY_DEFAULT,
+						 prefetch->cancellable,
+						 (GAsyncReadyCallback)prefetch_children_cb,
+						 pd);
+	}
+
+	if (prefetch->running > 0)
+		return;
+
+	if (prefetch->model == NULL)
+	{
+		prefetch_free (prefetch);
+	}
+	else if (prefetch->expire_id == 0)
+	{
+		/* The directories not loaded by then are listed again */
+		prefetch->expire_id = g_timeout_add_seconds (PREFETCH_LIFETIME,
+							     (GSourceFunc)prefetch_expire,
+							     prefetch);
+	}
+}
+
+static void
+model_prefetch_stop (GeditFileBrowserStore *model)
+{
+	Prefetch *prefetch = model->priv->prefetch;
+	GHashTableIter iter;
+	gpointer value;
+
+	if (prefetch == NULL)
+		return;
+
+	model->priv->prefetch = NULL;
+	prefetch->model = NULL;
+
+	g_cancellable_cancel (prefetch->cancellable);
+	g_queue_clear (&prefetch->pending);
+
+	if (prefetch->expire_id != 0)
+	{
+		g_source_remove (prefetch->expire_id);
+		prefetch->expire_id = 0;
+	}
+
+	/* The loads waiting for a listing enumerate their directory */
+	g_hash_table_iter_init (&iter, prefetch->dirs);
+
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+	{
+		PrefetchDir *pd = value;
+		AsyncNode *async = pd->async;
+
+		if (async == NULL)
+			continue;
+
+		pd->async = NULL;
+
+		if (g_cancellable_is_cancelled (async->cancellable))
+			async_node_free (async);
+		else
+			model_query_directory (async);
+	}
+
+	if (prefetch->running == 0)
+		prefetch_free (prefetch);
+}
+
+/* Returns the listing of @location made to load it, if it was not used by
+ * a load yet */
+static PrefetchDir *
+model_prefetch_lookup (GeditFileBrowserStore *model,
+		       GFile                 *location)
+{
+	PrefetchDir *pd;
+
+	if (model->priv->prefetch == NULL)
+		return NULL;
+
+	pd = g_hash_table_lookup (model->priv->prefetch->dirs, location);
+
+	if (pd == NULL || pd->used)
+		return NULL;
+
+	return pd;
+}
+
+static gint
+compare_prefetch_depth (gconstpointer a,
+			gconstpointer b)
+{
+	PrefetchDir *pd1 = *(PrefetchDir **)a;
+	PrefetchDir *pd2 = *(PrefetchDir **)b;
+
+	return (gint)pd1->depth - (gint)pd2->depth;
+}
+
+static void
+model_load_directory (GeditFileBrowserStore *model,
+		      FileBrowserNode       *node)
+{
+	FileBrowserNodeDir *dir;
+	AsyncNode *async;
+	PrefetchDir *pd;
+	GList *cached;
+
+	g_return_if_fail (NODE_IS_DIR (node));
+
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	/* Cancel a previous load */
+	if (dir->cancellable != NULL)
+		file_browser_node_unload (dir->model, node, TRUE);
+
+	node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
+	model_begin_loading (model, node);
+
+	dir->cancellable = g_cancellable_new ();
+
+	async = g_slice_new0 (AsyncNode);
+	async->dir = dir;
 	async->cancellable = g_object_ref (dir->cancellable);
-	async->original_children = g_slist_copy (dir->children);
+	async->n_items = DIRECTORY_LOAD_ITEMS_PER_CALLBACK_MIN;
+	async->original_children = node_get_children_names (node);
 
-	/* Start loading async */
-	g_file_enumerate_children_async (node->file,
-					 STANDARD_ATTRIBUTE_TYPES,
-					 G_FILE_QUERY_INFO_NONE,
-					 G_PRIORITY_DEFAULT,
-					 async->cancellable,
-					 (GAsyncReadyCallback)model_iterate_children_cb,
-					 async);
+	/* The directory is being listed to be expanded again */
+	pd = model_prefetch_lookup (model, dir->file);
+
+	if (pd != NULL)
+	{
+		pd->used = TRUE;
+
+		if (pd->done)
+			model_load_prefetched (async, pd);
+		else
+			pd->async = async;
+
+		return;
+	}
+
+	/* Show the cached listing until the directory is checked */
+	cached = gedit_file_browser_cache_lookup (dir->file, &async->cached_mtime);
+
+	if (cached != NULL)
+	{
+		async->cached = TRUE;
+		model_add_nodes_from_files (model, node, async->original_children, cached);
+		g_list_free (cached);
+
+		if (async->original_children != NULL)
+			g_hash_table_unref (async->original_children);
+
+		async->original_children = node_get_children_names (node);
+	}
+
+	model_query_directory (async);
+}
+
+static gboolean
+node_is_loading (FileBrowserNode *node)
+{
+	return NODE_LOADED (node) && FILE_BROWSER_NODE_DIR (node)->cancellable != NULL;
+}
+
+static void
+deep_filter_dir_free (DeepFilterDir *data)
+{
+	g_object_unref (data->directory);
+	g_slice_free (DeepFilterDir, data);
+}
+
+static void
+deep_filter_push (DeepFilter *deep,
+		  GFile      *directory,
+		  guint       depth)
+{
+	DeepFilterDir *data = g_slice_new (DeepFilterDir);
+
+	data->deep = deep;
+	data->directory = directory;
+	data->depth = depth;
+
+	g_queue_push_tail (&deep->pending, data);
+}
+
+static void
+deep_filter_free (DeepFilter *deep)
+{
+	g_queue_clear_full (&deep->pending, (GDestroyNotify)deep_filter_dir_free);
+	g_object_unref (deep->cancellable);
+	g_free (deep->filesystem);
+	g_slice_free (DeepFilter, deep);
+}
+
+/* Returns whether the file of @info, found by the deep filter, would be
+ * shown by the filters of @model */
+static gboolean
+model_deep_filter_match (GeditFileBrowserStore *model,
+			 GFileInfo             *info)
+{
+	gchar const *name = g_file_info_get_name (info);
+	gchar *display_name = NULL;
+	gboolean match;
+
+	if (FILTER_BINARY (model->priv->filter_mode) &&
+	    !content_type_is_text (file_info_get_content_type (info)))
+	{
+		return FALSE;
+	}
+
+	/* The patterns are matched against the names for display */
+	if (!g_utf8_validate (name, -1, NULL))
+		name = display_name = g_filename_display_name (name);
+
+	match = filter_patterns_match (model->priv->pattern_filter, name);
+
+	if (match &&
+	    FILTER_BINARY (model->priv->filter_mode) &&
+	    model->priv->binary_filter != NULL)
+	{
+		match = !filter_patterns_match (model->priv->binary_filter, name);
+	}
+
+	g_free (display_name);
+
+	return match;
+}
+
+/* Returns the node of the directory @file in @parent, which is added if the
+ * directory is not loaded yet, or NULL if it is being loaded */
+static FileBrowserNode *
+model_deep_filter_add_dir (GeditFileBrowserStore *model,
+			   FileBrowserNode       *parent,
+			   GFile                 *file)
+{
+	FileBrowserNode *node;
+
+	node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file);
+
+	if (node != NULL)
+		return NODE_IS_DIR (node) ? node : NULL;
+
+	/* The directory is added by the loading */
+	if (node_is_loading (parent))
+		return NULL;
+
+	/* Not queried, the hidden directories are not walked when they are
+	 * filtered */
+	node = file_browser_node_dir_new (model, file, parent);
+	model_node_update_visibility (model, node);
+	model_add_node (model, node, parent);
+
+	return node;
+}
+
+/* Marks @file, below the virtual root, as a directory with matches of the
+ * deep filter, showing its node if it has one. Returns whether it was not
+ * marked yet. */
+static gboolean
+model_deep_filter_mark_dir (GeditFileBrowserStore *model,
+			    FileBrowserNode       *parent,
+			    GFile                 *file)
+{
+	FileBrowserNode *node;
+
+	if (g_hash_table_contains (model->priv->deep_matches, file))
+		return FALSE;
+
+	g_hash_table_add (model->priv->deep_matches, g_object_ref (file));
+
+	if (parent == NULL)
+		return TRUE;
+
+	node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file);
+
+	if (node != NULL && NODE_IS_DIR (node))
+	{
+		model_refilter_node_changes (model, node, NULL, FILTER_CHANGE_DEEP);
+		model_check_dummy (model, parent);
+	}
+
+	return TRUE;
+}
+
+/* Adds the files of @infos found by the deep filter in @directory to the
+ * model, with the directories between the virtual root and @directory, which
+ * are then expanded by the view */
+static void
+model_deep_filter_add_files (GeditFileBrowserStore *model,
+			     GFile                 *directory,
+			     GList                 *infos)
+{
+	FileBrowserNode *node = model->priv->virtual_root;
+	FileBrowserNode *expand = NULL;
+	gchar *relative = NULL;
+	GHashTable *children;
+
+	if (node != NULL && !g_file_equal (FILE_BROWSER_NODE_DIR (node)->file, directory))
+	{
+		relative = g_file_get_relative_path (FILE_BROWSER_NODE_DIR (node)->file, directory);
+
+		if (relative == NULL)
+			node = NULL;
+	}
+
+	if (relative != NULL)
+	{
+		gchar **names = g_strsplit (relative, G_DIR_SEPARATOR_S, -1);
+		GFile *location = g_object_ref (FILE_BROWSER_NODE_DIR (node)->file);
+		gboolean marked = FALSE;
+
+		/* The directories are marked before their nodes are added, to
+		 * be shown, and even when they are added by a loading */
+		for (guint i = 0; names[i] != NULL; ++i)
+		{
+			GFile *file;
+
+			if (*names[i] == '\0')
+				continue;
+
+			file = g_file_get_child (location, names[i]);
+			marked = model_deep_filter_mark_dir (model, node, file);
+
+			if (node != NULL)
+				node = model_deep_filter_add_dir (model, node, file);
+
+			if (node != NULL)
+				expand = node;
+
+			g_object_unref (location);
+			location = file;
+		}
+
+		/* Expanded once, when its first matches are found */
+		if (!marked)
+			expand = NULL;
+
+		g_object_unref (location);
+		g_strfreev (names);
+		g_free (relative);
+	}
+
+	if (expand != NULL && model_node_visibility (model, expand))
+	{
+		GtkTreeIter iter;
+
+		iter.user_data = expand;
+		g_signal_emit (model, model_signals[DEEP_FILTER_MATCH], 0, &iter);
+	}
+
+	/* The files of the directories being loaded are added by the loading */
+	if (node == NULL || node_is_loading (node))
+	{
+		g_list_free_full (infos, g_object_unref);
+		return;
+	}
+
+	children = node_get_children_names (node);
+	model_add_nodes_from_files (model, node, children, infos);
+	g_list_free (infos);
+
+	if (children != NULL)
+		g_hash_table_unref (children);
+}
+
+static void deep_filter_next (DeepFilter *deep);
+
+static void
+deep_filter_dir_done (DeepFilterDir *data)
+{
+	DeepFilter *deep = data->deep;
+
+	deep_filter_dir_free (data);
+
+	deep->running--;
+	deep_filter_next (deep);
+}
+
+static void
+deep_filter_next_files_cb (GFileEnumerator *enumerator,
+			   GAsyncResult    *result,
+			   DeepFilterDir   *data)
+{
+	DeepFilter *deep = data->deep;
+	GeditFileBrowserStore *model = deep->model;
+	GList *files;
+	GList *matches = NULL;
+
+	files = g_file_enumerator_next_files_finish (enumerator, result, NULL);
+
+	/* Stopped */
+	if (model == NULL)
+	{
+		g_list_free_full (files, g_object_unref);
+		files = NULL;
+	}
+
+	for (GList *item = files; item; item = item->next)
+	{
+		GFileInfo *info = G_FILE_INFO (item->data);
+		GFileType type = g_file_info_get_file_type (info);
+
+		if (FILTER_HIDDEN (model->priv->filter_mode) &&
+		    (g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info)))
+		{
+			continue;
+		}
+
+		/* The symbolic links are not followed, not to walk in circles,
+		 * nor the mount points */
+		if (type == G_FILE_TYPE_DIRECTORY)
+		{
+			if (data->depth < DEEP_FILTER_MAX_DEPTH &&
+			    g_strcmp0 (g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM),
+				       deep->filesystem) == 0)
+			{
+				deep_filter_push (deep,
+						  g_file_get_child (data->directory,
+								    g_file_info_get_name (info)),
+						  data->depth + 1);
+			}
+		}
+		else if (type == G_FILE_TYPE_REGULAR &&
+			 deep->n_matches < DEEP_FILTER_MAX_MATCHES &&
+			 model_deep_filter_match (model, info))
+		{
+			matches = g_list_prepend (matches, g_object_ref (info));
+			deep->n_matches++;
+		}
+	}
+
+	if (matches != NULL)
+		model_deep_filter_add_files (model, data->directory, matches);
+
+	if (files != NULL && deep->n_matches < DEEP_FILTER_MAX_MATCHES)
+	{
+		g_list_free_full (files, g_object_unref);
+
+		g_file_enumerator_next_files_async (enumerator,
+						    DEEP_FILTER_ITEMS_PER_CALLBACK,
+						    G_PRIORITY_LOW,
+						    deep->cancellable,
+						    (GAsyncReadyCallback)deep_filter_next_files_cb,
+						    data);
+		return;
+	}
+
+	g_list_free_full (files, g_object_unref);
+
+	if (deep->n_matches >= DEEP_FILTER_MAX_MATCHES)
+		g_queue_clear_full (&deep->pending, (GDestroyNotify)deep_filter_dir_free);
+
+	g_file_enumerator_close_async (enumerator, G_PRIORITY_LOW, NULL, NULL, NULL);
+	g_object_unref (enumerator);
+
+	deep_filter_dir_done (data);
+}
+
+static void
+deep_filter_children_cb (GFile         *file,
+			 GAsyncResult  *result,
+			 DeepFilterDir *data)
+{
+	GFileEnumerator *enumerator;
+
+	enumerator = g_file_enumerate_children_finish (file, result, NULL);
+
+	if (enumerator == NULL)
+	{
+		deep_filter_dir_done (data);
+		return;
+	}
+
+	g_file_enumerator_next_files_async (enumerator,
+					    DEEP_FILTER_ITEMS_PER_CALLBACK,
+					    G_PRIORITY_LOW,
+					    data->deep->cancellable,
+					    (GAsyncReadyCallback)deep_filter_next_files_cb,
+					    data);
+}
+
+/* Enumerates the pending directories, breadth first so that the matches
+ * closest to the virtual root are found first */
+static void
+deep_filter_next (DeepFilter *deep)
+{
+	if (deep->n_directories >= DEEP_FILTER_MAX_DIRECTORIES)
+		g_queue_clear_full (&deep->pending, (GDestroyNotify)deep_filter_dir_free);
+
+	while (deep->model != NULL &&
+	       deep->running < DEEP_FILTER_MAX_ENUMERATORS &&
+	       !g_queue_is_empty (&deep->pending))
+	{
+		DeepFilterDir *data = g_queue_pop_head (&deep->pending);
+
+		deep->running++;
+		deep->n_directories++;
+
+		g_file_enumerate_children_async (data->directory,
+						 DEEP_FILTER_ATTRIBUTE_TYPES,
+						 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						 G_PRIORITY_LOW,
+						 deep->cancellable,
+						 (GAsyncReadyCallback)deep_filter_children_cb,
+						 data);
+	}
+
+	if (deep->running == 0)
+	{
+		if (deep->model != NULL)
+			deep->model->priv->deep_filter = NULL;
+
+		deep_filter_free (deep);
+	}
+}
+
+static void
+model_deep_filter_stop (GeditFileBrowserStore *model)
+{
+	DeepFilter *deep = model->priv->deep_filter;
+
+	if (deep == NULL)
+		return;
+
+	model->priv->deep_filter = NULL;
+	deep->model = NULL;
+
+	g_cancellable_cancel (deep->cancellable);
+	g_queue_clear_full (&deep->pending, (GDestroyNotify)deep_filter_dir_free);
+}
+
+/* Starts the walk once the file system of the virtual root is known */
+static void
+deep_filter_root_info_cb (GFile        *file,
+			  GAsyncResult *result,
+			  DeepFilter   *deep)
+{
+	GFileInfo *info = g_file_query_info_finish (file, result, NULL);
+
+	deep->running--;
+
+	if (info != NULL)
+	{
+		if (deep->model != NULL)
+		{
+			deep->filesystem = g_strdup (g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM));
+			deep_filter_push (deep, g_object_ref (file), 0);
+		}
+
+		g_object_unref (info);
+	}
+
+	deep_filter_next (deep);
+}
+
+/* Starts the walk of the directories below the virtual root in the deep
+ * filter mode, stopping a previous one. The directories are filtered until
+ * matches are found below them. */
+static void
+model_deep_filter_start (GeditFileBrowserStore *model)
+{
+	GHashTable *old_matches = model->priv->deep_matches;
+	DeepFilter *deep;
+
+	model_deep_filter_stop (model);
+
+	if (!FILTER_DEEP (model->priv->filter_mode) ||
+	    model->priv->pattern_filter == NULL ||
+	    model->priv->virtual_root == NULL)
+	{
+		model->priv->deep_matches = NULL;
+	}
+	else
+	{
+		model->priv->deep_matches = g_hash_table_new_full (g_file_hash,
+								   (GEqualFunc)g_file_equal,
+								   g_object_unref,
+								   NULL);
+	}
+
+	if (old_matches != NULL || model->priv->deep_matches != NULL)
+		model_refilter (model, FILTER_CHANGE_DEEP);
+
+	if (old_matches != NULL)
+		g_hash_table_destroy (old_matches);
+
+	if (model->priv->deep_matches == NULL)
+		return;
+
+	deep = g_slice_new0 (DeepFilter);
+	deep->model = model;
+	deep->cancellable = g_cancellable_new ();
+	g_queue_init (&deep->pending);
+
+	/* Counted as running, to be freed once stopped */
+	deep->running = 1;
+	model->priv->deep_filter = deep;
+
+	g_file_query_info_async (FILE_BROWSER_NODE_DIR (model->priv->virtual_root)->file,
+				 G_FILE_ATTRIBUTE_ID_FILESYSTEM,
+				 G_FILE_QUERY_INFO_NONE,
+				 G_PRIORITY_LOW,
+				 deep->cancellable,
+				 (GAsyncReadyCallback)deep_filter_root_info_cb,
+				 deep);
 }
 
 static GList *
@@ -2385,7 +4227,7 @@ get_parent_files (GeditFileBrowserStore *model,
 
 	while ((file = g_file_get_parent (file)))
 	{
-		if (g_file_equal (file, model->priv->root->file))
+		if (g_file_equal (file, FILE_BROWSER_NODE_DIR (model->priv->root)->file))
 		{
 			g_object_unref (file);
 			break;
@@ -2404,7 +4246,6 @@ model_fill (GeditFileBrowserStore  *model,
 {
 	gboolean free_path = FALSE;
 	GtkTreeIter iter = {0,};
-	GSList *item;
 	FileBrowserNode *child;
 
 	if (node == NULL)
@@ -2440,9 +4281,11 @@ model_fill (GeditFileBrowserStore  *model,
 		/* Go to the first child */
 		gtk_tree_path_down (*path);
 
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+
+		for (guint i = 0; i < dir->children->len; ++i)
 		{
-			child = (FileBrowserNode *) (item->data);
+			child = DIR_CHILD (dir, i);
 
 			if (model_node_visibility (model, child))
 			{
@@ -2471,60 +4314,73 @@ set_virtual_root_from_node (GeditFileBrowserStore *model,
 	FileBrowserNode *next = prev->parent;
 	FileBrowserNode *check;
 	FileBrowserNodeDir *dir;
-	GSList *copy;
 	GtkTreePath *empty = NULL;
 
 	/* Free all the nodes below that we don't need in cache */
 	while (prev != model->priv->root)
 	{
 		dir = FILE_BROWSER_NODE_DIR (next);
-		copy = g_slist_copy (dir->children);
 
-		for (GSList *item = copy; item; item = item->next)
+		if (prev == node)
 		{
-			check = (FileBrowserNode *)(item->data);
-
-			if (prev == node)
+			/* Only free the children, keeping this depth in cache */
+			for (guint i = 0; i < dir->children->len; ++i)
 			{
-				/* Only free the children, keeping this depth in cache */
+				check = DIR_CHILD (dir, i);
+
 				if (check != node)
 				{
 					file_browser_node_free_children (model, check);
 					file_browser_node_unload (model, check, FALSE);
 				}
 			}
-			else if (check != prev)
+		}
+		else
+		{
+			/* Only keep the node in the chain */
+			GPtrArray *children = dir->children;
+
+			dir->children = g_ptr_array_new ();
+			g_ptr_array_add (dir->children, prev);
+			dir_invalidate_rows (dir);
+
+			for (guint i = 0; i < children->len; ++i)
 			{
-				/* Only free when the node is not in the chain */
-				dir->children = g_slist_remove (dir->children, check);
-				file_browser_node_free (model, check);
+				check = g_ptr_array_index (children, i);
+
+				if (check != prev)
+					file_browser_node_free (model, check);
 			}
-		}
 
-		if (prev != node)
+			g_ptr_array_unref (children);
 			file_browser_node_unload (model, next, FALSE);
+		}
 
-		g_slist_free (copy);
 		prev = next;
 		next = prev->parent;
 	}
 
 	/* Free all the nodes up that we don't need in cache */
-	for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	for (guint i = 0; i < dir->children->len; ++i)
 	{
-		check = (FileBrowserNode *)(item->data);
+		check = DIR_CHILD (dir, i);
 
 		if (NODE_IS_DIR (check))
 		{
-			for (copy = FILE_BROWSER_NODE_DIR (check)->children; copy; copy = copy->next)
+			FileBrowserNodeDir *check_dir = FILE_BROWSER_NODE_DIR (check);
+
+			for (guint j = 0; j < check_dir->children->len; ++j)
 			{
-				file_browser_node_free_children (model, (FileBrowserNode*) (copy->data));
-				file_browser_node_unload (model, (FileBrowserNode*) (copy->data), FALSE);
+				file_browser_node_free_children (model, DIR_CHILD (check_dir, j));
+				file_browser_node_unload (model, DIR_CHILD (check_dir, j), FALSE);
 			}
 		}
 		else if (NODE_IS_DUMMY (check))
 		{
 			check->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			model_node_update_row (model, check);
 		}
 	}
 
@@ -2539,6 +4395,8 @@ set_virtual_root_from_node (GeditFileBrowserStore *model,
 
 	if (!NODE_LOADED (node))
 		model_load_directory (model, node);
+
+	model_deep_filter_start (model);
 }
 
 static void
@@ -2576,15 +4434,29 @@ model_find_node_children (GeditFileBrowserStore *model,
 	FileBrowserNodeDir *dir;
 	FileBrowserNode *child;
 	FileBrowserNode *result;
+	GFile *location;
 
 	if (!NODE_IS_DIR (parent))
 		return NULL;
 
 	dir = FILE_BROWSER_NODE_DIR (parent);
+	location = g_file_get_parent (file);
+
+	/* The files are found by name in their directory */
+	if (location != NULL && g_file_equal (location, dir->file))
+	{
+		g_object_unref (location);
+		return node_list_contains_file (dir->children, file);
+	}
+
+	g_clear_object (&location);
 
-	for (GSList *children = dir->children; children; children = children->next)
+	for (guint i = 0; i < dir->children->len; ++i)
 	{
-		child = (FileBrowserNode *)(children->data);
+		child = DIR_CHILD (dir, i);
+
+		if (!NODE_IS_DIR (child))
+			continue;
 
 		result = model_find_node (model, child, file);
 
@@ -2603,11 +4475,26 @@ model_find_node (GeditFileBrowserStore *model,
 	if (node == NULL)
 		node = model->priv->root;
 
-	if (node->file && g_file_equal (node->file, file))
-		return node;
+	if (NODE_IS_DIR (node))
+	{
+		GFile *location = FILE_BROWSER_NODE_DIR (node)->file;
+
+		if (g_file_equal (location, file))
+			return node;
+
+		if (g_file_has_prefix (file, location))
+			return model_find_node_children (model, node, file);
+	}
+	else if (node->basename != NULL)
+	{
+		GFile *location = node_get_file (node);
+		gboolean equal = g_file_equal (location, file);
+
+		g_object_unref (location);
 
-	if (NODE_IS_DIR (node) && g_file_has_prefix (file, node->file))
-		return model_find_node_children (model, node, file);
+		if (equal)
+			return node;
+	}
 
 	return NULL;
 }
@@ -2747,7 +4634,7 @@ model_mount_root (GeditFileBrowserStore *model,
 	GError *error = NULL;
 	MountInfo *mount_info;
 
-	info = g_file_query_info (model->priv->root->file,
+	info = g_file_query_info (FILE_BROWSER_NODE_DIR (model->priv->root)->file,
 				  G_FILE_ATTRIBUTE_STANDARD_TYPE,
 				  G_FILE_QUERY_INFO_NONE,
 				  NULL,
@@ -2769,7 +4656,7 @@ model_mount_root (GeditFileBrowserStore *model,
 			mount_info->cancellable = g_object_ref (FILE_BROWSER_NODE_DIR (model->priv->root)->cancellable);
 
 			model_begin_loading (model, model->priv->root);
-			g_file_mount_enclosing_volume (model->priv->root->file,
+			g_file_mount_enclosing_volume (FILE_BROWSER_NODE_DIR (model->priv->root)->file,
 						       G_MOUNT_MOUNT_NONE,
 						       mount_info->operation,
 						       mount_info->cancellable,
@@ -2827,11 +4714,11 @@ gedit_file_browser_store_set_value (GeditFileBrowserStore *tree_model,
 
 		data = g_value_dup_string (value);
 
-		if (!data)
-			data = g_strdup (node->name);
-
-		g_free (node->markup);
-		node->markup = data;
+		/* Otherwise the markup is made from the name */
+		if (data != NULL)
+			g_hash_table_insert (GEDIT_FILE_BROWSER_STORE (tree_model)->priv->markups, node, data);
+		else
+			g_hash_table_remove (GEDIT_FILE_BROWSER_STORE (tree_model)->priv->markups, node);
 	}
 	else if (column == GEDIT_FILE_BROWSER_STORE_COLUMN_EMBLEM)
 	{
@@ -2895,11 +4782,11 @@ gedit_file_browser_store_set_virtual_root_from_location (GeditFileBrowserStore *
 	}
 
 	/* Check if uri is already the virtual root */
-	if (model->priv->virtual_root && g_file_equal (model->priv->virtual_root->file, root))
+	if (model->priv->virtual_root && g_file_equal (FILE_BROWSER_NODE_DIR (model->priv->virtual_root)->file, root))
 		return GEDIT_FILE_BROWSER_STORE_RESULT_NO_CHANGE;
 
 	/* Check if uri is the root itself */
-	if (g_file_equal (model->priv->root->file, root))
+	if (g_file_equal (FILE_BROWSER_NODE_DIR (model->priv->root)->file, root))
 	{
 		/* Always clear the model before altering the nodes */
 		model_clear (model, FALSE);
@@ -2907,9 +4794,9 @@ gedit_file_browser_store_set_virtual_root_from_location (GeditFileBrowserStore *
 		return GEDIT_FILE_BROWSER_STORE_RESULT_OK;
 	}
 
-	if (!g_file_has_prefix (root, model->priv->root->file))
+	if (!g_file_has_prefix (root, FILE_BROWSER_NODE_DIR (model->priv->root)->file))
 	{
-		gchar *str = g_file_get_parse_name (model->priv->root->file);
+		gchar *str = g_file_get_parse_name (FILE_BROWSER_NODE_DIR (model->priv->root)->file);
 		gchar *str1 = g_file_get_parse_name (root);
 
 		g_warning ("Virtual root (%s) is not below actual root (%s)", str1, str);
@@ -3018,7 +4905,7 @@ gedit_file_browser_store_set_root_and_virtual_root (GeditFileBrowserStore *model
 
 	if (root != NULL && model->priv->root != NULL)
 	{
-		equal = g_file_equal (root, model->priv->root->file);
+		equal = g_file_equal (root, FILE_BROWSER_NODE_DIR (model->priv->root)->file);
 
 		if (equal && virtual_root == NULL)
 			return GEDIT_FILE_BROWSER_STORE_RESULT_NO_CHANGE;
@@ -3026,13 +4913,16 @@ gedit_file_browser_store_set_root_and_virtual_root (GeditFileBrowserStore *model
 
 	if (virtual_root)
 	{
-		if (equal && g_file_equal (virtual_root, model->priv->virtual_root->file))
+		if (equal && g_file_equal (virtual_root, FILE_BROWSER_NODE_DIR (model->priv->virtual_root)->file))
 			return GEDIT_FILE_BROWSER_STORE_RESULT_NO_CHANGE;
 	}
 
 	/* Make sure to cancel any previous mount operations */
 	cancel_mount_operation (model);
 
+	model_deep_filter_stop (model);
+	model_prefetch_stop (model);
+
 	/* Always clear the model before altering the nodes */
 	model_clear (model, TRUE);
 	file_browser_node_free (model, model->priv->root);
@@ -3071,10 +4961,10 @@ gedit_file_browser_store_get_root (GeditFileBrowserStore *model)
 {
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model), NULL);
 
-	if (model->priv->root == NULL || model->priv->root->file == NULL)
+	if (model->priv->root == NULL)
 		return NULL;
 	else
-		return g_file_dup (model->priv->root->file);
+		return g_file_dup (FILE_BROWSER_NODE_DIR (model->priv->root)->file);
 }
 
 GFile *
@@ -3082,10 +4972,10 @@ gedit_file_browser_store_get_virtual_root (GeditFileBrowserStore *model)
 {
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model), NULL);
 
-	if (model->priv->virtual_root == NULL || model->priv->virtual_root->file == NULL)
+	if (model->priv->virtual_root == NULL)
 		return NULL;
 	else
-		return g_file_dup (model->priv->virtual_root->file);
+		return g_file_dup (FILE_BROWSER_NODE_DIR (model->priv->virtual_root)->file);
 }
 
 void
@@ -3107,6 +4997,95 @@ _gedit_file_browser_store_iter_expanded (GeditFileBrowserStore *model,
 	}
 }
 
+/* Lists the directories of @locations below the virtual root in parallel, so
+ * that they are loaded at once when they are expanded again */
+void
+_gedit_file_browser_store_prefetch (GeditFileBrowserStore *model,
+				    GList                 *locations)
+{
+	FileBrowserNode *virtual_root;
+	Prefetch *prefetch;
+	GPtrArray *dirs;
+
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+
+	model_prefetch_stop (model);
+
+	virtual_root = model->priv->virtual_root;
+
+	if (virtual_root == NULL || locations == NULL)
+		return;
+
+	prefetch = g_slice_new0 (Prefetch);
+	prefetch->model = model;
+	prefetch->cancellable = g_cancellable_new ();
+	prefetch->dirs = g_hash_table_new_full (g_file_hash,
+						(GEqualFunc)g_file_equal,
+						NULL,
+						(GDestroyNotify)prefetch_dir_free);
+	g_queue_init (&prefetch->pending);
+
+	dirs = g_ptr_array_new ();
+
+	for (GList *item = locations; item; item = item->next)
+	{
+		GFile *location = G_FILE (item->data);
+		PrefetchDir *pd;
+		gchar *relative;
+
+		/* The virtual root is loaded anyway */
+		relative = g_file_get_relative_path (FILE_BROWSER_NODE_DIR (virtual_root)->file, location);
+
+		if (relative == NULL || g_hash_table_contains (prefetch->dirs, location))
+		{
+			g_free (relative);
+			continue;
+		}
+
+		pd = g_slice_new0 (PrefetchDir);
+		pd->prefetch = prefetch;
+		pd->location = g_object_ref (location);
+
+		for (gchar const *c = relative; *c != '\0'; ++c)
+		{
+			if (*c == G_DIR_SEPARATOR)
+				pd->depth++;
+		}
+
+		g_hash_table_insert (prefetch->dirs, pd->location, pd);
+		g_ptr_array_add (dirs, pd);
+		g_free (relative);
+	}
+
+	/* The directories closest to the virtual root are needed first */
+	g_ptr_array_sort (dirs, compare_prefetch_depth);
+
+	for (guint i = 0; i < dirs->len; ++i)
+		g_queue_push_tail (&prefetch->pending, g_ptr_array_index (dirs, i));
+
+	g_ptr_array_unref (dirs);
+
+	model->priv->prefetch = prefetch;
+	prefetch_next (prefetch);
+}
+
+/* Makes the icon of the row of @iter, which is shown, if it is not made yet */
+void
+_gedit_file_browser_store_iter_resolve (GeditFileBrowserStore *model,
+					GtkTreeIter           *iter)
+{
+	FileBrowserNode *node;
+
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+	g_return_if_fail (iter != NULL);
+	g_return_if_fail (iter->user_data != NULL);
+
+	node = (FileBrowserNode *)(iter->user_data);
+
+	if (!node->resolved)
+		model_resolve_node (model, node);
+}
+
 void
 _gedit_file_browser_store_iter_collapsed (GeditFileBrowserStore *model,
 					  GtkTreeIter           *iter)
@@ -3121,11 +5100,13 @@ _gedit_file_browser_store_iter_collapsed (GeditFileBrowserStore *model,
 
 	if (NODE_IS_DIR (node) && NODE_LOADED (node))
 	{
+		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
+
 		/* Unload children of the children, keeping 1 depth in cache */
 
-		for (GSList *item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+		for (guint i = 0; i < dir->children->len; ++i)
 		{
-			node = (FileBrowserNode *)(item->data);
+			node = DIR_CHILD (dir, i);
 
 			if (NODE_IS_DIR (node) && NODE_LOADED (node))
 			{
@@ -3146,13 +5127,27 @@ void
 gedit_file_browser_store_set_filter_mode (GeditFileBrowserStore           *model,
 					  GeditFileBrowserStoreFilterMode  mode)
 {
+	GeditFileBrowserStoreFilterMode changed;
+	FilterChange changes = 0;
+
 	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
 
 	if (model->priv->filter_mode == mode)
 		return;
 
+	changed = model->priv->filter_mode ^ mode;
+
+	if (FILTER_HIDDEN (changed))
+		changes |= FILTER_CHANGE_HIDDEN;
+
+	if (FILTER_BINARY (changed))
+		changes |= FILTER_CHANGE_BINARY;
+
 	model->priv->filter_mode = mode;
-	model_refilter (model);
+	model_refilter (model, changes);
+
+	if (FILTER_DEEP (changed) || FILTER_DEEP (mode))
+		model_deep_filter_start (model);
 
 	g_object_notify (G_OBJECT (model), "filter-mode");
 }
@@ -3166,7 +5161,7 @@ gedit_file_browser_store_set_filter_func (GeditFileBrowserStore           *model
 
 	model->priv->filter_func = func;
 	model->priv->filter_user_data = user_data;
-	model_refilter (model);
+	model_refilter (model, FILTER_CHANGE_ALL);
 }
 
 const gchar * const *
@@ -3181,38 +5176,55 @@ gedit_file_browser_store_set_binary_patterns (GeditFileBrowserStore  *model,
 {
 	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
 
-	if (model->priv->binary_patterns != NULL)
-	{
-		g_strfreev (model->priv->binary_patterns);
-		g_ptr_array_unref (model->priv->binary_pattern_specs);
-	}
+	g_strfreev (model->priv->binary_patterns);
+	filter_patterns_free (model->priv->binary_filter);
 
 	model->priv->binary_patterns = g_strdupv ((gchar **)binary_patterns);
+	model->priv->binary_filter = filter_patterns_new ((const gchar * const *)binary_patterns);
 
-	if (binary_patterns == NULL)
-	{
-		model->priv->binary_pattern_specs = NULL;
-	}
-	else
-	{
-		gssize n_patterns = g_strv_length ((gchar **) binary_patterns);
+	/* The binary patterns only filter when binary files are hidden */
+	if (FILTER_BINARY (model->priv->filter_mode))
+		model_refilter (model, FILTER_CHANGE_BINARY);
 
-		model->priv->binary_pattern_specs = g_ptr_array_sized_new (n_patterns);
-		g_ptr_array_set_free_func (model->priv->binary_pattern_specs, (GDestroyNotify) g_pattern_spec_free);
+	g_object_notify (G_OBJECT (model), "binary-patterns");
+}
 
-		for (guint i = 0; binary_patterns[i] != NULL; ++i)
-			g_ptr_array_add (model->priv->binary_pattern_specs, g_pattern_spec_new (binary_patterns[i]));
-	}
+const gchar *
+gedit_file_browser_store_get_filter_pattern (GeditFileBrowserStore *model)
+{
+	return model->priv->filter_pattern;
+}
 
-	model_refilter (model);
+/* Only the files whose name matches @pattern are shown, the directories
+ * always are. The pattern is a glob, or NULL to show all the files. */
+void
+gedit_file_browser_store_set_filter_pattern (GeditFileBrowserStore *model,
+					     const gchar           *pattern)
+{
+	const gchar *patterns[] = { pattern, NULL };
 
-	g_object_notify (G_OBJECT (model), "binary-patterns");
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+
+	if (pattern != NULL && *pattern == '\0')
+		pattern = NULL;
+
+	if (g_strcmp0 (model->priv->filter_pattern, pattern) == 0)
+		return;
+
+	g_free (model->priv->filter_pattern);
+	filter_patterns_free (model->priv->pattern_filter);
+
+	model->priv->filter_pattern = g_strdup (pattern);
+	model->priv->pattern_filter = filter_patterns_new (pattern != NULL ? patterns : NULL);
+
+	model_refilter (model, FILTER_CHANGE_PATTERN);
+	model_deep_filter_start (model);
 }
 
 void
 gedit_file_browser_store_refilter (GeditFileBrowserStore *model)
 {
-	model_refilter (model);
+	model_refilter (model, FILTER_CHANGE_ALL);
 }
 
 GeditFileBrowserStoreFilterMode
@@ -3236,31 +5248,27 @@ gedit_file_browser_store_refresh (GeditFileBrowserStore *model)
 	g_signal_emit (model, model_signals[END_REFRESH], 0);
 }
 
+/* The locations of the files follow the location of their directory, only
+ * the ones of the directories below @node have to be made again */
 static void
 reparent_node (FileBrowserNode *node,
 	       gboolean         reparent)
 {
-	if (!node->file)
+	FileBrowserNodeDir *dir;
+
+	if (!NODE_IS_DIR (node))
 		return;
 
+	dir = FILE_BROWSER_NODE_DIR (node);
+
 	if (reparent)
 	{
-		GFile *parent = node->parent->file;
-		gchar *base = g_file_get_basename (node->file);
-
-		g_object_unref (node->file);
-
-		node->file = g_file_get_child (parent, base);
-		g_free (base);
+		g_object_unref (dir->file);
+		dir->file = g_file_get_child (FILE_BROWSER_NODE_DIR (node->parent)->file, node->basename);
 	}
 
-	if (NODE_IS_DIR (node))
-	{
-		FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (node);
-
-		for (GSList *child = dir->children; child; child = child->next)
-			reparent_node ((FileBrowserNode *)child->data, TRUE);
-	}
+	for (guint i = 0; i < dir->children->len; ++i)
+		reparent_node (DIR_CHILD (dir, i), TRUE);
 }
 
 gboolean
@@ -3281,26 +5289,34 @@ gedit_file_browser_store_rename (GeditFileBrowserStore  *model,
 	g_return_val_if_fail (iter->user_data != NULL, FALSE);
 
 	node = (FileBrowserNode *)(iter->user_data);
+	g_return_val_if_fail (node->parent != NULL && node->basename != NULL, FALSE);
 
-	parent = g_file_get_parent (node->file);
-	g_return_val_if_fail (parent != NULL, FALSE);
+	previous = node_get_file (node);
+	parent = g_file_get_parent (previous);
 
 	file = g_file_get_child (parent, new_name);
 	g_object_unref (parent);
 
-	if (g_file_equal (node->file, file))
+	if (g_file_equal (previous, file))
 	{
+		g_object_unref (previous);
 		g_object_unref (file);
 		return TRUE;
 	}
 
-	if (g_file_move (node->file, file, G_FILE_COPY_NONE, NULL, NULL, NULL, &err))
+	if (g_file_move (previous, file, G_FILE_COPY_NONE, NULL, NULL, NULL, &err))
 	{
-		previous = node->file;
-		node->file = file;
+		if (NODE_IS_DIR (node))
+		{
+			g_object_unref (FILE_BROWSER_NODE_DIR (node)->file);
+			FILE_BROWSER_NODE_DIR (node)->file = g_object_ref (file);
+		}
+
+		/* The previous name stays in the names of the parent */
+		file_browser_node_set_name (node, file);
+		g_hash_table_remove (model->priv->markups, node);
 
 		/* This makes sure the actual info for the node is requeried */
-		file_browser_node_set_name (node);
 		file_browser_node_set_from_info (model, node, NULL, TRUE);
 
 		reparent_node (node, FALSE);
@@ -3317,6 +5333,7 @@ gedit_file_browser_store_rename (GeditFileBrowserStore  *model,
 		else
 		{
 			g_object_unref (previous);
+			g_object_unref (file);
 
 			if (error != NULL)
 			{
@@ -3330,14 +5347,16 @@ gedit_file_browser_store_rename (GeditFileBrowserStore  *model,
 			return FALSE;
 		}
 
-		g_signal_emit (model, model_signals[RENAME], 0, previous, node->file);
+		g_signal_emit (model, model_signals[RENAME], 0, previous, file);
 
 		g_object_unref (previous);
+		g_object_unref (file);
 
 		return TRUE;
 	}
 	else
 	{
+		g_object_unref (previous);
 		g_object_unref (file);
 
 		if (err)
@@ -3361,6 +5380,12 @@ async_data_free (AsyncData *data)
 {
 	g_object_unref (data->cancellable);
 	g_list_free_full (data->files, g_object_unref);
+	g_list_free_full (data->no_trash, g_object_unref);
+	g_ptr_array_unref (data->deleted);
+	g_string_free (data->errors, TRUE);
+
+	if (data->flush_id != 0)
+		g_source_remove (data->flush_id);
 
 	if (!data->removed)
 		data->model->priv->async_handles = g_slist_remove (data->model->priv->async_handles, data);
@@ -3374,11 +5399,165 @@ emit_no_trash (AsyncData *data)
 	/* Emit the no trash error */
 	gboolean ret;
 
-	g_signal_emit (data->model, model_signals[NO_TRASH], 0, data->files, &ret);
+	g_signal_emit (data->model, model_signals[NO_TRASH], 0, data->no_trash, &ret);
 
 	return ret;
 }
 
+static void
+emit_delete_progress (AsyncData *data)
+{
+	g_signal_emit (data->model, model_signals[DELETE_PROGRESS], 0, data->n_done, data->n_files);
+}
+
+/* Removes the @nodes, children of @parent, from the model and frees them.
+ * The rows are deleted one by one, but the children of @parent are only
+ * compacted once. */
+static void
+model_remove_nodes_batch (GeditFileBrowserStore *model,
+			  FileBrowserNode       *parent,
+			  GPtrArray             *nodes)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	GHashTable *removed = g_hash_table_new (g_direct_hash, g_direct_equal);
+	guint n_children = 0;
+
+	for (guint i = 0; i < nodes->len; ++i)
+	{
+		FileBrowserNode *node = g_ptr_array_index (nodes, i);
+
+		model_remove_node (model, node, NULL, FALSE);
+		g_hash_table_add (removed, node);
+	}
+
+	for (guint i = 0; i < dir->children->len; ++i)
+	{
+		FileBrowserNode *child = DIR_CHILD (dir, i);
+
+		if (!g_hash_table_contains (removed, child))
+			dir->children->pdata[n_children++] = child;
+	}
+
+	g_ptr_array_set_size (dir->children, n_children);
+	dir_invalidate_rows (dir);
+
+	model_check_dummy (model, parent);
+
+	for (guint i = 0; i < nodes->len; ++i)
+		file_browser_node_free (model, g_ptr_array_index (nodes, i));
+
+	g_hash_table_destroy (removed);
+}
+
+/* Removes the children of @parent named in @names from the model */
+static void
+model_remove_children_named (GeditFileBrowserStore *model,
+			     FileBrowserNode       *parent,
+			     GHashTable            *names)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	FileBrowserNode *virtual_root = model->priv->virtual_root;
+	FileBrowserNode *ancestor = NULL;
+	GPtrArray *nodes = g_ptr_array_new ();
+
+	for (guint i = 0; i < dir->children->len; ++i)
+	{
+		FileBrowserNode *child = DIR_CHILD (dir, i);
+
+		if (child->basename != NULL && g_hash_table_contains (names, child->basename))
+		{
+			/* Removing the virtual root changes it, which frees
+			   the nodes around it */
+			if (child == virtual_root || node_has_parent (virtual_root, child))
+				ancestor = child;
+			else
+				g_ptr_array_add (nodes, child);
+		}
+	}
+
+	if (nodes->len > 0)
+		model_remove_nodes_batch (model, parent, nodes);
+
+	if (ancestor != NULL)
+		model_remove_node (model, ancestor, NULL, TRUE);
+
+	g_ptr_array_unref (nodes);
+}
+
+/* Removes the files deleted by @data since the last time from the model, the
+ * files of a directory together */
+static void
+model_remove_deleted_files (AsyncData *data)
+{
+	GeditFileBrowserStore *model = data->model;
+	GHashTable *parents;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+
+	if (data->deleted->len == 0)
+		return;
+
+	/* The names of the deleted files by parent directory */
+	parents = g_hash_table_new_full (g_file_hash,
+					 (GEqualFunc)g_file_equal,
+					 g_object_unref,
+					 (GDestroyNotify)g_hash_table_unref);
+
+	for (guint i = 0; i < data->deleted->len; ++i)
+	{
+		GFile *file = g_ptr_array_index (data->deleted, i);
+		GFile *parent = g_file_get_parent (file);
+		GHashTable *names;
+
+		if (parent == NULL)
+			continue;
+
+		names = g_hash_table_lookup (parents, parent);
+
+		if (names == NULL)
+		{
+			names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+			g_hash_table_insert (parents, parent, names);
+		}
+		else
+		{
+			g_object_unref (parent);
+		}
+
+		g_hash_table_add (names, g_file_get_basename (file));
+	}
+
+	g_ptr_array_set_size (data->deleted, 0);
+
+	g_hash_table_iter_init (&iter, parents);
+
+	/* The nodes are looked up again for each directory, removing one may
+	   free others */
+	while (model->priv->root != NULL && g_hash_table_iter_next (&iter, &key, &value))
+	{
+		FileBrowserNode *node = model_find_node (model, NULL, G_FILE (key));
+
+		if (node != NULL && NODE_IS_DIR (node))
+			model_remove_children_named (model, node, value);
+	}
+
+	g_hash_table_destroy (parents);
+}
+
+static gboolean
+delete_flush_timeout (AsyncData *data)
+{
+	data->flush_id = 0;
+
+	model_remove_deleted_files (data);
+	emit_delete_progress (data);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void delete_files (AsyncData *data);
+
 static void
 delete_file_finished (GFile        *file,
 		      GAsyncResult *res,
@@ -3392,46 +5571,51 @@ delete_file_finished (GFile        *file,
 	else
 		ok = g_file_delete_finish (file, res, &error);
 
+	data->running--;
+
 	if (ok)
 	{
-		/* Remove the file from the model */
-		FileBrowserNode *node = model_find_node (data->model, NULL, file);
-
-		if (node != NULL)
-			model_remove_node (data->model, node, NULL, TRUE);
-
-		/* Process the next file */
-		data->iter = data->iter->next;
+		/* Removed from the model with the others */
+		g_ptr_array_add (data->deleted, g_object_ref (file));
+		data->n_done++;
 	}
-	else if (!ok && error != NULL)
+	else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
 	{
-		gint code = error->code;
-		g_error_free (error);
-
-		if (data->trash && code == G_IO_ERROR_NOT_SUPPORTED)
+		/* The job has been cancelled, it ends with the last file */
+	}
+	else if (data->trash && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+	{
+		/* Trash is not supported for this file, the user is asked
+		 * once the others are done if it should be deleted instead
+		 */
+		data->no_trash = g_list_prepend (data->no_trash, g_object_ref (file));
+	}
+	else
+	{
+		/* The errors are reported together once the job is done */
+		if (data->n_errors < DELETE_MAX_ERRORS)
 		{
-			/* Trash is not supported on this system. Ask the user
-			 * if he wants to delete completely the files instead.
-			 */
-			if (emit_no_trash (data))
-			{
-				/* Changes this into a delete job */
-				data->trash = FALSE;
-				data->iter = data->files;
-			}
-			else
-			{
-				/* End the job */
-				async_data_free (data);
-				return;
-			}
+			gchar *name = gedit_file_browser_utils_file_basename (file);
+
+			g_string_append_printf (data->errors, "%s%s: %s",
+						data->errors->len > 0 ? "\n" : "",
+						name,
+						error->message);
+			g_free (name);
 		}
-		else if (code == G_IO_ERROR_CANCELLED)
-		{
-			/* Job has been cancelled, end the job */
+
+		data->n_errors++;
+		data->n_done++;
+	}
+
+	g_clear_error (&error);
+
+	if (g_cancellable_is_cancelled (data->cancellable))
+	{
+		if (data->running == 0)
 			async_data_free (data);
-			return;
-		}
+
+		return;
 	}
 
 	/* Continue the job */
@@ -3439,18 +5623,10 @@ delete_file_finished (GFile        *file,
 }
 
 static void
-delete_files (AsyncData *data)
+delete_file (AsyncData *data,
+	     GFile     *file)
 {
-	GFile *file;
-
-	/* Check if our job is done */
-	if (data->iter == NULL)
-	{
-		async_data_free (data);
-		return;
-	}
-
-	file = G_FILE (data->iter->data);
+	data->running++;
 
 	if (data->trash)
 	{
@@ -3470,6 +5646,76 @@ delete_files (AsyncData *data)
 	}
 }
 
+static void
+delete_files (AsyncData *data)
+{
+	/* Start the next files */
+	while (data->iter != NULL && data->running < DELETE_MAX_RUNNING)
+	{
+		delete_file (data, G_FILE (data->iter->data));
+		data->iter = data->iter->next;
+	}
+
+	if (data->running > 0)
+	{
+		if (data->deleted->len > 0 && data->flush_id == 0)
+		{
+			data->flush_id = g_timeout_add (DELETE_FLUSH_INTERVAL,
+							(GSourceFunc)delete_flush_timeout,
+							data);
+		}
+
+		return;
+	}
+
+	/* All the files are done */
+	model_remove_deleted_files (data);
+
+	if (data->no_trash != NULL)
+	{
+		data->no_trash = g_list_reverse (data->no_trash);
+
+		if (emit_no_trash (data))
+		{
+			/* Changes this into a delete job for these files */
+			g_list_free_full (data->files, g_object_unref);
+
+			data->files = data->no_trash;
+			data->iter = data->files;
+			data->no_trash = NULL;
+			data->trash = FALSE;
+
+			delete_files (data);
+			return;
+		}
+
+		/* Left as they are */
+		data->n_done = data->n_files;
+	}
+
+	if (data->n_errors > DELETE_MAX_ERRORS)
+	{
+		g_string_append_c (data->errors, '\n');
+		g_string_append_printf (data->errors,
+					ngettext ("And %d other file",
+						  "And %d other files",
+						  data->n_errors - DELETE_MAX_ERRORS),
+					data->n_errors - DELETE_MAX_ERRORS);
+	}
+
+	if (data->n_errors > 0)
+	{
+		g_signal_emit (data->model,
+			       model_signals[ERROR],
+			       0,
+			       GEDIT_FILE_BROWSER_ERROR_DELETE,
+			       data->errors->str);
+	}
+
+	emit_delete_progress (data);
+	async_data_free (data);
+}
+
 GeditFileBrowserStoreResult
 gedit_file_browser_store_delete_all (GeditFileBrowserStore *model,
 				     GList                 *rows,
@@ -3507,22 +5753,29 @@ gedit_file_browser_store_delete_all (GeditFileBrowserStore *model,
 
 		prev = path;
 		node = (FileBrowserNode *)(iter.user_data);
-		files = g_list_prepend (files, g_object_ref (node->file));
+		files = g_list_prepend (files, node_get_file (node));
 	}
 
-	data = g_slice_new (AsyncData);
+	g_list_free (rows);
+
+	if (files == NULL)
+		return GEDIT_FILE_BROWSER_STORE_RESULT_NO_CHANGE;
+
+	data = g_slice_new0 (AsyncData);
 
 	data->model = model;
 	data->cancellable = g_cancellable_new ();
-	data->files = files;
+	data->files = g_list_reverse (files);
 	data->trash = trash;
-	data->iter = files;
-	data->removed = FALSE;
+	data->iter = data->files;
+	data->n_files = g_list_length (data->files);
+	data->deleted = g_ptr_array_new_with_free_func (g_object_unref);
+	data->errors = g_string_new (NULL);
 
 	model->priv->async_handles = g_slist_prepend (model->priv->async_handles, data);
 
+	emit_delete_progress (data);
 	delete_files (data);
-	g_list_free (rows);
 
 	return GEDIT_FILE_BROWSER_STORE_RESULT_OK;
 }
@@ -3573,7 +5826,7 @@ gedit_file_browser_store_new_file (GeditFileBrowserStore *model,
 
 	parent_node = FILE_BROWSER_NODE_DIR (parent->user_data);
 	/* Translators: This is the default name of new files created by the file browser pane. */
-	file = unique_new_name (((FileBrowserNode *) parent_node)->file, _("Untitled File"));
+	file = unique_new_name (parent_node->file, _("Untitled File"));
 
 	stream = g_file_create (file, G_FILE_CREATE_NONE, NULL, &error);
 
@@ -3630,7 +5883,7 @@ gedit_file_browser_store_new_directory (GeditFileBrowserStore *model,
 
 	parent_node = FILE_BROWSER_NODE_DIR (parent->user_data);
 	/* Translators: This is the default name of new directories created by the file browser pane. */
-	file = unique_new_name (((FileBrowserNode *) parent_node)->file, _("Untitled Folder"));
+	file = unique_new_name (parent_node->file, _("Untitled Folder"));
 
 	if (!g_file_make_directory (file, NULL, &error))
 	{
@@ -70,7 +70,8 @@ typedef enum
 {
 	GEDIT_FILE_BROWSER_STORE_FILTER_MODE_NONE        = 0,
 	GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_HIDDEN = 1 << 0,
-	GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_BINARY = 1 << 1
+	GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_BINARY = 1 << 1,
+	GEDIT_FILE_BROWSER_STORE_FILTER_MODE_DEEP        = 1 << 2
 } GeditFileBrowserStoreFilterMode;
 
 #define FILE_IS_DIR(flags)	(flags & GEDIT_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY)
@@ -117,6 +118,11 @@ struct _GeditFileBrowserStoreClass {
 	                             GFile                 *location);
 	void (* before_row_deleted) (GeditFileBrowserStore *model,
 	                             GtkTreePath           *path);
+	void (* delete_progress)    (GeditFileBrowserStore *model,
+	                             guint                  n_done,
+	                             guint                  n_files);
+	void (* deep_filter_match)  (GeditFileBrowserStore *model,
+	                             GtkTreeIter           *iter);
 };
 
 GType                            gedit_file_browser_store_get_type                       (void) G_GNUC_CONST;
@@ -148,8 +154,12 @@ void                             gedit_file_browser_store_set_value
                                                                                           GValue                           *value);
 void                             _gedit_file_browser_store_iter_expanded                 (GeditFileBrowserStore            *model,
                                                                                           GtkTreeIter                      *iter);
+void                             _gedit_file_browser_store_iter_resolve                  (GeditFileBrowserStore            *model,
+                                                                                          GtkTreeIter                      *iter);
 void                             _gedit_file_browser_store_iter_collapsed                (GeditFileBrowserStore            *model,
                                                                                           GtkTreeIter                      *iter);
+void                             _gedit_file_browser_store_prefetch                      (GeditFileBrowserStore            *model,
+                                                                                          GList                            *locations);
 GeditFileBrowserStoreFilterMode  gedit_file_browser_store_get_filter_mode                (GeditFileBrowserStore            *model);
 void                             gedit_file_browser_store_set_filter_mode                (GeditFileBrowserStore            *model,
                                                                                           GeditFileBrowserStoreFilterMode   mode);
@@ -159,6 +169,9 @@ void                             gedit_file_browser_store_set_filter_func
 const gchar * const             *gedit_file_browser_store_get_binary_patterns            (GeditFileBrowserStore            *model);
 void                             gedit_file_browser_store_set_binary_patterns            (GeditFileBrowserStore            *model,
                                                                                           const gchar                     **binary_patterns);
+const gchar                     *gedit_file_browser_store_get_filter_pattern             (GeditFileBrowserStore            *model);
+void                             gedit_file_browser_store_set_filter_pattern             (GeditFileBrowserStore            *model,
+                                                                                          const gchar                      *pattern);
 void                             gedit_file_browser_store_refilter                       (GeditFileBrowserStore            *model);
 GeditFileBrowserStoreFilterMode  gedit_file_browser_store_filter_mode_get_default        (void);
 void                             gedit_file_browser_store_refresh                        (GeditFileBrowserStore            *model);
@@ -104,6 +104,178 @@ gedit_file_browser_utils_pixbuf_from_icon (GIcon       *icon,
 	return ret;
 }
 
+/*
+ * The icons of the rows of the file browser are shared by all the rows
+ * showing the same icon with the same emblem, in all the windows. The
+ * cache is emptied when the icon theme changes, the rows keeping the
+ * icons they have until they are composited again.
+ *
+ * The emblems are not referenced by the keys, the icons composited with an
+ * emblem are removed when the emblem is finalized.
+ */
+typedef struct
+{
+	GIcon       *icon;
+	GdkPixbuf   *emblem;
+	GtkIconSize  size;
+} IconCacheKey;
+
+static GHashTable *icon_cache = NULL;
+
+/* The emblems of the keys, which are weakly referenced */
+static GHashTable *icon_cache_emblems = NULL;
+
+static guint
+icon_cache_key_hash (gconstpointer data)
+{
+	IconCacheKey const *key = data;
+
+	return (key->icon != NULL ? g_icon_hash ((gpointer)key->icon) : 0) ^
+	       g_direct_hash (key->emblem) ^
+	       key->size;
+}
+
+static gboolean
+icon_cache_key_equal (gconstpointer a,
+		      gconstpointer b)
+{
+	IconCacheKey const *key_a = a;
+	IconCacheKey const *key_b = b;
+
+	return key_a->size == key_b->size &&
+	       key_a->emblem == key_b->emblem &&
+	       g_icon_equal (key_a->icon, key_b->icon);
+}
+
+static void
+icon_cache_key_free (gpointer data)
+{
+	IconCacheKey *key = data;
+
+	g_clear_object (&key->icon);
+
+	g_slice_free (IconCacheKey, key);
+}
+
+static gboolean
+icon_cache_key_has_emblem (gpointer key,
+			   gpointer value,
+			   gpointer user_data)
+{
+	return ((IconCacheKey *)key)->emblem == user_data;
+}
+
+static void
+on_emblem_finalized (gpointer  data,
+		     GObject  *where_the_object_was)
+{
+	g_hash_table_remove (icon_cache_emblems, where_the_object_was);
+	g_hash_table_foreach_remove (icon_cache,
+				     icon_cache_key_has_emblem,
+				     where_the_object_was);
+}
+
+static void
+on_icon_theme_changed (GtkIconTheme *theme,
+		       gpointer      user_data)
+{
+	g_hash_table_remove_all (icon_cache);
+}
+
+static GdkPixbuf *
+composite_emblem (GdkPixbuf   *icon,
+		  GdkPixbuf   *emblem,
+		  GtkIconSize  size)
+{
+	GdkPixbuf *ret;
+	gint icon_size;
+
+	gtk_icon_size_lookup (size, NULL, &icon_size);
+
+	if (icon == NULL)
+	{
+		ret = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (emblem),
+				      gdk_pixbuf_get_has_alpha (emblem),
+				      gdk_pixbuf_get_bits_per_sample (emblem),
+				      icon_size,
+				      icon_size);
+	}
+	else
+	{
+		ret = gdk_pixbuf_copy (icon);
+	}
+
+	gdk_pixbuf_composite (emblem, ret,
+			      icon_size - 10, icon_size - 10, 10,
+			      10, icon_size - 10, icon_size - 10,
+			      1, 1, GDK_INTERP_NEAREST, 255);
+
+	return ret;
+}
+
+/* Returns a new reference to the pixbuf of @icon at @size, with @emblem
+ * composited in its bottom right corner when it is not NULL. When @icon is
+ * NULL or cannot be loaded, the generic text icon is used instead. */
+GdkPixbuf *
+gedit_file_browser_utils_pixbuf_from_icon_cached (GIcon       *icon,
+						  GdkPixbuf   *emblem,
+						  GtkIconSize  size)
+{
+	IconCacheKey lookup = { icon, emblem, size };
+	IconCacheKey *key;
+	GdkPixbuf *pixbuf;
+
+	if (icon_cache == NULL)
+	{
+		icon_cache = g_hash_table_new_full (icon_cache_key_hash,
+						    icon_cache_key_equal,
+						    icon_cache_key_free,
+						    g_object_unref);
+		icon_cache_emblems = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+		g_signal_connect (gtk_icon_theme_get_default (),
+				  "changed",
+				  G_CALLBACK (on_icon_theme_changed),
+				  NULL);
+	}
+
+	pixbuf = g_hash_table_lookup (icon_cache, &lookup);
+
+	if (pixbuf != NULL)
+		return g_object_ref (pixbuf);
+
+	pixbuf = gedit_file_browser_utils_pixbuf_from_icon (icon, size);
+
+	/* Fallback to the same icon as the file browser */
+	if (pixbuf == NULL)
+		pixbuf = gedit_file_browser_utils_pixbuf_from_theme ("text-x-generic", size);
+
+	if (emblem != NULL)
+	{
+		GdkPixbuf *composited = composite_emblem (pixbuf, emblem, size);
+
+		if (pixbuf != NULL)
+			g_object_unref (pixbuf);
+
+		pixbuf = composited;
+	}
+
+	if (pixbuf == NULL)
+		return NULL;
+
+	key = g_slice_new (IconCacheKey);
+	key->icon = icon != NULL ? g_object_ref (icon) : NULL;
+	key->emblem = emblem;
+	key->size = size;
+
+	if (emblem != NULL && g_hash_table_add (icon_cache_emblems, emblem))
+		g_object_weak_ref (G_OBJECT (emblem), on_emblem_finalized, NULL);
+
+	g_hash_table_insert (icon_cache, key, g_object_ref (pixbuf));
+
+	return pixbuf;
+}
+
 GdkPixbuf *
 gedit_file_browser_utils_pixbuf_from_file (GFile       *file,
                                            GtkIconSize  size,
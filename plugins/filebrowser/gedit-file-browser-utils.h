@@ -30,6 +30,9 @@ GdkPixbuf	*gedit_file_browser_utils_pixbuf_from_theme	        (gchar const    *n
 
 GdkPixbuf	*gedit_file_browser_utils_pixbuf_from_icon	        (GIcon          *icon,
 									 GtkIconSize     size);
+GdkPixbuf	*gedit_file_browser_utils_pixbuf_from_icon_cached	(GIcon          *icon,
+									 GdkPixbuf      *emblem,
+									 GtkIconSize     size);
 GdkPixbuf	*gedit_file_browser_utils_pixbuf_from_file        	(GFile          *file,
 									 GtkIconSize     size,
 									 gboolean        use_symbolic);
@@ -102,11 +102,19 @@ static void on_unload			(GeditFileBrowserStore  *model,
 					 GFile                  *location,
 					 GeditFileBrowserView   *view);
 
+static void on_virtual_root_changed	(GeditFileBrowserStore  *model,
+					 GParamSpec             *param,
+					 GeditFileBrowserView   *view);
+
 static void on_row_inserted		(GeditFileBrowserStore  *model,
 					 GtkTreePath            *path,
 					 GtkTreeIter            *iter,
 					 GeditFileBrowserView   *view);
 
+static void on_deep_filter_match	(GeditFileBrowserStore  *model,
+					 GtkTreeIter            *iter,
+					 GeditFileBrowserView   *view);
+
 static void
 gedit_file_browser_view_finalize (GObject *object)
 {
@@ -257,6 +265,58 @@ enter_notify_event (GtkWidget        *widget,
 	return GTK_WIDGET_CLASS (gedit_file_browser_view_parent_class)->enter_notify_event (widget, event);
 }
 
+/* Makes the icons of the rows shown, the other rows of the store having none
+ * until they are scrolled to */
+static void
+resolve_visible_range (GeditFileBrowserView *view)
+{
+	GtkTreeModel *model = view->priv->model;
+	GtkTreePath *start;
+	GtkTreePath *end;
+	GtkTreeIter iter;
+
+	if (!gtk_tree_view_get_visible_range (GTK_TREE_VIEW (view), &start, &end))
+		return;
+
+	while (gtk_tree_path_compare (start, end) <= 0 &&
+	       gtk_tree_model_get_iter (model, &iter, start))
+	{
+		_gedit_file_browser_store_iter_resolve (GEDIT_FILE_BROWSER_STORE (model), &iter);
+
+		if (gtk_tree_view_row_expanded (GTK_TREE_VIEW (view), start))
+		{
+			gtk_tree_path_down (start);
+			continue;
+		}
+
+		gtk_tree_path_next (start);
+
+		/* After the last child, the next row of the parent */
+		while (!gtk_tree_model_get_iter (model, &iter, start) &&
+		       gtk_tree_path_get_depth (start) > 1)
+		{
+			gtk_tree_path_up (start);
+			gtk_tree_path_next (start);
+		}
+	}
+
+	gtk_tree_path_free (start);
+	gtk_tree_path_free (end);
+}
+
+static gboolean
+draw (GtkWidget *widget,
+      cairo_t   *cr)
+{
+	GeditFileBrowserView *view = GEDIT_FILE_BROWSER_VIEW (widget);
+
+	if (GEDIT_IS_FILE_BROWSER_STORE (view->priv->model))
+		resolve_visible_range (view);
+
+	/* Chainup */
+	return GTK_WIDGET_CLASS (gedit_file_browser_view_parent_class)->draw (widget, cr);
+}
+
 static gboolean
 motion_notify_event (GtkWidget *widget,
 		     GdkEventMotion *event)
@@ -748,6 +808,7 @@ uninstall_restore_signals (GeditFileBrowserView *tree_view,
 	g_signal_handlers_disconnect_by_func (model, on_begin_refresh, tree_view);
 	g_signal_handlers_disconnect_by_func (model, on_end_refresh, tree_view);
 	g_signal_handlers_disconnect_by_func (model, on_unload, tree_view);
+	g_signal_handlers_disconnect_by_func (model, on_virtual_root_changed, tree_view);
 	g_signal_handlers_disconnect_by_func (model, on_row_inserted, tree_view);
 }
 
@@ -758,6 +819,7 @@ install_restore_signals (GeditFileBrowserView *tree_view,
 	g_signal_connect (model, "begin-refresh", G_CALLBACK (on_begin_refresh), tree_view);
 	g_signal_connect (model, "end-refresh", G_CALLBACK (on_end_refresh), tree_view);
 	g_signal_connect (model, "unload", G_CALLBACK (on_unload), tree_view);
+	g_signal_connect (model, "notify::virtual-root", G_CALLBACK (on_virtual_root_changed), tree_view);
 	g_signal_connect_after (model, "row-inserted", G_CALLBACK (on_row_inserted), tree_view);
 }
 
@@ -851,6 +913,7 @@ gedit_file_browser_view_class_init (GeditFileBrowserViewClass *klass)
 	object_class->set_property = set_property;
 
 	/* Event handlers */
+	widget_class->draw = draw;
 	widget_class->motion_notify_event = motion_notify_event;
 	widget_class->enter_notify_event = enter_notify_event;
 	widget_class->leave_notify_event = leave_notify_event;
@@ -982,6 +1045,9 @@ icon_renderer_cb (GtkTreeViewColumn    *tree_column,
 static void
 gedit_file_browser_view_init (GeditFileBrowserView *obj)
 {
+	gint width, height;
+	gint xpad, ypad;
+
 	obj->priv = gedit_file_browser_view_get_instance_private (obj);
 
 	obj->priv->column = gtk_tree_view_column_new ();
@@ -991,6 +1057,14 @@ gedit_file_browser_view_init (GeditFileBrowserView *obj)
 					 obj->priv->pixbuf_renderer,
 					 FALSE);
 
+	/* The rows keep their height when their icon is made, after they
+	 * were measured */
+	gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, &width, &height);
+	gtk_cell_renderer_get_padding (obj->priv->pixbuf_renderer, &xpad, &ypad);
+	gtk_cell_renderer_set_fixed_size (obj->priv->pixbuf_renderer,
+					  width + 2 * xpad,
+					  height + 2 * ypad);
+
 	gtk_tree_view_column_set_cell_data_func (obj->priv->column,
 						 obj->priv->pixbuf_renderer,
 						 (GtkTreeCellDataFunc)icon_renderer_cb,
@@ -1078,6 +1152,11 @@ gedit_file_browser_view_set_model (GeditFileBrowserView *tree_view,
 		if (tree_view->priv->restore_expand_state)
 			install_restore_signals (tree_view, model);
 
+		g_signal_connect_object (model,
+					 "deep-filter-match",
+					 G_CALLBACK (on_deep_filter_match),
+					 tree_view,
+					 0);
 	}
 
 	if (tree_view->priv->hover_path != NULL)
@@ -1086,10 +1165,14 @@ gedit_file_browser_view_set_model (GeditFileBrowserView *tree_view,
 		tree_view->priv->hover_path = NULL;
 	}
 
-	if (GEDIT_IS_FILE_BROWSER_STORE (tree_view->priv->model) &&
-	    tree_view->priv->restore_expand_state)
+	if (GEDIT_IS_FILE_BROWSER_STORE (tree_view->priv->model))
 	{
-		uninstall_restore_signals (tree_view, tree_view->priv->model);
+		if (tree_view->priv->restore_expand_state)
+			uninstall_restore_signals (tree_view, tree_view->priv->model);
+
+		g_signal_handlers_disconnect_by_func (tree_view->priv->model,
+						      on_deep_filter_match,
+						      tree_view);
 	}
 
 	tree_view->priv->model = model;
@@ -1236,6 +1319,22 @@ on_cell_edited (GtkCellRendererText  *cell,
 	tree_view->priv->editable = NULL;
 }
 
+/* Lists the expanded directories together before the tree is loaded again,
+ * instead of one level at a time as each one is expanded */
+static void
+prefetch_expand_state (GeditFileBrowserView  *view,
+		       GeditFileBrowserStore *model)
+{
+	GList *locations;
+
+	if (view->priv->expand_state == NULL)
+		return;
+
+	locations = g_hash_table_get_keys (view->priv->expand_state);
+	_gedit_file_browser_store_prefetch (model, locations);
+	g_list_free (locations);
+}
+
 static void
 on_begin_refresh (GeditFileBrowserStore *model,
 		  GeditFileBrowserView  *view)
@@ -1243,6 +1342,16 @@ on_begin_refresh (GeditFileBrowserStore *model,
 	/* Store the refresh state, so we can handle unloading of nodes while
 	   refreshing properly */
 	view->priv->is_refresh = TRUE;
+
+	prefetch_expand_state (view, model);
+}
+
+static void
+on_virtual_root_changed (GeditFileBrowserStore *model,
+			 GParamSpec            *param,
+			 GeditFileBrowserView  *view)
+{
+	prefetch_expand_state (view, model);
 }
 
 static void
@@ -1314,6 +1423,23 @@ on_row_inserted (GeditFileBrowserStore *model,
 	gtk_tree_path_free (copy);
 }
 
+/* Shows the files found by the deep filter in the directory of @iter */
+static void
+on_deep_filter_match (GeditFileBrowserStore *model,
+		      GtkTreeIter           *iter,
+		      GeditFileBrowserView  *view)
+{
+	GtkTreePath *path;
+
+	path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), iter);
+
+	if (path != NULL)
+	{
+		gtk_tree_view_expand_to_path (GTK_TREE_VIEW (view), path);
+		gtk_tree_path_free (path);
+	}
+}
+
 void
 _gedit_file_browser_view_register_type (GTypeModule *type_module)
 {
@@ -141,8 +141,6 @@ struct _GeditFileBrowserWidgetPrivate
 
 	GSList                  *filter_funcs;
 	gulong                   filter_id;
-	gulong                   glob_filter_id;
-	GPatternSpec            *filter_pattern;
 	gchar                   *filter_pattern_str;
 
 	GList                   *locations;
@@ -155,6 +153,11 @@ struct _GeditFileBrowserWidgetPrivate
 	GCancellable            *cancellable;
 
 	GdkCursor               *busy_cursor;
+
+	/* The busy cursor is shown while a directory loads, or while any
+	 * of the busy_count operations (mounts, deletions) runs */
+	gboolean                 loading;
+	guint                    busy_count;
 };
 
 static void on_model_set                       (GObject                *gobject,
@@ -171,6 +174,10 @@ static void on_file_store_error                (GeditFileBrowserStore  *store,
 static gboolean on_file_store_no_trash 	       (GeditFileBrowserStore  *store,
 						GList                  *files,
 						GeditFileBrowserWidget *obj);
+static void on_file_store_delete_progress      (GeditFileBrowserStore  *store,
+						guint                   n_done,
+						guint                   n_files,
+						GeditFileBrowserWidget *obj);
 static gboolean on_location_button_press_event (GtkWidget              *button,
 						GdkEventButton         *event,
 						GeditFileBrowserWidget *obj);
@@ -257,6 +264,9 @@ static void change_show_binary_state           (GSimpleAction          *action,
 static void change_show_match_filename         (GSimpleAction          *action,
                                                 GVariant               *state,
                                                 gpointer                user_data);
+static void change_deep_filter_state           (GSimpleAction          *action,
+                                                GVariant               *state,
+                                                gpointer                user_data);
 static void open_in_terminal_activated         (GSimpleAction          *action,
                                                 GVariant               *parameter,
                                                 gpointer                user_data);
@@ -842,15 +852,25 @@ init_bookmarks_hash (GeditFileBrowserWidget *obj)
 }
 
 static void
-on_begin_loading (GeditFileBrowserStore  *model,
-		  GtkTreeIter            *iter,
-		  GeditFileBrowserWidget *obj)
+update_busy_cursor (GeditFileBrowserWidget *obj)
 {
-	if (!GDK_IS_WINDOW (gtk_widget_get_window (GTK_WIDGET (obj->priv->treeview))))
+	GeditFileBrowserWidgetPrivate *priv = obj->priv;
+	gboolean busy = priv->loading || priv->busy_count > 0;
+
+	if (!GDK_IS_WINDOW (gtk_widget_get_window (GTK_WIDGET (priv->treeview))))
 		return;
 
 	gdk_window_set_cursor (gtk_widget_get_window (GTK_WIDGET (obj)),
-			       obj->priv->busy_cursor);
+			       busy ? priv->busy_cursor : NULL);
+}
+
+static void
+on_begin_loading (GeditFileBrowserStore  *model,
+		  GtkTreeIter            *iter,
+		  GeditFileBrowserWidget *obj)
+{
+	obj->priv->loading = TRUE;
+	update_busy_cursor (obj);
 }
 
 static void
@@ -858,10 +878,8 @@ on_end_loading (GeditFileBrowserStore  *model,
 		GtkTreeIter            *iter,
 		GeditFileBrowserWidget *obj)
 {
-	if (!GDK_IS_WINDOW (gtk_widget_get_window (GTK_WIDGET (obj->priv->treeview))))
-		return;
-
-	gdk_window_set_cursor (gtk_widget_get_window (GTK_WIDGET (obj)), NULL);
+	obj->priv->loading = FALSE;
+	update_busy_cursor (obj);
 }
 
 static void
@@ -914,6 +932,7 @@ static GActionEntry browser_entries[] = {
 	{ "show_hidden", NULL, NULL, "false", change_show_hidden_state },
 	{ "show_binary", NULL, NULL, "false", change_show_binary_state },
 	{ "show_match_filename", NULL, NULL, "false", change_show_match_filename },
+	{ "deep_filter", NULL, NULL, "false", change_deep_filter_state },
 	{ "previous_location", previous_location_activated },
 	{ "next_location", next_location_activated },
 	{ "up", up_activated },
@@ -1070,6 +1089,9 @@ gedit_file_browser_widget_init (GeditFileBrowserWidget *obj)
 	g_signal_connect (obj->priv->file_store, "error",
 			  G_CALLBACK (on_file_store_error), obj);
 
+	g_signal_connect (obj->priv->file_store, "delete-progress",
+			  G_CALLBACK (on_file_store_delete_progress), obj);
+
 	init_bookmarks_hash (obj);
 
 	/* filter */
@@ -1120,6 +1142,10 @@ update_sensitivity (GeditFileBrowserWidget *obj)
 		action = g_action_map_lookup_action (G_ACTION_MAP (obj->priv->action_group),
 		                                     "show_match_filename");
 		g_simple_action_set_enabled (G_SIMPLE_ACTION (action), TRUE);
+
+		action = g_action_map_lookup_action (G_ACTION_MAP (obj->priv->action_group),
+		                                     "deep_filter");
+		g_simple_action_set_enabled (G_SIMPLE_ACTION (action), TRUE);
 	}
 	else if (GEDIT_IS_FILE_BOOKMARKS_STORE (model))
 	{
@@ -1148,6 +1174,10 @@ update_sensitivity (GeditFileBrowserWidget *obj)
 		action = g_action_map_lookup_action (G_ACTION_MAP (obj->priv->action_group),
 		                                     "show_match_filename");
 		g_simple_action_set_enabled (G_SIMPLE_ACTION (action), FALSE);
+
+		action = g_action_map_lookup_action (G_ACTION_MAP (obj->priv->action_group),
+		                                     "deep_filter");
+		g_simple_action_set_enabled (G_SIMPLE_ACTION (action), FALSE);
 	}
 
 	on_selection_changed (gtk_tree_view_get_selection
@@ -1237,33 +1267,6 @@ popup_menu (GeditFileBrowserWidget *obj,
 	return TRUE;
 }
 
-static gboolean
-filter_glob (GeditFileBrowserWidget *obj,
-	     GeditFileBrowserStore  *store,
-	     GtkTreeIter            *iter,
-	     gpointer                user_data)
-{
-	gchar *name;
-	gboolean result;
-	guint flags;
-
-	if (obj->priv->filter_pattern == NULL)
-		return TRUE;
-
-	gtk_tree_model_get (GTK_TREE_MODEL (store), iter,
-			    GEDIT_FILE_BROWSER_STORE_COLUMN_NAME, &name,
-			    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
-			    -1);
-
-	if (FILE_IS_DIR (flags) || FILE_IS_DUMMY (flags))
-		result = TRUE;
-	else
-		result = g_pattern_match_string (obj->priv->filter_pattern, name);
-
-	g_free (name);
-	return result;
-}
-
 static void
 rename_selected_file (GeditFileBrowserWidget *obj)
 {
@@ -1574,8 +1577,6 @@ set_filter_pattern_real (GeditFileBrowserWidget *obj,
                         gchar const             *pattern,
                         gboolean                 update_entry)
 {
-	GtkTreeModel *model = gtk_tree_view_get_model (GTK_TREE_VIEW (obj->priv->treeview));
-
 	if (pattern != NULL && *pattern == '\0')
 		pattern = NULL;
 
@@ -1593,36 +1594,11 @@ set_filter_pattern_real (GeditFileBrowserWidget *obj,
 	else
 		obj->priv->filter_pattern_str = g_strdup (pattern);
 
-	if (obj->priv->filter_pattern)
-	{
-		g_pattern_spec_free (obj->priv->filter_pattern);
-		obj->priv->filter_pattern = NULL;
-	}
-
-	if (pattern == NULL)
-	{
-		if (obj->priv->glob_filter_id != 0)
-		{
-			gedit_file_browser_widget_remove_filter (obj, obj->priv->glob_filter_id);
-			obj->priv->glob_filter_id = 0;
-		}
-	}
-	else
-	{
-		obj->priv->filter_pattern = g_pattern_spec_new (pattern);
-
-		if (obj->priv->glob_filter_id == 0)
-			obj->priv->glob_filter_id = gedit_file_browser_widget_add_filter (obj,
-											  filter_glob,
-											  NULL,
-											  NULL);
-	}
-
 	if (update_entry)
 		gtk_entry_set_text (GTK_ENTRY (obj->priv->filter_entry), obj->priv->filter_pattern_str);
 
-	if (GEDIT_IS_FILE_BROWSER_STORE (model))
-		gedit_file_browser_store_refilter (GEDIT_FILE_BROWSER_STORE (model));
+	/* The pattern is matched by the store, on the files only */
+	gedit_file_browser_store_set_filter_pattern (obj->priv->file_store, pattern);
 
 	g_object_notify (G_OBJECT (obj), "filter-pattern");
 }
@@ -1917,27 +1893,18 @@ async_free (AsyncData *async)
 	g_slice_free (AsyncData, async);
 }
 
+/* Each set_busy (obj, TRUE) is balanced by a set_busy (obj, FALSE), the
+ * busy cursor is shown until the last operation ends */
 static void
 set_busy (GeditFileBrowserWidget *obj,
 	  gboolean                busy)
 {
-	GdkWindow *window = gtk_widget_get_window (GTK_WIDGET (obj->priv->treeview));
-
-	if (!GDK_IS_WINDOW (window))
-		return;
-
 	if (busy)
-	{
-		GdkDisplay *display = gtk_widget_get_display (GTK_WIDGET (obj));
-		GdkCursor *cursor= gdk_cursor_new_from_name (display, "progress");
+		obj->priv->busy_count++;
+	else if (obj->priv->busy_count > 0)
+		obj->priv->busy_count--;
 
-		gdk_window_set_cursor (window, cursor);
-		g_clear_object (&cursor);
-	}
-	else
-	{
-		gdk_window_set_cursor (window, NULL);
-	}
+	update_busy_cursor (obj);
 }
 
 static void try_mount_volume (GeditFileBrowserWidget *widget, GVolume *volume);
@@ -2501,6 +2468,20 @@ on_file_store_error (GeditFileBrowserStore  *store,
 	g_signal_emit (obj, signals[ERROR], 0, code, message);
 }
 
+static void
+on_file_store_delete_progress (GeditFileBrowserStore  *store,
+			       guint                   n_done,
+			       guint                   n_files,
+			       GeditFileBrowserWidget *obj)
+{
+	/* A deletion is reported first with no file done, and last with
+	 * all of them done */
+	if (n_done == 0)
+		set_busy (obj, TRUE);
+	else if (n_done == n_files)
+		set_busy (obj, FALSE);
+}
+
 static void
 on_treeview_error (GeditFileBrowserView   *tree_view,
 		   guint                   code,
@@ -2871,6 +2852,15 @@ on_filter_mode_changed (GeditFileBrowserStore  *model,
 		g_action_change_state (action, g_variant_new_boolean (active));
 
 	g_variant_unref (variant);
+
+	action = g_action_map_lookup_action (G_ACTION_MAP (obj->priv->action_group), "deep_filter");
+	active = (mode & GEDIT_FILE_BROWSER_STORE_FILTER_MODE_DEEP) != 0;
+	variant = g_action_get_state (action);
+
+	if (active != g_variant_get_boolean (variant))
+		g_action_change_state (action, g_variant_new_boolean (active));
+
+	g_variant_unref (variant);
 }
 
 static void
@@ -3108,6 +3098,28 @@ change_show_match_filename (GSimpleAction *action,
 	g_simple_action_set_state (action, state);
 }
 
+static void
+change_deep_filter_state (GSimpleAction *action,
+                          GVariant      *state,
+                          gpointer       user_data)
+{
+	GeditFileBrowserWidget *widget = GEDIT_FILE_BROWSER_WIDGET (user_data);
+	GeditFileBrowserStoreFilterMode mode;
+
+	/* The files matching the filter pattern are searched in the folders
+	   which are not loaded yet */
+	mode = gedit_file_browser_store_get_filter_mode (widget->priv->file_store);
+
+	if (g_variant_get_boolean (state))
+		mode |= GEDIT_FILE_BROWSER_STORE_FILTER_MODE_DEEP;
+	else
+		mode &= ~GEDIT_FILE_BROWSER_STORE_FILTER_MODE_DEEP;
+
+	gedit_file_browser_store_set_filter_mode (widget->priv->file_store, mode);
+
+	g_simple_action_set_state (action, state);
+}
+
 static void
 open_in_terminal_activated (GSimpleAction *action,
                             GVariant      *parameter,
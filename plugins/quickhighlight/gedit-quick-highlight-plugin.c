@@ -29,6 +29,24 @@
 
 #include "gedit-quick-highlight-plugin.h"
 
+/* The matches in the visible region are highlighted right away. The rest of
+ * the buffer is filled in idle time slices, first after the visible region,
+ * then from the start of the buffer up to the visible region. On huge
+ * documents only the first MAX_BACKGROUND_MATCHES are highlighted in the
+ * background; the visible region is always highlighted when scrolling.
+ */
+
+/* In microseconds. */
+#define FILL_TIME_SLICE 5000
+
+/* The size of the regions searched between two deadline checks. */
+#define SEARCH_CHUNK_CHARS 32768
+
+#define MAX_BACKGROUND_MATCHES 10000
+
+/* Bigger selections are not highlighted. */
+#define MAX_SEARCH_TEXT_CHARS 1024
+
 struct _GeditQuickHighlightPluginPrivate
 {
 	GeditView              *view;
@@ -36,15 +54,38 @@ struct _GeditQuickHighlightPluginPrivate
 	GeditDocument          *buffer;
 	GtkTextMark            *insert_mark;
 
-	GtkSourceSearchContext *search_context;
 	GtkSourceStyle         *style;
+	GtkTextTag             *tag;
+
+	/* The text currently highlighted, NULL if none. */
+	gchar                  *search_text;
+	gint                    search_text_n_chars;
+
+	/* The region that the background fill is scanning, and where it
+	 * stops after having wrapped around.
+	 */
+	GtkTextMark            *fill_mark;
+	GtkTextMark            *fill_end_mark;
+	GtkTextMark            *fill_wrap_mark;
+	guint                   fill_wrapped : 1;
+
+	/* The buffer has been modified, the highlighted matches may be
+	 * outdated.
+	 */
+	guint                   needs_refresh : 1;
+	guint                   n_background_matches;
+
+	GtkAdjustment          *vadjustment;
 
 	gulong                  buffer_handler_id;
 	gulong                  mark_set_handler_id;
 	gulong                  delete_range_handler_id;
+	gulong                  insert_text_handler_id;
 	gulong                  style_scheme_handler_id;
+	gulong                  vadjustment_handler_id;
 
 	guint                   queued_highlight;
+	guint                   fill_idle_id;
 };
 
 enum
@@ -66,8 +107,64 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditQuickHighlightPlugin,
 static void gedit_quick_highlight_plugin_notify_buffer_cb (GObject *object, GParamSpec *pspec, gpointer user_data);
 static void gedit_quick_highlight_plugin_mark_set_cb (GtkTextBuffer *textbuffer, GtkTextIter *location, GtkTextMark *mark, gpointer user_data);
 static void gedit_quick_highlight_plugin_delete_range_cb (GtkTextBuffer *textbuffer, GtkTextIter *start, GtkTextIter *end, gpointer user_data);
+static void gedit_quick_highlight_plugin_insert_text_cb (GtkTextBuffer *textbuffer, GtkTextIter *location, gchar *text, gint len, gpointer user_data);
 static void gedit_quick_highlight_plugin_notify_style_scheme_cb (GObject *object, GParamSpec *pspec, gpointer user_data);
 
+static void
+gedit_quick_highlight_plugin_stop_fill (GeditQuickHighlightPlugin *plugin)
+{
+	if (plugin->priv->fill_idle_id != 0)
+	{
+		g_source_remove (plugin->priv->fill_idle_id);
+		plugin->priv->fill_idle_id = 0;
+	}
+}
+
+static void
+gedit_quick_highlight_plugin_clear (GeditQuickHighlightPlugin *plugin)
+{
+	GtkTextIter start, end;
+
+	gedit_quick_highlight_plugin_stop_fill (plugin);
+
+	if (plugin->priv->search_text == NULL)
+	{
+		return;
+	}
+
+	g_clear_pointer (&plugin->priv->search_text, g_free);
+
+	if (plugin->priv->buffer != NULL && plugin->priv->tag != NULL)
+	{
+		gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (plugin->priv->buffer), &start, &end);
+		gtk_text_buffer_remove_tag (GTK_TEXT_BUFFER (plugin->priv->buffer),
+		                            plugin->priv->tag,
+		                            &start,
+		                            &end);
+	}
+}
+
+static void
+gedit_quick_highlight_plugin_remove_tag (GeditQuickHighlightPlugin *plugin)
+{
+	GtkTextTagTable *tag_table;
+
+	if (plugin->priv->tag == NULL)
+	{
+		return;
+	}
+
+	gedit_quick_highlight_plugin_clear (plugin);
+
+	if (plugin->priv->buffer != NULL)
+	{
+		tag_table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (plugin->priv->buffer));
+		gtk_text_tag_table_remove (tag_table, plugin->priv->tag);
+	}
+
+	g_clear_object (&plugin->priv->tag);
+}
+
 static void
 gedit_quick_highlight_plugin_load_style (GeditQuickHighlightPlugin *plugin)
 {
@@ -91,71 +188,331 @@ gedit_quick_highlight_plugin_load_style (GeditQuickHighlightPlugin *plugin)
 	{
 		style = gtk_source_style_scheme_get_style (style_scheme, "quick-highlight-match");
 
+		/* Like GtkSourceSearchContext without a match style. */
+		if (style == NULL)
+		{
+			style = gtk_source_style_scheme_get_style (style_scheme, "search-match");
+		}
+
 		if (style != NULL)
 		{
 			plugin->priv->style = gtk_source_style_copy (style);
 		}
 	}
+
+	/* The properties not set by the new style would be kept by the old
+	 * tag, so the tag is recreated.
+	 */
+	gedit_quick_highlight_plugin_remove_tag (plugin);
+}
+
+static GtkTextTag *
+gedit_quick_highlight_plugin_get_tag (GeditQuickHighlightPlugin *plugin)
+{
+	if (plugin->priv->tag == NULL)
+	{
+		plugin->priv->tag = gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (plugin->priv->buffer),
+		                                                NULL,
+		                                                NULL);
+		g_object_ref (plugin->priv->tag);
+
+		if (plugin->priv->style != NULL)
+		{
+			gtk_source_style_apply (plugin->priv->style, plugin->priv->tag);
+		}
+	}
+
+	return plugin->priv->tag;
+}
+
+static GtkTextMark *
+gedit_quick_highlight_plugin_move_mark (GeditQuickHighlightPlugin *plugin,
+                                        GtkTextMark               *mark,
+                                        const GtkTextIter         *iter)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (plugin->priv->buffer);
+
+	if (mark == NULL)
+	{
+		return gtk_text_buffer_create_mark (buffer, NULL, iter, TRUE);
+	}
+
+	gtk_text_buffer_move_mark (buffer, mark, iter);
+	return mark;
+}
+
+/*
+ * Highlights the matches between @iter and @limit, searching chunk by chunk
+ * so that @deadline (0 for none) is checked regularly, and stops after
+ * @max_matches. Returns whether @limit has been reached; otherwise @iter is
+ * where to continue.
+ */
+static gboolean
+gedit_quick_highlight_plugin_highlight_range (GeditQuickHighlightPlugin *plugin,
+                                              GtkTextIter               *iter,
+                                              const GtkTextIter         *limit,
+                                              gint64                     deadline,
+                                              guint                      max_matches,
+                                              guint                     *n_matches)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (plugin->priv->buffer);
+	GtkTextTag *tag = gedit_quick_highlight_plugin_get_tag (plugin);
+	gint overlap = MAX (plugin->priv->search_text_n_chars - 1, 0);
+
+	while (gtk_text_iter_compare (iter, limit) < 0)
+	{
+		GtkTextIter chunk_limit = *iter;
+		GtkTextIter match_start, match_end;
+		GtkTextIter next;
+
+		gtk_text_iter_forward_chars (&chunk_limit,
+		                             MAX (SEARCH_CHUNK_CHARS, 2 * plugin->priv->search_text_n_chars));
+
+		if (gtk_text_iter_compare (&chunk_limit, limit) > 0)
+		{
+			chunk_limit = *limit;
+		}
+
+		while (gtk_text_iter_forward_search (iter,
+		                                     plugin->priv->search_text,
+		                                     GTK_TEXT_SEARCH_TEXT_ONLY,
+		                                     &match_start,
+		                                     &match_end,
+		                                     &chunk_limit))
+		{
+			gtk_text_buffer_apply_tag (buffer, tag, &match_start, &match_end);
+			*iter = match_end;
+
+			if (++(*n_matches) >= max_matches)
+			{
+				return FALSE;
+			}
+		}
+
+		if (gtk_text_iter_equal (&chunk_limit, limit))
+		{
+			break;
+		}
+
+		/* A match can straddle the chunk limit. Matches found in the
+		 * chunk end before it, so they can't be found twice.
+		 */
+		next = chunk_limit;
+		gtk_text_iter_backward_chars (&next, overlap);
+
+		if (gtk_text_iter_compare (&next, iter) > 0)
+		{
+			*iter = next;
+		}
+
+		if (deadline > 0 && g_get_monotonic_time () >= deadline)
+		{
+			return FALSE;
+		}
+	}
+
+	*iter = *limit;
+	return TRUE;
+}
+
+static void
+gedit_quick_highlight_plugin_get_visible_region (GeditQuickHighlightPlugin *plugin,
+                                                 GtkTextIter               *start,
+                                                 GtkTextIter               *end)
+{
+	GdkRectangle visible_rect;
+
+	gtk_text_view_get_visible_rect (GTK_TEXT_VIEW (plugin->priv->view), &visible_rect);
+
+	gtk_text_view_get_line_at_y (GTK_TEXT_VIEW (plugin->priv->view),
+	                             start,
+	                             visible_rect.y,
+	                             NULL);
+
+	gtk_text_view_get_line_at_y (GTK_TEXT_VIEW (plugin->priv->view),
+	                             end,
+	                             visible_rect.y + visible_rect.height,
+	                             NULL);
+
+	gtk_text_iter_forward_line (end);
+
+	/* For a multi-line search text, a match ending in the visible region
+	 * can start above it.
+	 */
+	gtk_text_iter_backward_chars (start, plugin->priv->search_text_n_chars);
+	gtk_text_iter_set_line_offset (start, 0);
+}
+
+static void
+gedit_quick_highlight_plugin_highlight_visible (GeditQuickHighlightPlugin *plugin)
+{
+	GtkTextIter start, end;
+	guint n_matches = 0;
+
+	if (plugin->priv->search_text == NULL ||
+	    plugin->priv->buffer == NULL ||
+	    plugin->priv->view == NULL)
+	{
+		return;
+	}
+
+	gedit_quick_highlight_plugin_get_visible_region (plugin, &start, &end);
+	gedit_quick_highlight_plugin_highlight_range (plugin, &start, &end, 0, G_MAXUINT, &n_matches);
+}
+
+static gboolean
+gedit_quick_highlight_plugin_fill_cb (gpointer user_data)
+{
+	GeditQuickHighlightPlugin *plugin = GEDIT_QUICK_HIGHLIGHT_PLUGIN (user_data);
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (plugin->priv->buffer);
+	GtkTextIter iter, limit;
+	gboolean done;
+
+	gtk_text_buffer_get_iter_at_mark (buffer, &iter, plugin->priv->fill_mark);
+	gtk_text_buffer_get_iter_at_mark (buffer, &limit, plugin->priv->fill_end_mark);
+
+	done = gedit_quick_highlight_plugin_highlight_range (plugin,
+	                                                     &iter,
+	                                                     &limit,
+	                                                     g_get_monotonic_time () + FILL_TIME_SLICE,
+	                                                     MAX_BACKGROUND_MATCHES,
+	                                                     &plugin->priv->n_background_matches);
+
+	if (plugin->priv->n_background_matches >= MAX_BACKGROUND_MATCHES)
+	{
+		plugin->priv->fill_idle_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	if (!done)
+	{
+		gtk_text_buffer_move_mark (buffer, plugin->priv->fill_mark, &iter);
+		return G_SOURCE_CONTINUE;
+	}
+
+	if (plugin->priv->fill_wrapped)
+	{
+		plugin->priv->fill_idle_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	/* Now from the start of the buffer to the visible region. */
+	plugin->priv->fill_wrapped = TRUE;
+
+	gtk_text_buffer_get_start_iter (buffer, &iter);
+	gtk_text_buffer_get_iter_at_mark (buffer, &limit, plugin->priv->fill_wrap_mark);
+
+	gtk_text_buffer_move_mark (buffer, plugin->priv->fill_mark, &iter);
+	gtk_text_buffer_move_mark (buffer, plugin->priv->fill_end_mark, &limit);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+gedit_quick_highlight_plugin_start_fill (GeditQuickHighlightPlugin *plugin,
+                                         const GtkTextIter         *visible_end)
+{
+	GtkTextIter start, end;
+
+	gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (plugin->priv->buffer), &end);
+
+	/* Matches straddling the end of the visible region have not been
+	 * found yet. After wrapping around, the visible region is searched
+	 * again for the same reason, it is cheap.
+	 */
+	start = *visible_end;
+	gtk_text_iter_backward_chars (&start, MAX (plugin->priv->search_text_n_chars - 1, 0));
+
+	plugin->priv->fill_mark =
+		gedit_quick_highlight_plugin_move_mark (plugin, plugin->priv->fill_mark, &start);
+	plugin->priv->fill_end_mark =
+		gedit_quick_highlight_plugin_move_mark (plugin, plugin->priv->fill_end_mark, &end);
+	plugin->priv->fill_wrap_mark =
+		gedit_quick_highlight_plugin_move_mark (plugin, plugin->priv->fill_wrap_mark, visible_end);
+
+	plugin->priv->fill_wrapped = FALSE;
+	plugin->priv->n_background_matches = 0;
+
+	plugin->priv->fill_idle_id =
+		gdk_threads_add_idle_full (G_PRIORITY_LOW,
+		                           gedit_quick_highlight_plugin_fill_cb,
+		                           plugin,
+		                           NULL);
 }
 
 static gboolean
 gedit_quick_highlight_plugin_highlight_worker (gpointer user_data)
 {
 	GeditQuickHighlightPlugin *plugin = GEDIT_QUICK_HIGHLIGHT_PLUGIN (user_data);
-	GtkSourceSearchSettings *search_settings;
 	GtkTextIter start, end;
-	g_autofree gchar *text = NULL;
+	GtkTextIter visible_start, visible_end;
+	GtkTextTagTable *tag_table;
+	guint n_matches = 0;
+	gchar *text;
 
 	g_assert (GEDIT_IS_QUICK_HIGHLIGHT_PLUGIN (plugin));
 
 	plugin->priv->queued_highlight = 0;
 
-	if (!gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (plugin->priv->buffer), &start, &end))
+	if (plugin->priv->buffer == NULL ||
+	    !gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (plugin->priv->buffer), &start, &end))
 	{
-		g_clear_object (&plugin->priv->search_context);
+		gedit_quick_highlight_plugin_clear (plugin);
 		return G_SOURCE_REMOVE;
 	}
 
-	if (gtk_text_iter_get_line (&start) != gtk_text_iter_get_line (&end))
+	if (gtk_text_iter_get_offset (&end) - gtk_text_iter_get_offset (&start) > MAX_SEARCH_TEXT_CHARS)
 	{
-		g_clear_object (&plugin->priv->search_context);
+		gedit_quick_highlight_plugin_clear (plugin);
 		return G_SOURCE_REMOVE;
 	}
 
-	if (plugin->priv->search_context == NULL)
-	{
-		search_settings =
-			g_object_new (GTK_SOURCE_TYPE_SEARCH_SETTINGS,
-			              "at-word-boundaries", FALSE,
-			              "case-sensitive", TRUE,
-			              "regex-enabled", FALSE,
-			              NULL);
+	text = gtk_text_iter_get_text (&start, &end);
 
-		plugin->priv->search_context =
-			g_object_new (GTK_SOURCE_TYPE_SEARCH_CONTEXT,
-			              "buffer", plugin->priv->buffer,
-			              "highlight", FALSE,
-			              "match-style", plugin->priv->style,
-			              "settings", search_settings,
-			              NULL);
-
-		g_object_unref (search_settings);
-	}
-	else
+	if (!plugin->priv->needs_refresh &&
+	    g_strcmp0 (text, plugin->priv->search_text) == 0)
 	{
-		search_settings =
-			gtk_source_search_context_get_settings (plugin->priv->search_context);
+		g_free (text);
+		return G_SOURCE_REMOVE;
 	}
 
-	text = gtk_text_iter_get_slice (&start, &end);
+	gedit_quick_highlight_plugin_clear (plugin);
 
-	gtk_source_search_settings_set_search_text (search_settings, text);
+	plugin->priv->needs_refresh = FALSE;
+	plugin->priv->search_text = text;
+	plugin->priv->search_text_n_chars = g_utf8_strlen (text, -1);
 
-	gtk_source_search_context_set_highlight (plugin->priv->search_context, TRUE);
+	/* Above the syntax highlighting tags, which can be added later. */
+	tag_table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (plugin->priv->buffer));
+	gtk_text_tag_set_priority (gedit_quick_highlight_plugin_get_tag (plugin),
+	                           gtk_text_tag_table_get_size (tag_table) - 1);
+
+	gedit_quick_highlight_plugin_get_visible_region (plugin, &visible_start, &visible_end);
+
+	start = visible_start;
+	gedit_quick_highlight_plugin_highlight_range (plugin,
+	                                              &start,
+	                                              &visible_end,
+	                                              0,
+	                                              G_MAXUINT,
+	                                              &n_matches);
+
+	gedit_quick_highlight_plugin_start_fill (plugin, &visible_end);
 
 	return G_SOURCE_REMOVE;
 }
 
+static void
+gedit_quick_highlight_plugin_vadjustment_value_changed_cb (GtkAdjustment *adjustment,
+                                                           gpointer       user_data)
+{
+	GeditQuickHighlightPlugin *plugin = GEDIT_QUICK_HIGHLIGHT_PLUGIN (user_data);
+
+	g_assert (GEDIT_IS_QUICK_HIGHLIGHT_PLUGIN (plugin));
+
+	gedit_quick_highlight_plugin_highlight_visible (plugin);
+}
+
 static void
 gedit_quick_highlight_plugin_queue_update (GeditQuickHighlightPlugin *plugin)
 {
@@ -181,6 +538,14 @@ gedit_quick_highlight_plugin_notify_weak_buffer_cb (gpointer data,
 
 	g_assert (GEDIT_IS_QUICK_HIGHLIGHT_PLUGIN (plugin));
 
+	gedit_quick_highlight_plugin_stop_fill (plugin);
+	g_clear_pointer (&plugin->priv->search_text, g_free);
+	g_clear_object (&plugin->priv->tag);
+
+	plugin->priv->fill_mark = NULL;
+	plugin->priv->fill_end_mark = NULL;
+	plugin->priv->fill_wrap_mark = NULL;
+
 	plugin->priv->style_scheme_handler_id = 0;
 	plugin->priv->buffer = NULL;
 }
@@ -190,11 +555,25 @@ gedit_quick_highlight_plugin_unref_weak_buffer (GeditQuickHighlightPlugin *plugi
 {
 	g_return_if_fail (GEDIT_IS_QUICK_HIGHLIGHT_PLUGIN (plugin));
 
+	gedit_quick_highlight_plugin_stop_fill (plugin);
+
 	if (plugin->priv->buffer == NULL)
 	{
 		return;
 	}
 
+	gedit_quick_highlight_plugin_remove_tag (plugin);
+
+	if (plugin->priv->fill_mark != NULL)
+	{
+		gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (plugin->priv->buffer), plugin->priv->fill_mark);
+		gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (plugin->priv->buffer), plugin->priv->fill_end_mark);
+		gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (plugin->priv->buffer), plugin->priv->fill_wrap_mark);
+		plugin->priv->fill_mark = NULL;
+		plugin->priv->fill_end_mark = NULL;
+		plugin->priv->fill_wrap_mark = NULL;
+	}
+
 	if (plugin->priv->delete_range_handler_id > 0)
 	{
 		g_signal_handler_disconnect (plugin->priv->buffer,
@@ -202,6 +581,13 @@ gedit_quick_highlight_plugin_unref_weak_buffer (GeditQuickHighlightPlugin *plugi
 		plugin->priv->delete_range_handler_id = 0;
 	}
 
+	if (plugin->priv->insert_text_handler_id > 0)
+	{
+		g_signal_handler_disconnect (plugin->priv->buffer,
+		                             plugin->priv->insert_text_handler_id);
+		plugin->priv->insert_text_handler_id = 0;
+	}
+
 	if (plugin->priv->mark_set_handler_id > 0)
 	{
 		g_signal_handler_disconnect (plugin->priv->buffer,
@@ -265,6 +651,12 @@ gedit_quick_highlight_plugin_set_buffer (GeditQuickHighlightPlugin *plugin,
 			                  G_CALLBACK (gedit_quick_highlight_plugin_delete_range_cb),
 			                  plugin);
 
+		plugin->priv->insert_text_handler_id =
+			g_signal_connect (plugin->priv->buffer,
+			                  "insert-text",
+			                  G_CALLBACK (gedit_quick_highlight_plugin_insert_text_cb),
+			                  plugin);
+
 		plugin->priv->insert_mark =
 			gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (plugin->priv->buffer));
 
@@ -302,6 +694,23 @@ gedit_quick_highlight_plugin_delete_range_cb (GtkTextBuffer *textbuffer,
 
 	g_assert (GEDIT_QUICK_HIGHLIGHT_PLUGIN (plugin));
 
+	/* The tags can't be removed here, it would invalidate the iters. */
+	plugin->priv->needs_refresh = TRUE;
+	gedit_quick_highlight_plugin_queue_update (plugin);
+}
+
+static void
+gedit_quick_highlight_plugin_insert_text_cb (GtkTextBuffer *textbuffer,
+                                             GtkTextIter   *location,
+                                             gchar         *text,
+                                             gint           len,
+                                             gpointer       user_data)
+{
+	GeditQuickHighlightPlugin *plugin = GEDIT_QUICK_HIGHLIGHT_PLUGIN (user_data);
+
+	g_assert (GEDIT_QUICK_HIGHLIGHT_PLUGIN (plugin));
+
+	plugin->priv->needs_refresh = TRUE;
 	gedit_quick_highlight_plugin_queue_update (plugin);
 }
 
@@ -315,6 +724,22 @@ gedit_quick_highlight_plugin_notify_style_scheme_cb (GObject    *object,
 	g_assert (GEDIT_QUICK_HIGHLIGHT_PLUGIN (plugin));
 
 	gedit_quick_highlight_plugin_load_style (plugin);
+	gedit_quick_highlight_plugin_queue_update (plugin);
+}
+
+static void
+gedit_quick_highlight_plugin_disconnect_vadjustment (GeditQuickHighlightPlugin *plugin)
+{
+	if (plugin->priv->vadjustment == NULL)
+	{
+		return;
+	}
+
+	g_signal_handler_disconnect (plugin->priv->vadjustment,
+	                             plugin->priv->vadjustment_handler_id);
+	plugin->priv->vadjustment_handler_id = 0;
+
+	g_clear_object (&plugin->priv->vadjustment);
 }
 
 static void
@@ -322,7 +747,7 @@ gedit_quick_highlight_plugin_dispose (GObject *object)
 {
 	GeditQuickHighlightPlugin *plugin = GEDIT_QUICK_HIGHLIGHT_PLUGIN (object);
 
-	g_clear_object (&plugin->priv->search_context);
+	gedit_quick_highlight_plugin_disconnect_vadjustment (plugin);
 
 	gedit_quick_highlight_plugin_unref_weak_buffer (plugin);
 
@@ -421,6 +846,19 @@ gedit_quick_highlight_plugin_activate (GeditViewActivatable *activatable)
 		                  G_CALLBACK (gedit_quick_highlight_plugin_notify_buffer_cb),
 		                  plugin);
 
+	plugin->priv->vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (plugin->priv->view));
+
+	if (plugin->priv->vadjustment != NULL)
+	{
+		g_object_ref (plugin->priv->vadjustment);
+
+		plugin->priv->vadjustment_handler_id =
+			g_signal_connect (plugin->priv->vadjustment,
+			                  "value-changed",
+			                  G_CALLBACK (gedit_quick_highlight_plugin_vadjustment_value_changed_cb),
+			                  plugin);
+	}
+
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (plugin->priv->view));
 
 	gedit_quick_highlight_plugin_set_buffer (plugin, GEDIT_DOCUMENT (buffer));
@@ -435,11 +873,18 @@ gedit_quick_highlight_plugin_deactivate (GeditViewActivatable *activatable)
 
 	plugin = GEDIT_QUICK_HIGHLIGHT_PLUGIN (activatable);
 
-	g_clear_object (&plugin->priv->style);
-	g_clear_object (&plugin->priv->search_context);
+	if (plugin->priv->queued_highlight != 0)
+	{
+		g_source_remove (plugin->priv->queued_highlight);
+		plugin->priv->queued_highlight = 0;
+	}
+
+	gedit_quick_highlight_plugin_disconnect_vadjustment (plugin);
 
 	gedit_quick_highlight_plugin_unref_weak_buffer (plugin);
 
+	g_clear_object (&plugin->priv->style);
+
 	if (plugin->priv->view != NULL && plugin->priv->buffer_handler_id > 0)
 	{
 		g_signal_handler_disconnect (plugin->priv->view,
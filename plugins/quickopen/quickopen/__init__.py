@@ -23,6 +23,7 @@ gi.require_version('Gtk', '3.0')
 from gi.repository import GObject, Gio, GLib, Gtk, Gedit
 
 from .popup import Popup
+from .fileindex import FileIndex
 from .virtualdirs import RecentDocumentsDirectory
 from .virtualdirs import CurrentDocumentsDirectory
 
@@ -56,6 +57,9 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
 
     window = GObject.Property(type=Gedit.Window)
 
+    # The directories marking the root of a project
+    PROJECT_MARKERS = ('.git', '.hg', '.svn', '.bzr', '_darcs')
+
     def __init__(self):
         GObject.Object.__init__(self)
 
@@ -63,6 +67,9 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
         self._popup_size = (450, 300)
         self._popup = None
 
+        # Kept from one popup to the next, by root uri
+        self._indexes = {}
+
         action = Gio.SimpleAction(name="quickopen")
         action.connect('activate', self.on_quick_open_activate)
         self.window.add_action(action)
@@ -70,23 +77,63 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
     def do_deactivate(self):
         self.window.remove_action("quickopen")
 
+        for index in self._indexes.values():
+            index.cancel()
+
+        self._indexes = {}
+
     def get_popup_size(self):
         return self._popup_size
 
     def set_popup_size(self, size):
         self._popup_size = size
 
+    def _project_root(self, directory):
+        """The closest directory above directory which is under version
+        control, below the home directory, or directory itself."""
+        home = Gio.file_new_for_path(os.path.expanduser('~'))
+        d = directory
+
+        while d is not None and not d.equal(home):
+            for marker in self.PROJECT_MARKERS:
+                if d.get_child(marker).query_exists(None):
+                    return d
+
+            d = d.get_parent()
+
+        return directory
+
+    def _get_index(self, gfile):
+        uri = gfile.get_uri()
+
+        if uri not in self._indexes:
+            self._indexes[uri] = FileIndex(gfile)
+
+        index = self._indexes[uri]
+        index.refresh()
+
+        return index
+
     def _create_popup(self):
         paths = []
+        indexes = []
 
         # Open documents
         paths.append(CurrentDocumentsDirectory(self.window))
 
         doc = self.window.get_active_document()
 
-        # Current document directory
+        # Project of the current document, indexed unless it is the home
+        # directory or a root, and the current document directory
         if doc and doc.get_file().is_local():
             gfile = doc.get_file().get_location()
+            root = self._project_root(gfile.get_parent())
+
+            if not root.equal(Gio.file_new_for_path(os.path.expanduser('~'))) and \
+               root.get_parent() is not None:
+                paths.append(root)
+                indexes.append(self._get_index(root))
+
             paths.append(gfile.get_parent())
 
         # File browser root directory
@@ -117,7 +164,7 @@ class QuickOpenPlugin(GObject.Object, Gedit.WindowActivatable):
         # Home directory
         paths.append(Gio.file_new_for_path(os.path.expanduser('~')))
 
-        self._popup = Popup(self.window, paths, self.on_activated)
+        self._popup = Popup(self.window, paths, self.on_activated, indexes)
         self.window.get_group().add_window(self._popup)
 
         self._popup.set_default_size(*self.get_popup_size())
@@ -0,0 +1,407 @@
+# -*- coding: utf-8 -*-
+
+#  Copyright (C) 2009 - Jesse van den Kieboom
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+import os
+import re
+import heapq
+import platform
+import xml.sax.saxutils
+
+from gi.repository import GLib, Gio
+
+
+def is_text(info):
+    content_type = info.get_content_type()
+
+    if content_type is None or Gio.content_type_is_unknown(content_type):
+        return True
+
+    if platform.system() != 'Windows':
+        if Gio.content_type_is_a(content_type, 'text/plain'):
+            return True
+    else:
+        if Gio.content_type_is_a(content_type, 'text'):
+            return True
+
+        # This covers a rare case in which on Windows the PerceivedType
+        # is not set to "text" but the Content Type is set to text/plain
+        if Gio.content_type_get_mime_type(content_type) == 'text/plain':
+            return True
+
+    return False
+
+
+class FileIndex(object):
+    """The text files below a directory, as paths relative to it.
+
+    The directory is walked in the background with the asynchronous GIO
+    API, a few directories at a time. The index is kept once built, and
+    rebuilt in the background by refresh(), the old paths being used until
+    the new ones are complete.
+    """
+
+    ATTRIBUTES = ','.join((Gio.FILE_ATTRIBUTE_STANDARD_NAME,
+                           Gio.FILE_ATTRIBUTE_STANDARD_TYPE,
+                           Gio.FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
+                           Gio.FILE_ATTRIBUTE_STANDARD_IS_BACKUP,
+                           Gio.FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE))
+
+    MAX_FILES = 500000
+    MAX_ENUMERATORS = 4
+    BATCH_SIZE = 256
+
+    # Minimum time between two notifications while walking, in ms
+    NOTIFY_INTERVAL = 200
+
+    # Before that, refresh() keeps the index as is, in seconds
+    MAX_AGE = 60
+
+    def __init__(self, root):
+        self._root = root
+        self._listeners = []
+
+        # Replaced as a whole when rebuilt; only appended to otherwise
+        self._paths = []
+        self._generation = 0
+        self._timestamp = 0
+
+        self._cancellable = None
+        self._walk_paths = None
+        self._pending = []
+        self._running = 0
+        self._notify_id = 0
+
+    def get_root(self):
+        return self._root
+
+    def get_paths(self):
+        return self._paths
+
+    def get_generation(self):
+        """Changes when the paths are replaced rather than appended to."""
+        return self._generation
+
+    def is_walking(self):
+        return self._cancellable is not None
+
+    def add_listener(self, callback):
+        self._listeners.append(callback)
+
+    def remove_listener(self, callback):
+        self._listeners.remove(callback)
+
+    def refresh(self):
+        if self.is_walking():
+            return
+
+        if self._timestamp and GLib.get_monotonic_time() - self._timestamp < self.MAX_AGE * 1000000:
+            return
+
+        self._cancellable = Gio.Cancellable()
+        self._pending = [(self._root, '')]
+        self._running = 0
+
+        # The first walk fills the index as it goes
+        self._walk_paths = [] if self._paths else self._paths
+
+        self._next_directory()
+
+    def cancel(self):
+        if self._cancellable:
+            self._cancellable.cancel()
+            self._cancellable = None
+
+        if self._notify_id:
+            GLib.source_remove(self._notify_id)
+            self._notify_id = 0
+
+        self._pending = []
+        self._walk_paths = None
+
+    def _next_directory(self):
+        while self._pending and self._running < self.MAX_ENUMERATORS:
+            gfile, prefix = self._pending.pop()
+            self._running += 1
+
+            gfile.enumerate_children_async(self.ATTRIBUTES,
+                                           Gio.FileQueryInfoFlags.NOFOLLOW_SYMLINKS,
+                                           GLib.PRIORITY_LOW,
+                                           self._cancellable,
+                                           self._on_enumerate_children,
+                                           (gfile, prefix, self._cancellable))
+
+        if self._running == 0:
+            self._walk_done()
+
+    def _on_enumerate_children(self, gfile, result, data):
+        parent, prefix, cancellable = data
+
+        try:
+            enumerator = gfile.enumerate_children_finish(result)
+        except GLib.Error:
+            if not cancellable.is_cancelled():
+                self._directory_done()
+            return
+
+        enumerator.next_files_async(self.BATCH_SIZE,
+                                    GLib.PRIORITY_LOW,
+                                    cancellable,
+                                    self._on_next_files,
+                                    data)
+
+    def _on_next_files(self, enumerator, result, data):
+        parent, prefix, cancellable = data
+
+        try:
+            infos = enumerator.next_files_finish(result)
+        except GLib.Error:
+            infos = []
+
+        if cancellable.is_cancelled():
+            return
+
+        for info in infos:
+            if info.get_is_hidden() or info.get_is_backup():
+                continue
+
+            name = info.get_name()
+            file_type = info.get_file_type()
+
+            # The paths are matched one per line
+            if '\n' in name:
+                continue
+
+            if file_type == Gio.FileType.DIRECTORY:
+                self._pending.append((parent.get_child(name), prefix + name + os.sep))
+            elif file_type == Gio.FileType.REGULAR and is_text(info):
+                self._walk_paths.append(prefix + name)
+
+        if infos and len(self._walk_paths) < self.MAX_FILES:
+            enumerator.next_files_async(self.BATCH_SIZE,
+                                        GLib.PRIORITY_LOW,
+                                        cancellable,
+                                        self._on_next_files,
+                                        data)
+        else:
+            enumerator.close_async(GLib.PRIORITY_LOW, None, None, None)
+            self._directory_done()
+
+        if self._walk_paths is self._paths and not self._notify_id:
+            self._notify_id = GLib.timeout_add(self.NOTIFY_INTERVAL, self._on_notify_timeout)
+
+    def _directory_done(self):
+        self._running -= 1
+
+        if len(self._walk_paths) >= self.MAX_FILES:
+            self._pending = []
+
+        self._next_directory()
+
+    def _walk_done(self):
+        if self._walk_paths is not self._paths:
+            self._paths = self._walk_paths
+            self._generation += 1
+
+        self._walk_paths = None
+        self._cancellable = None
+        self._timestamp = GLib.get_monotonic_time()
+
+        if self._notify_id:
+            GLib.source_remove(self._notify_id)
+            self._notify_id = 0
+
+        self._notify()
+
+    def _on_notify_timeout(self):
+        self._notify_id = 0
+        self._notify()
+
+        return False
+
+    def _notify(self):
+        for callback in list(self._listeners):
+            callback(self)
+
+
+def lower(s):
+    """Lowercases s character by character, so that the positions in the
+    result are the positions in s."""
+    return ''.join(c if len(c.lower()) != 1 else c.lower() for c in s)
+
+
+class FuzzyMatcher(object):
+    """Matches the paths of a FileIndex against a query.
+
+    A path matches when it contains the characters of the query in order,
+    ignoring case. The candidates are found with a single regular
+    expression over all the paths, and only the shortest ones are scored.
+
+    The candidates of the prefixes of the last query are kept: when the
+    query grows, only the candidates of its longest known prefix are
+    filtered again, and when the index grows, only the new paths are.
+    """
+
+    MAX_SCORED = 500
+
+    def __init__(self, index):
+        self._index = index
+        self._generation = -1
+
+        # Query -> (candidates, number of paths matched)
+        self._history = {}
+
+    def get_index(self):
+        return self._index
+
+    def _fold_chars(self, c):
+        """The characters which lower() folds like c, as far as they can
+        be found from c, so that the candidates are the paths the scorer
+        finds the query in."""
+        lc = lower(c)
+        chars = [lc]
+
+        for v in (c, lc.upper(), c.upper()):
+            if len(v) == 1 and lower(v) == lc and v not in chars:
+                chars.append(v)
+
+        return chars
+
+    def _make_regex(self, query):
+        pattern = '^'
+
+        for c in query:
+            chars = ''.join(re.escape(v) for v in self._fold_chars(c))
+            pattern += '[^\n%s]*[%s]' % (chars, chars)
+
+        return re.compile(pattern + '[^\n]*$', re.M)
+
+    def _filter(self, query, paths):
+        if not paths:
+            return []
+
+        # Much faster than a regular expression for the first key press
+        if len(query) == 1:
+            chars = self._fold_chars(query)
+
+            return [p for p in paths if any(v in p for v in chars)]
+
+        return self._make_regex(query).findall('\n'.join(paths))
+
+    def _get_candidates(self, query):
+        paths = self._index.get_paths()
+
+        if self._generation != self._index.get_generation():
+            self._generation = self._index.get_generation()
+            self._history = {}
+
+        prefix = query
+
+        while prefix and prefix not in self._history:
+            prefix = prefix[:-1]
+
+        if prefix:
+            candidates, n_matched = self._history[prefix]
+
+            if prefix != query:
+                candidates = self._filter(query, candidates)
+        else:
+            candidates, n_matched = [], 0
+
+        if n_matched < len(paths):
+            candidates = candidates + self._filter(query, paths[n_matched:])
+
+        # Keep only the prefixes of the query
+        self._history = dict((q, v) for q, v in self._history.items() if query.startswith(q))
+        self._history[query] = (candidates, len(paths))
+
+        return candidates
+
+    def match(self, query):
+        candidates = self._get_candidates(query)
+
+        if len(candidates) > self.MAX_SCORED:
+            candidates = heapq.nsmallest(self.MAX_SCORED, candidates, key=len)
+
+        lquery = lower(query)
+        matches = []
+
+        for path in candidates:
+            score, positions = self._score(lquery, path)
+
+            if positions is not None:
+                matches.append((score, path, positions))
+
+        matches.sort(key=lambda m: (-m[0], len(m[1]), m[1]))
+        return matches
+
+    def _find_positions(self, lquery, lpath, start):
+        positions = []
+
+        for c in lquery:
+            start = lpath.find(c, start)
+
+            if start == -1:
+                return None
+
+            positions.append(start)
+            start += 1
+
+        return positions
+
+    def _score(self, lquery, path):
+        lpath = lower(path)
+        basename = lpath.rfind(os.sep) + 1
+
+        # Prefer the matches in the file name
+        positions = self._find_positions(lquery, lpath, basename)
+        score = 10 if positions is not None else 0
+
+        if positions is None:
+            positions = self._find_positions(lquery, lpath, 0)
+
+            if positions is None:
+                return 0, None
+
+        previous = -2
+
+        for pos in positions:
+            if pos == previous + 1:
+                score += 4
+            elif pos == 0 or path[pos - 1] in os.sep + '_-. ':
+                score += 6
+            elif path[pos].isupper() and path[pos - 1].islower():
+                score += 6
+            else:
+                score -= 1
+
+            previous = pos
+
+        return score, positions
+
+    def make_markup(self, path, positions):
+        out = []
+        last = 0
+
+        for pos in positions:
+            out.append(xml.sax.saxutils.escape(path[last:pos]))
+            out.append('<b>%s</b>' % (xml.sax.saxutils.escape(path[pos]),))
+            last = pos + 1
+
+        out.append(xml.sax.saxutils.escape(path[last:]))
+        return ''.join(out)
+
+# ex:ts=4:et:
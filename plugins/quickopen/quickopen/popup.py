@@ -16,13 +16,12 @@
 #  along with this program; if not, see <http://www.gnu.org/licenses/>.
 
 import os
-import platform
-import functools
 import fnmatch
 
 from gi.repository import GLib, Gio, GObject, Pango, Gtk, Gdk, Gedit
 import xml.sax.saxutils
 from .virtualdirs import VirtualDirectory
+from .fileindex import FuzzyMatcher, is_text
 
 try:
     import gettext
@@ -35,7 +34,10 @@ except:
 class Popup(Gtk.Dialog):
     __gtype_name__ = "QuickOpenPopup"
 
-    def __init__(self, window, paths, handler):
+    # Per indexed directory
+    MAX_INDEX_RESULTS = 200
+
+    def __init__(self, window, paths, handler, indexes=None):
         Gtk.Dialog.__init__(self,
                             title=_('Quick Open'),
                             transient_for=window,
@@ -51,7 +53,9 @@ class Popup(Gtk.Dialog):
 
         self._size = (0, 0)
         self._dirs = []
+        self._search_roots = []
         self._cache = {}
+        self._search_id = 0
         self._theme = None
         self._cursor = None
         self._shift_start = None
@@ -67,13 +71,35 @@ class Popup(Gtk.Dialog):
         self.add_accel_group(accel_group)
 
         unique = []
+        indexes = dict((index.get_root().get_uri(), index) for index in indexes or [])
+        self._indexes = []
 
+        # The indexed directories are searched with a fuzzy matcher, unless
+        # the path typed goes up from them, the others by walking the path
+        # typed
         for path in paths:
-            if not path.get_uri() in unique:
+            uri = path.get_uri()
+
+            if uri in unique:
+                continue
+
+            unique.append(uri)
+
+            if uri in indexes:
+                index = indexes[uri]
+                index.add_listener(self.on_index_changed)
+
+                self._indexes.append(index)
+                self._search_roots.append(FuzzyMatcher(index))
+            else:
+                if isinstance(path, VirtualDirectory):
+                    path.add_listener(self.on_virtual_changed)
+
                 self._dirs.append(path)
-                unique.append(path.get_uri())
+                self._search_roots.append(path)
 
         self.connect('show', self.on_show)
+        self.connect('destroy', self.on_destroy)
 
     def get_final_size(self):
         return self._size
@@ -154,26 +180,6 @@ class Popup(Gtk.Dialog):
             cell.set_property('cell-background-set', False)
             cell.set_property('style-set', False)
 
-    def _is_text(self, entry):
-        content_type = entry.get_content_type()
-
-        if content_type is None or Gio.content_type_is_unknown(content_type):
-            return True
-
-        if platform.system() != 'Windows':
-            if Gio.content_type_is_a(content_type, 'text/plain'):
-                return True
-        else:
-            if Gio.content_type_is_a(content_type, 'text'):
-                return True
-
-            # This covers a rare case in which on Windows the PerceivedType
-            # is not set to "text" but the Content Type is set to text/plain
-            if Gio.content_type_get_mime_type(content_type) == 'text/plain':
-                return True
-
-        return False
-
     def _list_dir(self, gfile):
         entries = []
 
@@ -202,7 +208,7 @@ class Popup(Gtk.Dialog):
             file_type = entry[1].get_file_type()
 
             if file_type == Gio.FileType.REGULAR:
-                if not self._is_text(entry[1]):
+                if not is_text(entry[1]):
                     continue
 
             children.append((entry[0],
@@ -212,21 +218,11 @@ class Popup(Gtk.Dialog):
 
         return children
 
-    def _compare_entries(self, a, b, lpart):
-        if lpart in a:
-            if lpart in b:
-                if a.index(lpart) < b.index(lpart):
-                    return -1
-                elif a.index(lpart) > b.index(lpart):
-                    return 1
-                else:
-                    return 0
-            else:
-                return -1
-        elif lpart in b:
-            return 1
+    def _entry_rank(self, lentry, lpart):
+        if lpart in lentry:
+            return (0, lentry.index(lpart))
         else:
-            return 0
+            return (1, 0)
 
     def _match_glob(self, s, glob):
         if glob:
@@ -266,7 +262,7 @@ class Popup(Gtk.Dialog):
                         (not lpart or len(parts) == 1):
                     found.append(entry)
 
-        found.sort(key=functools.cmp_to_key(lambda a, b: self._compare_entries(a[1].lower(), b[1].lower(), lpart)))
+        found.sort(key=lambda x: self._entry_rank(x[1].lower(), lpart))
 
         if lpart == '..':
             newdirs.append(d.get_parent())
@@ -276,6 +272,17 @@ class Popup(Gtk.Dialog):
 
         return found
 
+    def do_search_index(self, text, matcher):
+        root = matcher.get_index().get_root()
+
+        for score, path, positions in matcher.match(text)[:self.MAX_INDEX_RESULTS]:
+            content_type, uncertain = Gio.content_type_guess(path, None)
+
+            self._append_to_store((Gio.content_type_get_icon(content_type),
+                                  matcher.make_markup(path, positions),
+                                  root.resolve_relative_path(path),
+                                  Gio.FileType.REGULAR))
+
     def _replace_insensitive(self, s, find, rep):
         out = ''
         l = s.lower()
@@ -392,9 +399,15 @@ class Popup(Gtk.Dialog):
             self._show_virtuals()
         else:
             parts = self.normalize_relative(text.split(os.sep))
-            files = []
 
-            for d in self._dirs:
+            for d in self._search_roots:
+                if isinstance(d, FuzzyMatcher):
+                    if '..' not in parts:
+                        self.do_search_index(text, d)
+                        continue
+
+                    d = d.get_index().get_root()
+
                 for entry in self.do_search_dir(parts, d):
                     pathparts = self._make_parts(d, entry[0], parts)
                     self._append_to_store((entry[3],
@@ -420,9 +433,45 @@ class Popup(Gtk.Dialog):
         self.do_search()
 
     def on_changed(self, editable):
+        if self._search_id:
+            GLib.source_remove(self._search_id)
+            self._search_id = 0
+
+        self.do_search()
+        self.on_selection_changed(self._treeview.get_selection())
+
+    def _queue_search(self):
+        if not self._search_id and self.get_visible():
+            self._search_id = GLib.idle_add(self._on_search_idle)
+
+    def _on_search_idle(self):
+        self._search_id = 0
+
         self.do_search()
         self.on_selection_changed(self._treeview.get_selection())
 
+        return False
+
+    def on_index_changed(self, index):
+        if self._entry.get_text().strip() != '':
+            self._queue_search()
+
+    def on_virtual_changed(self, directory):
+        self._cache.pop(directory, None)
+        self._queue_search()
+
+    def on_destroy(self, widget):
+        if self._search_id:
+            GLib.source_remove(self._search_id)
+            self._search_id = 0
+
+        for index in self._indexes:
+            index.remove_listener(self.on_index_changed)
+
+        for d in self._dirs:
+            if isinstance(d, VirtualDirectory):
+                d.cancel()
+
     def _shift_extend(self, towhere):
         selection = self._treeview.get_selection()
 
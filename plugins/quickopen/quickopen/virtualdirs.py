@@ -15,13 +15,15 @@
 #  You should have received a copy of the GNU General Public License
 #  along with this program; if not, see <http://www.gnu.org/licenses/>.
 
-from gi.repository import Gio, Gtk
+from gi.repository import GLib, Gio, Gtk
 
 
 class VirtualDirectory(object):
     def __init__(self, name):
         self._name = name
         self._children = []
+        self._listeners = []
+        self._cancellable = Gio.Cancellable()
 
     def get_uri(self):
         return 'virtual://' + self._name
@@ -30,22 +32,45 @@ class VirtualDirectory(object):
         return None
 
     def enumerate_children(self, attr, flags, callback):
-        return self._children
+        return [tuple(c) for c in self._children if c[1] is not None]
+
+    def add_listener(self, callback):
+        self._listeners.append(callback)
+
+    def cancel(self):
+        self._cancellable.cancel()
 
     def append(self, child):
         if not child.is_native():
             return
 
-        try:
-            info = child.query_info("standard::*",
-                                    Gio.FileQueryInfoFlags.NONE,
-                                    None)
+        # The children are added in order, as their infos arrive
+        slot = [child, None]
+        self._children.append(slot)
 
-            if info:
-                self._children.append((child, info))
-        except Exception as e:
+        child.query_info_async("standard::*",
+                               Gio.FileQueryInfoFlags.NONE,
+                               GLib.PRIORITY_DEFAULT,
+                               self._cancellable,
+                               self._on_query_info,
+                               slot)
+
+    def _on_query_info(self, child, result, slot):
+        try:
+            slot[1] = child.query_info_finish(result)
+        except GLib.Error:
             pass
 
+        if self._cancellable.is_cancelled():
+            return
+
+        if slot[1] is None:
+            self._children.remove(slot)
+            return
+
+        for callback in self._listeners:
+            callback(self)
+
 
 class RecentDocumentsDirectory(VirtualDirectory):
     def __init__(self, maxitems=200):
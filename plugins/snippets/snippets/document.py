@@ -22,7 +22,7 @@ from gi.repository import Gtk, Gdk, Gio, GLib, Gedit, GObject
 
 from .library import Library
 from .snippet import Snippet
-from .placeholder import PlaceholderEnd
+from .placeholder import PlaceholderEnd, PlaceholderIndex
 from . import completion
 from .signals import Signals
 from .shareddata import SharedData
@@ -55,7 +55,7 @@ class Document(GObject.Object, Gedit.ViewActivatable, Signals):
         self.active_snippets = []
         self.active_placeholder = None
 
-        self.ordered_placeholders = []
+        self.ordered_placeholders = PlaceholderIndex()
         self.update_placeholders = []
         self.jump_placeholders = []
         self.language_id = 0
@@ -73,8 +73,6 @@ class Document(GObject.Object, Gedit.ViewActivatable, Signals):
         self.connect_signal(buf, 'notify::language', self.on_notify_language)
         self.connect_signal(self.view, 'drag-data-received', self.on_drag_data_received)
 
-        self.connect_signal_after(self.view, 'draw', self.on_draw)
-
         self.update_language()
 
         completion = self.view.get_completion()
@@ -158,18 +156,24 @@ class Document(GObject.Object, Gedit.ViewActivatable, Signals):
 
         return True
 
+    # The handlers below only matter while there are active snippets, so
+    # that typing or drawing does not run them otherwise
     def first_snippet_inserted(self):
         buf = self.view.get_buffer()
 
         self.connect_signal(buf, 'changed', self.on_buffer_changed)
         self.connect_signal(buf, 'cursor-moved', self.on_buffer_cursor_moved)
         self.connect_signal_after(buf, 'insert-text', self.on_buffer_insert_text)
+        self.connect_signal(buf, 'delete-range', self.on_buffer_delete_range)
+        self.connect_signal_after(self.view, 'draw', self.on_draw)
 
     def last_snippet_removed(self):
         buf = self.view.get_buffer()
         self.disconnect_signal(buf, 'changed')
         self.disconnect_signal(buf, 'cursor-moved')
         self.disconnect_signal(buf, 'insert-text')
+        self.disconnect_signal(buf, 'delete-range')
+        self.disconnect_signal(self.view, 'draw')
 
     def current_placeholder(self):
         buf = self.view.get_buffer()
@@ -571,7 +575,9 @@ class Document(GObject.Object, Gedit.ViewActivatable, Signals):
             self.first_snippet_inserted()
             self.block_signal(buf, 'cursor-moved')
 
+        self.ordered_placeholders.begin_update()
         sn = s.insert_into(self, start)
+        self.ordered_placeholders.end_update()
         self.active_snippets.append(sn)
 
         # Put cursor at first tab placeholder
@@ -796,6 +802,9 @@ class Document(GObject.Object, Gedit.ViewActivatable, Signals):
                         self.update_snippet_contents)
 
     def on_buffer_insert_text(self, buf, piter, text, length):
+        # piter is now at the end of the inserted text
+        self.ordered_placeholders.inserted(piter.get_offset() - len(text), len(text))
+
         ctx = helper.get_buffer_context(buf)
 
         # do nothing special if there is no context and no active
@@ -810,12 +819,16 @@ class Document(GObject.Object, Gedit.ViewActivatable, Signals):
             return
 
         # move any marks that were incorrectly moved by this insertion
-        # back to where they belong
+        # back to where they belong, those are now inside the context
         begin = ctx.begin_iter()
         end = ctx.end_iter()
-        idx = self.ordered_placeholders.index(ctx)
 
-        for placeholder in self.ordered_placeholders:
+        if not begin or not end:
+            return
+
+        idx = self.ordered_placeholders.order(ctx)
+
+        for placeholder in self.ordered_placeholders.touching(begin, end):
             if placeholder == ctx:
                 continue
 
@@ -823,16 +836,20 @@ class Document(GObject.Object, Gedit.ViewActivatable, Signals):
             oe = placeholder.end_iter()
 
             if ob.compare(begin) == 0 and ((not oe) or oe.compare(end) == 0):
-                oidx = self.ordered_placeholders.index(placeholder)
+                oidx = self.ordered_placeholders.order(placeholder)
 
                 if oidx > idx and ob:
-                    buf.move_mark(placeholder.begin, end)
+                    self.ordered_placeholders.move_mark(placeholder.begin, end)
                 elif oidx < idx and oe:
-                    buf.move_mark(placeholder.end, begin)
+                    self.ordered_placeholders.move_mark(placeholder.end, begin)
             elif ob.compare(begin) >= 0 and ob.compare(end) < 0 and (oe and oe.compare(end) >= 0):
-                buf.move_mark(placeholder.begin, end)
+                self.ordered_placeholders.move_mark(placeholder.begin, end)
             elif (oe and oe.compare(begin) > 0) and ob.compare(begin) <= 0:
-                buf.move_mark(placeholder.end, begin)
+                self.ordered_placeholders.move_mark(placeholder.end, begin)
+
+    def on_buffer_delete_range(self, buf, start, end):
+        # Connected before the deletion, while the range is still there
+        self.ordered_placeholders.deleted(start.get_offset(), end.get_offset())
 
     def on_notify_language(self, buf, spec):
         self.update_language()
@@ -19,8 +19,9 @@ import os
 import weakref
 import sys
 import re
+import marshal
 
-from gi.repository import Gdk, Gtk
+from gi.repository import GLib, Gdk, Gtk
 
 import xml.etree.ElementTree as et
 from . import helper
@@ -265,11 +266,212 @@ class SnippetsTreeBuilder(et.TreeBuilder):
 
         return result
 
+class TriggerTrie:
+    """
+    Snippets by tab trigger, in a prefix tree. Both finding the snippets of
+    a trigger and those of all the triggers starting with a prefix only
+    depend on the length of the trigger, and on the number of snippets
+    found.
+    """
+
+    def __init__(self):
+        # A node is a (children by character, snippets) tuple
+        self.root = ({}, [])
+
+    def _find(self, trigger):
+        node = self.root
+
+        for c in trigger:
+            node = node[0].get(c)
+
+            if node is None:
+                return None
+
+        return node
+
+    def add(self, trigger, snippet):
+        node = self.root
+
+        for c in trigger:
+            node = node[0].setdefault(c, ({}, []))
+
+        node[1].append(snippet)
+
+    def remove(self, trigger, snippet):
+        nodes = [self.root]
+
+        for c in trigger:
+            node = nodes[-1][0].get(c)
+
+            if node is None:
+                return
+
+            nodes.append(node)
+
+        try:
+            nodes[-1][1].remove(snippet)
+        except ValueError:
+            return
+
+        # Prune the nodes left empty
+        for i in range(len(trigger), 0, -1):
+            if nodes[i][0] or nodes[i][1]:
+                break
+
+            del nodes[i - 1][0][trigger[i - 1]]
+
+    def lookup(self, trigger):
+        node = self._find(trigger)
+
+        return list(node[1]) if node else []
+
+    def lookup_prefix(self, prefix):
+        node = self._find(prefix)
+
+        if node is None:
+            return []
+
+        result = []
+        stack = [node]
+
+        # The exact matches first
+        while stack:
+            node = stack.pop()
+            result.extend(node[1])
+            stack.extend(reversed(list(node[0].values())))
+
+        return result
+
+class LibraryCache:
+    """
+    The parsed snippet files, keyed by their path and checked against their
+    modification time and size, so that a file is only parsed again when it
+    changed. The cache is read at once the first time it is needed, and
+    written back in an idle after a file has been parsed.
+    """
+
+    VERSION = 1
+
+    def __init__(self, path):
+        self.path = path
+        self.entries = None
+        self.used = {}
+        self.save_id = 0
+
+    def _load(self):
+        self.entries = {}
+
+        try:
+            with open(self.path, 'rb') as f:
+                data = marshal.loads(f.read())
+        except (IOError, OSError, EOFError, ValueError, TypeError):
+            return
+
+        if isinstance(data, tuple) and len(data) == 2 and data[0] == self.VERSION:
+            self.entries = data[1]
+
+    def _stamp(self, path):
+        try:
+            st = os.stat(path)
+        except OSError:
+            return None
+
+        return (st.st_mtime_ns, st.st_size)
+
+    def _lookup(self, path):
+        if self.entries is None:
+            self._load()
+
+        entry = self.entries.get(path)
+
+        if entry is None or entry[0] != self._stamp(path):
+            return None
+
+        self.used[path] = entry
+        return entry
+
+    def lookup_root(self, path):
+        """Returns the root element of the file, without its children."""
+        entry = self._lookup(path)
+
+        if entry is None:
+            return None
+
+        return et.Element(entry[1], entry[2])
+
+    def lookup(self, path):
+        """Returns the whole tree of the file, or None if not cached."""
+        entry = self._lookup(path)
+
+        if entry is None or entry[3] is None:
+            return None
+
+        return self._build(entry[3])
+
+    def store(self, path, root, complete=True):
+        stamp = self._stamp(path)
+
+        if stamp is None:
+            return
+
+        if self.entries is None:
+            self._load()
+
+        tree = self._compile(root) if complete else None
+        entry = (stamp, root.tag, dict(root.attrib), tree)
+
+        self.entries[path] = entry
+        self.used[path] = entry
+
+        if self.save_id == 0:
+            self.save_id = GLib.idle_add(self.save)
+
+    def _compile(self, node):
+        return (node.tag, dict(node.attrib), node.text, node.tail,
+                [self._compile(child) for child in node])
+
+    def _build(self, tree, parent=None):
+        tag, attrib, text, tail, children = tree
+
+        if parent is None:
+            element = et.Element(tag, attrib)
+        else:
+            element = et.SubElement(parent, tag, attrib)
+
+        element.text = text
+        element.tail = tail
+
+        for child in children:
+            self._build(child, element)
+
+        return element
+
+    def save(self):
+        self.save_id = 0
+
+        # Only the files still around are kept, they have all been looked
+        # up when the libraries were added
+        data = marshal.dumps((self.VERSION, self.used))
+        tmp = self.path + '.tmp'
+
+        try:
+            os.makedirs(os.path.dirname(self.path), 0o755, exist_ok=True)
+
+            with open(tmp, 'wb') as f:
+                f.write(data)
+
+            os.replace(tmp, self.path)
+        except OSError:
+            helper.snippets_debug('Could not write the snippets cache ' + self.path)
+
+        return False
+
 class LanguageContainer:
     def __init__(self, language):
         self.language = language
         self.snippets = []
-        self.snippets_by_prop = {'tag': {}, 'accelerator': {}, 'drop-targets': {}}
+        self.snippets_by_prop = {'accelerator': {}, 'drop-targets': {}}
+        self.triggers = TriggerTrie()
         self.accel_group = Gtk.AccelGroup()
         self._refs = 0
 
@@ -286,6 +488,9 @@ class LanguageContainer:
             keyval, mod = Gtk.accelerator_parse(value)
             self.accel_group.connect(keyval, mod, 0, \
                     Library().accelerator_activated)
+        elif prop == 'tag':
+            self.triggers.add(value, snippet)
+            return
 
         snippets = self.snippets_by_prop[prop]
 
@@ -310,6 +515,9 @@ class LanguageContainer:
         if prop == 'accelerator':
             keyval, mod = Gtk.accelerator_parse(value)
             self.accel_group.disconnect_key(keyval, mod)
+        elif prop == 'tag':
+            self.triggers.remove(value, snippet)
+            return
 
         snippets = self.snippets_by_prop[prop]
 
@@ -348,6 +556,9 @@ class LanguageContainer:
         self._add_prop(snippet, prop)
 
     def from_prop(self, prop, value):
+        if prop == 'tag':
+            return self.triggers.lookup(value)
+
         snippets = self.snippets_by_prop[prop]
 
         if prop == 'drop-targets':
@@ -492,21 +703,49 @@ class SnippetsSystemFile:
         self.ok = False
         self.loading_elements = []
 
+        tree = Library().cache.lookup(self.path)
+
+        if tree is not None:
+            self._load_tree(tree)
+        elif not self._load_xml():
+            del self.loading_elements[:]
+            return
+
+        for element in self.loading_elements:
+            Library().add_snippet(self, element)
+
+        del self.loading_elements[:]
+        self.ok = True
+
+    def _load_xml(self):
+        root = None
+        self.ok = True
+
         for element in self.parse_xml():
+            if root is None:
+                root = element[0]
+
             if element[1]:
                 if not self._preprocess_element(element[0]):
-                    del self.loading_elements[:]
-                    return
+                    return False
             else:
                 if not self._process_element(element[0]):
-                    del self.loading_elements[:]
-                    return
+                    return False
 
-        for element in self.loading_elements:
-            Library().add_snippet(self, element)
+        # parse_xml clears ok on errors, only complete files are cached.
+        # This is done before the snippets are created, as they may add
+        # missing properties to the elements
+        if self.ok and root is not None:
+            Library().cache.store(self.path, root)
 
-        del self.loading_elements[:]
-        self.ok = True
+        return True
+
+    def _load_tree(self, root):
+        self._set_root(root)
+        self.loaded = True
+
+        for element in root:
+            self._add_snippet(element)
 
     # This function will get the language for a file by just inspecting the
     # root element of the file. This is provided so that a cache can be built
@@ -514,6 +753,13 @@ class SnippetsSystemFile:
     # It returns the name of the language
     def ensure_language(self):
         if not self.loaded:
+            root = Library().cache.lookup_root(self.path)
+
+            if root is not None:
+                self.set_language(root)
+                self.ok = True
+                return
+
             self.ok = False
 
             for element in self.parse_xml(256):
@@ -521,6 +767,7 @@ class SnippetsSystemFile:
                     if element[0].tag == 'snippets':
                         self.set_language(element[0])
                         self.ok = True
+                        Library().cache.store(self.path, element[0], False)
 
                     break
 
@@ -624,6 +871,8 @@ class SnippetsUserFile(SnippetsSystemFile):
         try:
             helper.write_xml(self.root, self.path, ('text', 'accelerator'))
             self.tainted = False
+
+            Library().cache.store(self.path, self.root)
         except IOError:
             # Couldn't save, what to do
             sys.stderr.write("Could not save user snippets file to " + \
@@ -654,6 +903,9 @@ class Library(Singleton):
         self.userdir = userdir
         self.systemdirs = systemdirs
 
+        self.cache = LibraryCache(os.path.join(GLib.get_user_cache_dir(),
+                                               'gedit', 'snippets.cache'))
+
         self.libraries = {}
         self.containers = {}
         self.overridden = {}
@@ -974,6 +1226,21 @@ class Library(Singleton):
 
         return list(self.containers[language].snippets)
 
+    # Get snippets whose tag starts with a given prefix, the global ones
+    # first
+    def from_tag_prefix(self, prefix, language=None):
+        self.ensure_files()
+        language = self.normalize_language(language)
+
+        self.ensure(language)
+        result = []
+
+        for lang in ((None, language) if language else (None,)):
+            if lang in self.libraries and lang in self.containers:
+                result += self.containers[lang].triggers.lookup_prefix(prefix)
+
+        return result
+
     # Get snippets for a given accelerator
     def from_accelerator(self, accelerator, language=None):
         return self._from_prop('accelerator', accelerator, language)
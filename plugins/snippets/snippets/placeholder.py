@@ -17,6 +17,7 @@
 
 import traceback
 import re
+import bisect
 import sys
 import signal
 import locale
@@ -711,4 +712,170 @@ class PlaceholderRegex(PlaceholderExpand):
 
         return True
 
+class PlaceholderIndex(list):
+    """
+    The placeholders of a document, in the order they were added, which can
+    also be searched by the position of their marks.
+
+    The offsets of the marks are kept sorted, the left gravity marks first
+    for the same offset, and searched with bisect. They are updated in place
+    when text is inserted or deleted, which is reported with inserted() and
+    deleted(), and when a mark is moved with move_mark(). They are only read
+    from the buffer again when placeholders are added, once at the end of an
+    update. While snippets are being inserted, and marks created, they are
+    read for every search.
+    """
+
+    def __init__(self):
+        list.__init__(self)
+        self._updating = 0
+        self._order = {}
+        self._serial = 0
+        self.invalidate()
+
+    def invalidate(self):
+        self._keys = None
+        self._marks = None
+
+    def begin_update(self):
+        self._updating += 1
+
+    def end_update(self):
+        self._updating -= 1
+        self.invalidate()
+
+    def __contains__(self, placeholder):
+        return placeholder in self._order
+
+    def order(self, placeholder):
+        """
+        Returns a number which orders the placeholder like its index.
+        """
+        return self._order[placeholder]
+
+    def append(self, placeholder):
+        list.append(self, placeholder)
+        self._order[placeholder] = self._serial
+        self._serial += 1
+        self.invalidate()
+
+    def insert(self, index, placeholder):
+        list.insert(self, index, placeholder)
+        self._order = dict((p, i) for i, p in enumerate(self))
+        self._serial = len(self)
+        self.invalidate()
+
+    def remove(self, placeholder):
+        list.remove(self, placeholder)
+        del self._order[placeholder]
+
+        if self._marks is None:
+            return
+
+        keep = [i for i, entry in enumerate(self._marks) if entry[1] != placeholder]
+        self._keys = [self._keys[i] for i in keep]
+        self._marks = [self._marks[i] for i in keep]
+
+    def _key(self, mark):
+        piter = mark.get_buffer().get_iter_at_mark(mark)
+        return (piter.get_offset(), not mark.get_left_gravity())
+
+    def _valid(self):
+        return self._keys is not None and not self._updating
+
+    def _sort(self):
+        entries = []
+
+        for placeholder in self:
+            for mark in (placeholder.begin, placeholder.end):
+                if mark and not mark.get_deleted():
+                    entries.append((self._key(mark), mark, placeholder))
+
+        entries.sort(key=lambda x: x[0])
+
+        self._keys = [key for key, mark, placeholder in entries]
+        self._marks = [(mark, placeholder) for key, mark, placeholder in entries]
+
+    def inserted(self, offset, length):
+        """
+        Updates the offsets after length characters were inserted at offset.
+        """
+        if not self._valid():
+            return
+
+        keys = self._keys
+
+        # The left gravity marks at the offset stay before the text
+        for i in range(bisect.bisect_right(keys, (offset, False)), len(keys)):
+            keys[i] = (keys[i][0] + length, keys[i][1])
+
+    def deleted(self, start, end):
+        """
+        Updates the offsets before the text between start and end is deleted.
+        """
+        if not self._valid():
+            return
+
+        keys = self._keys
+        i = bisect.bisect_left(keys, (start, False))
+        j = bisect.bisect_right(keys, (end, True))
+
+        # The marks of the deleted range all end up at its start, only them
+        # can change order
+        inside = [((start, key[1]), entry) for key, entry in zip(keys[i:j], self._marks[i:j])]
+        inside.sort(key=lambda x: x[0])
+
+        keys[i:j] = [key for key, entry in inside]
+        self._marks[i:j] = [entry for key, entry in inside]
+
+        for k in range(j, len(keys)):
+            keys[k] = (keys[k][0] - (end - start), keys[k][1])
+
+    def move_mark(self, mark, piter):
+        """
+        Moves the mark of a placeholder to piter.
+        """
+        old = self._key(mark)
+        mark.get_buffer().move_mark(mark, piter)
+
+        if not self._valid():
+            return
+
+        i = bisect.bisect_left(self._keys, old)
+
+        while i < len(self._keys) and self._keys[i] == old:
+            if self._marks[i][0] == mark:
+                entry = self._marks.pop(i)
+                del self._keys[i]
+
+                key = self._key(mark)
+                i = bisect.bisect_right(self._keys, key)
+
+                self._keys.insert(i, key)
+                self._marks.insert(i, entry)
+                return
+
+            i += 1
+
+        # Not where it was expected, the offsets are read again
+        self.invalidate()
+
+    def touching(self, begin, end):
+        """
+        Returns the placeholders with a mark between the begin and end
+        iters, both included.
+        """
+        if not self._valid():
+            self._sort()
+
+        i = bisect.bisect_left(self._keys, (begin.get_offset(), False))
+        j = bisect.bisect_right(self._keys, (end.get_offset(), True))
+        found = []
+
+        for mark, placeholder in self._marks[i:j]:
+            if placeholder not in found:
+                found.append(placeholder)
+
+        return found
+
 # ex:ts=4:et:
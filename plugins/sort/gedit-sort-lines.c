@@ -0,0 +1,567 @@
+/*
+ * gedit-sort-lines.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The lines are sorted in a worker thread. The sort key of each line is
+ * computed once, before sorting: a collation key for the text modes, or a
+ * number for the numeric mode, so that comparing two lines is cheap.
+ *
+ * Big inputs are split in runs sorted in parallel, which are then merged
+ * pairwise. Both steps are stable, so that equal lines keep their order.
+ */
+
+#include "gedit-sort-lines.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Below that, the lines are sorted by the worker thread alone. */
+#define MIN_LINES_PER_RUN 16384
+
+typedef struct
+{
+	const gchar *line;
+
+	/* Collation key, for the text and natural modes. */
+	gchar *key;
+
+	/* For the numeric mode; lines without a number come first. */
+	gdouble number;
+	gboolean has_number;
+} SortLine;
+
+typedef struct
+{
+	gchar *text;
+	GeditSortMode mode;
+	GtkSourceSortFlags flags;
+	gint key_start;
+	gchar *field_separator;
+} SortData;
+
+typedef struct
+{
+	const SortData *data;
+	SortLine *lines;
+	gsize n_lines;
+} SortRun;
+
+typedef struct
+{
+	const SortData *data;
+	const SortLine *left;
+	gsize n_left;
+	const SortLine *right;
+	gsize n_right;
+	SortLine *dest;
+} MergeRuns;
+
+static void
+sort_data_free (SortData *data)
+{
+	g_free (data->text);
+	g_free (data->field_separator);
+
+	g_slice_free (SortData, data);
+}
+
+/* Splits @text in place, on any kind of newline. Returns the first newline
+ * found, used to join the sorted lines.
+ */
+static const gchar *
+split_lines (gchar     *text,
+	     GPtrArray *lines)
+{
+	const gchar *newline = NULL;
+	gchar *p = text;
+
+	while (TRUE)
+	{
+		gchar *end = strpbrk (p, "\r\n");
+
+		g_ptr_array_add (lines, p);
+
+		if (end == NULL)
+		{
+			break;
+		}
+
+		if (end[0] == '\r' && end[1] == '\n')
+		{
+			newline = newline != NULL ? newline : "\r\n";
+			*end = '\0';
+			p = end + 2;
+		}
+		else
+		{
+			newline = newline != NULL ? newline : (end[0] == '\r' ? "\r" : "\n");
+			*end = '\0';
+			p = end + 1;
+		}
+	}
+
+	return newline != NULL ? newline : "\n";
+}
+
+/* The part of @line the lines are compared on: from a column, or a field
+ * when a separator is given.
+ */
+static gchar *
+get_key_text (const SortData *data,
+	      const gchar    *line)
+{
+	const gchar *start = line;
+	const gchar *end;
+	gint i;
+
+	if (data->field_separator != NULL)
+	{
+		gsize separator_len = strlen (data->field_separator);
+
+		for (i = 0; i < data->key_start && start != NULL; i++)
+		{
+			start = strstr (start, data->field_separator);
+
+			if (start != NULL)
+			{
+				start += separator_len;
+			}
+		}
+
+		if (start == NULL)
+		{
+			return g_strdup ("");
+		}
+
+		end = strstr (start, data->field_separator);
+
+		return end != NULL ? g_strndup (start, end - start) : g_strdup (start);
+	}
+
+	for (i = 0; i < data->key_start && *start != '\0'; i++)
+	{
+		start = g_utf8_next_char (start);
+	}
+
+	return g_strdup (start);
+}
+
+static void
+compute_key (const SortData *data,
+	     SortLine       *line)
+{
+	gchar *text;
+
+	text = get_key_text (data, line->line);
+
+	if (data->mode == GEDIT_SORT_MODE_NUMERIC)
+	{
+		const gchar *start = text;
+		gchar *end;
+
+		while (g_ascii_isspace (*start))
+		{
+			start++;
+		}
+
+		line->number = g_ascii_strtod (start, &end);
+		line->has_number = end != start;
+		line->key = NULL;
+	}
+	else
+	{
+		if ((data->flags & GTK_SOURCE_SORT_FLAGS_CASE_SENSITIVE) == 0)
+		{
+			gchar *folded = g_utf8_casefold (text, -1);
+
+			g_free (text);
+			text = folded;
+		}
+
+		if (data->mode == GEDIT_SORT_MODE_NATURAL)
+		{
+			line->key = g_utf8_collate_key_for_filename (text, -1);
+		}
+		else
+		{
+			line->key = g_utf8_collate_key (text, -1);
+		}
+	}
+
+	g_free (text);
+}
+
+static gint
+compare_lines (gconstpointer a,
+	       gconstpointer b,
+	       gpointer      user_data)
+{
+	const SortLine *line_a = a;
+	const SortLine *line_b = b;
+	const SortData *data = user_data;
+	gint ret;
+
+	if (data->mode == GEDIT_SORT_MODE_NUMERIC)
+	{
+		if (line_a->has_number != line_b->has_number)
+		{
+			ret = line_a->has_number ? 1 : -1;
+		}
+		else if (!line_a->has_number || line_a->number == line_b->number)
+		{
+			ret = 0;
+		}
+		else
+		{
+			ret = line_a->number < line_b->number ? -1 : 1;
+		}
+	}
+	else
+	{
+		ret = strcmp (line_a->key, line_b->key);
+	}
+
+	if (data->flags & GTK_SOURCE_SORT_FLAGS_REVERSE_ORDER)
+	{
+		ret = -ret;
+	}
+
+	return ret;
+}
+
+/* Keeps the first occurrence of each line. Lines differing only by case
+ * are duplicates unless the sort is case sensitive.
+ */
+static void
+remove_duplicates (const SortData *data,
+		   GPtrArray      *lines)
+{
+	GHashTable *seen;
+	guint i;
+	guint n_kept = 0;
+
+	seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (i = 0; i < lines->len; i++)
+	{
+		gchar *line = g_ptr_array_index (lines, i);
+		gchar *key;
+
+		if (data->flags & GTK_SOURCE_SORT_FLAGS_CASE_SENSITIVE)
+		{
+			key = g_strdup (line);
+		}
+		else
+		{
+			key = g_utf8_casefold (line, -1);
+		}
+
+		if (g_hash_table_contains (seen, key))
+		{
+			g_free (key);
+			continue;
+		}
+
+		g_hash_table_add (seen, key);
+		g_ptr_array_index (lines, n_kept++) = line;
+	}
+
+	g_ptr_array_set_size (lines, n_kept);
+	g_hash_table_unref (seen);
+}
+
+static void
+sort_run_func (gpointer run_data,
+	       gpointer user_data)
+{
+	SortRun *run = run_data;
+
+	g_qsort_with_data (run->lines,
+			   run->n_lines,
+			   sizeof (SortLine),
+			   compare_lines,
+			   (gpointer) run->data);
+}
+
+static void
+merge_runs_func (gpointer merge_data,
+		 gpointer user_data)
+{
+	MergeRuns *merge = merge_data;
+	gsize i = 0;
+	gsize j = 0;
+	gsize k = 0;
+
+	/* Take the left line on equality, to keep the sort stable. */
+	while (i < merge->n_left && j < merge->n_right)
+	{
+		if (compare_lines (&merge->right[j], &merge->left[i], (gpointer) merge->data) < 0)
+		{
+			merge->dest[k++] = merge->right[j++];
+		}
+		else
+		{
+			merge->dest[k++] = merge->left[i++];
+		}
+	}
+
+	memcpy (merge->dest + k, merge->left + i, (merge->n_left - i) * sizeof (SortLine));
+	k += merge->n_left - i;
+	memcpy (merge->dest + k, merge->right + j, (merge->n_right - j) * sizeof (SortLine));
+}
+
+static gboolean
+sort_lines (const SortData *data,
+	    SortLine       *lines,
+	    gsize           n_lines,
+	    GCancellable   *cancellable)
+{
+	GThreadPool *pool;
+	SortRun *runs;
+	MergeRuns *merges;
+	gsize *bounds;
+	SortLine *tmp;
+	SortLine *src;
+	SortLine *dest;
+	guint n_runs;
+	guint i;
+
+	n_runs = MIN ((guint) g_get_num_processors (), n_lines / MIN_LINES_PER_RUN);
+
+	if (n_runs <= 1)
+	{
+		g_qsort_with_data (lines, n_lines, sizeof (SortLine), compare_lines, (gpointer) data);
+		return TRUE;
+	}
+
+	/* bounds[i] is the start of the run i, and bounds[n_runs] the end. */
+	bounds = g_new (gsize, n_runs + 1);
+	runs = g_new (SortRun, n_runs);
+
+	pool = g_thread_pool_new (sort_run_func, NULL, n_runs, FALSE, NULL);
+
+	for (i = 0; i <= n_runs; i++)
+	{
+		bounds[i] = n_lines * i / n_runs;
+	}
+
+	for (i = 0; i < n_runs; i++)
+	{
+		runs[i].data = data;
+		runs[i].lines = lines + bounds[i];
+		runs[i].n_lines = bounds[i + 1] - bounds[i];
+
+		g_thread_pool_push (pool, &runs[i], NULL);
+	}
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_free (runs);
+
+	tmp = g_new (SortLine, n_lines);
+	src = lines;
+	dest = tmp;
+	merges = g_new (MergeRuns, n_runs / 2 + 1);
+
+	while (n_runs > 1 && !g_cancellable_is_cancelled (cancellable))
+	{
+		guint n_merges = n_runs / 2;
+
+		pool = g_thread_pool_new (merge_runs_func, NULL, n_merges, FALSE, NULL);
+
+		for (i = 0; i < n_merges; i++)
+		{
+			gsize left = bounds[2 * i];
+			gsize middle = bounds[2 * i + 1];
+			gsize right = bounds[2 * i + 2];
+
+			merges[i].data = data;
+			merges[i].left = src + left;
+			merges[i].n_left = middle - left;
+			merges[i].right = src + middle;
+			merges[i].n_right = right - middle;
+			merges[i].dest = dest + left;
+
+			g_thread_pool_push (pool, &merges[i], NULL);
+		}
+
+		/* An odd run out is copied as is. */
+		if (n_runs % 2 == 1)
+		{
+			gsize left = bounds[n_runs - 1];
+
+			memcpy (dest + left, src + left, (n_lines - left) * sizeof (SortLine));
+		}
+
+		g_thread_pool_free (pool, FALSE, TRUE);
+
+		/* The runs are now the merged pairs, and the odd one. */
+		for (i = 0; i <= (n_runs + 1) / 2; i++)
+		{
+			bounds[i] = bounds[MIN (2 * i, n_runs)];
+		}
+
+		n_runs = (n_runs + 1) / 2;
+
+		tmp = src;
+		src = dest;
+		dest = tmp;
+	}
+
+	g_free (merges);
+	g_free (bounds);
+
+	if (src != lines)
+	{
+		memcpy (lines, src, n_lines * sizeof (SortLine));
+	}
+
+	g_free (src != lines ? src : dest);
+
+	return !g_cancellable_is_cancelled (cancellable);
+}
+
+static void
+sort_lines_thread (GTask        *task,
+		   gpointer      source_object,
+		   gpointer      task_data,
+		   GCancellable *cancellable)
+{
+	SortData *data = task_data;
+	GPtrArray *line_array;
+	SortLine *lines;
+	const gchar *newline;
+	GString *result;
+	gsize text_len;
+	gsize n_lines;
+	gsize i;
+
+	text_len = strlen (data->text);
+	line_array = g_ptr_array_new ();
+	newline = split_lines (data->text, line_array);
+
+	if (data->flags & GTK_SOURCE_SORT_FLAGS_REMOVE_DUPLICATES)
+	{
+		remove_duplicates (data, line_array);
+	}
+
+	n_lines = line_array->len;
+	lines = g_new (SortLine, n_lines);
+
+	for (i = 0; i < n_lines; i++)
+	{
+		if (i % 4096 == 0 && g_task_return_error_if_cancelled (task))
+		{
+			n_lines = i;
+			goto out;
+		}
+
+		lines[i].line = g_ptr_array_index (line_array, i);
+		compute_key (data, &lines[i]);
+	}
+
+	if (!sort_lines (data, lines, n_lines, cancellable))
+	{
+		g_task_return_error_if_cancelled (task);
+		goto out;
+	}
+
+	result = g_string_sized_new (text_len + 1);
+
+	for (i = 0; i < n_lines; i++)
+	{
+		if (i > 0)
+		{
+			g_string_append (result, newline);
+		}
+
+		g_string_append (result, lines[i].line);
+	}
+
+	g_task_return_pointer (task, g_string_free (result, FALSE), g_free);
+
+out:
+	for (i = 0; i < n_lines; i++)
+	{
+		g_free (lines[i].key);
+	}
+
+	g_free (lines);
+	g_ptr_array_unref (line_array);
+}
+
+/**
+ * gedit_sort_lines_async:
+ * @text: (transfer full): the lines to sort.
+ * @mode: how to compare the lines.
+ * @flags: the #GtkSourceSortFlags.
+ * @key_start: the column the sort key starts at, or the index of the field
+ *   if @field_separator is not %NULL.
+ * @field_separator: (nullable): the separator of the fields.
+ * @cancellable: (nullable): a #GCancellable.
+ * @callback: called when the lines are sorted.
+ * @user_data: user data for @callback.
+ *
+ * Sorts the lines of @text in a worker thread.
+ */
+void
+gedit_sort_lines_async (gchar               *text,
+			GeditSortMode        mode,
+			GtkSourceSortFlags   flags,
+			gint                 key_start,
+			const gchar         *field_separator,
+			GCancellable        *cancellable,
+			GAsyncReadyCallback  callback,
+			gpointer             user_data)
+{
+	GTask *task;
+	SortData *data;
+
+	g_return_if_fail (text != NULL);
+	g_return_if_fail (key_start >= 0);
+
+	data = g_slice_new (SortData);
+	data->text = text;
+	data->mode = mode;
+	data->flags = flags;
+	data->key_start = key_start;
+	data->field_separator = field_separator != NULL && *field_separator != '\0' ?
+				g_strdup (field_separator) : NULL;
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_task_data (task, data, (GDestroyNotify) sort_data_free);
+
+	g_task_run_in_thread (task, sort_lines_thread);
+	g_object_unref (task);
+}
+
+/**
+ * gedit_sort_lines_finish:
+ * @result: a #GAsyncResult.
+ * @error: a #GError, or %NULL.
+ *
+ * Returns: (transfer full): the sorted lines, or %NULL on error.
+ */
+gchar *
+gedit_sort_lines_finish (GAsyncResult  *result,
+			 GError       **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,48 @@
+/*
+ * gedit-sort-lines.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEDIT_SORT_LINES_H
+#define GEDIT_SORT_LINES_H
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+	GEDIT_SORT_MODE_TEXT,
+	GEDIT_SORT_MODE_NATURAL,
+	GEDIT_SORT_MODE_NUMERIC
+} GeditSortMode;
+
+void		 gedit_sort_lines_async		(gchar               *text,
+						 GeditSortMode        mode,
+						 GtkSourceSortFlags   flags,
+						 gint                 key_start,
+						 const gchar         *field_separator,
+						 GCancellable        *cancellable,
+						 GAsyncReadyCallback  callback,
+						 gpointer             user_data);
+
+gchar		*gedit_sort_lines_finish	(GAsyncResult        *result,
+						 GError             **error);
+
+G_END_DECLS
+
+#endif /* GEDIT_SORT_LINES_H */
+
+/* ex:set ts=8 noet: */
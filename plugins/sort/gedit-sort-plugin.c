@@ -32,6 +32,8 @@
 #include <gedit/gedit-app-activatable.h>
 #include <gedit/gedit-window-activatable.h>
 
+#include "gedit-sort-lines.h"
+
 static void gedit_app_activatable_iface_init (GeditAppActivatableInterface *iface);
 static void gedit_window_activatable_iface_init (GeditWindowActivatableInterface *iface);
 
@@ -45,6 +47,11 @@ struct _GeditSortPluginPrivate
 	GtkWidget *reverse_order_checkbutton;
 	GtkWidget *case_checkbutton;
 	GtkWidget *remove_dups_checkbutton;
+	GtkWidget *separator_entry;
+	GtkWidget *mode_combobox;
+
+	/* The sort in progress, if any. */
+	GCancellable *cancellable;
 
 	GeditApp *app;
 	GeditMenuExtension *menu_ext;
@@ -69,13 +76,111 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditSortPlugin,
 							       gedit_window_activatable_iface_init)
 				G_ADD_PRIVATE_DYNAMIC (GeditSortPlugin))
 
+typedef struct
+{
+	GeditDocument *doc;
+	GtkTextMark *start_mark;
+	GtkTextMark *end_mark;
+	GCancellable *cancellable;
+	gulong changed_id;
+} SortJob;
+
+static void
+sort_job_free (SortJob *job)
+{
+	g_signal_handler_disconnect (job->doc, job->changed_id);
+
+	gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (job->doc), job->start_mark);
+	gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (job->doc), job->end_mark);
+
+	g_object_unref (job->doc);
+	g_object_unref (job->cancellable);
+
+	g_slice_free (SortJob, job);
+}
+
+/* The sorted lines would overwrite the changes. */
+static void
+document_changed_cb (GtkTextBuffer *buffer,
+		     SortJob       *job)
+{
+	g_cancellable_cancel (job->cancellable);
+}
+
+static void
+sort_lines_ready_cb (GObject      *source_object,
+		     GAsyncResult *result,
+		     gpointer      user_data)
+{
+	SortJob *job = user_data;
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (job->doc);
+	GError *error = NULL;
+	gchar *sorted;
+	GtkTextIter start, end;
+
+	sorted = gedit_sort_lines_finish (result, &error);
+
+	if (sorted == NULL)
+	{
+		gedit_debug_message (DEBUG_PLUGINS, "Sort cancelled: %s", error->message);
+
+		g_error_free (error);
+		sort_job_free (job);
+		return;
+	}
+
+	g_signal_handler_block (job->doc, job->changed_id);
+
+	gtk_text_buffer_get_iter_at_mark (buffer, &start, job->start_mark);
+	gtk_text_buffer_get_iter_at_mark (buffer, &end, job->end_mark);
+
+	gtk_text_buffer_begin_user_action (buffer);
+	gtk_text_buffer_delete (buffer, &start, &end);
+	gtk_text_buffer_insert (buffer, &start, sorted, -1);
+	gtk_text_buffer_end_user_action (buffer);
+
+	g_signal_handler_unblock (job->doc, job->changed_id);
+
+	g_free (sorted);
+	sort_job_free (job);
+
+	gedit_debug_message (DEBUG_PLUGINS, "Done.");
+}
+
+/* Like gtk_source_buffer_sort_lines(), sort whole lines, without the
+ * trailing newline.
+ */
+static void
+get_lines_range (GtkTextIter *start,
+		 GtkTextIter *end)
+{
+	gtk_text_iter_order (start, end);
+
+	gtk_text_iter_set_line_offset (start, 0);
+
+	if (gtk_text_iter_starts_line (end) &&
+	    gtk_text_iter_get_line (end) > gtk_text_iter_get_line (start))
+	{
+		gtk_text_iter_backward_line (end);
+	}
+
+	if (!gtk_text_iter_ends_line (end))
+	{
+		gtk_text_iter_forward_to_line_end (end);
+	}
+}
+
 static void
 do_sort (GeditSortPlugin *plugin)
 {
 	GeditSortPluginPrivate *priv;
 	GeditDocument *doc;
 	GtkSourceSortFlags sort_flags = 0;
+	GeditSortMode mode = GEDIT_SORT_MODE_TEXT;
+	const gchar *mode_id;
+	const gchar *separator;
 	gint starting_column;
+	SortJob *job;
 
 	gedit_debug (DEBUG_PLUGINS);
 
@@ -99,15 +204,57 @@ do_sort (GeditSortPlugin *plugin)
 		sort_flags |= GTK_SOURCE_SORT_FLAGS_REMOVE_DUPLICATES;
 	}
 
+	mode_id = gtk_combo_box_get_active_id (GTK_COMBO_BOX (priv->mode_combobox));
+
+	if (g_strcmp0 (mode_id, "natural") == 0)
+	{
+		mode = GEDIT_SORT_MODE_NATURAL;
+	}
+	else if (g_strcmp0 (mode_id, "numeric") == 0)
+	{
+		mode = GEDIT_SORT_MODE_NUMERIC;
+	}
+
+	separator = gtk_entry_get_text (GTK_ENTRY (priv->separator_entry));
 	starting_column = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (priv->col_num_spinbutton)) - 1;
 
-	gtk_source_buffer_sort_lines (GTK_SOURCE_BUFFER (doc),
-	                              &priv->start,
-	                              &priv->end,
-	                              sort_flags,
-	                              starting_column);
+	get_lines_range (&priv->start, &priv->end);
 
-	gedit_debug_message (DEBUG_PLUGINS, "Done.");
+	if (gtk_text_iter_equal (&priv->start, &priv->end))
+	{
+		return;
+	}
+
+	/* A new sort replaces the one in progress. */
+	if (priv->cancellable != NULL)
+	{
+		g_cancellable_cancel (priv->cancellable);
+		g_object_unref (priv->cancellable);
+	}
+
+	priv->cancellable = g_cancellable_new ();
+
+	job = g_slice_new (SortJob);
+	job->doc = g_object_ref (doc);
+	job->cancellable = g_object_ref (priv->cancellable);
+	job->start_mark = gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (doc), NULL, &priv->start, TRUE);
+	job->end_mark = gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (doc), NULL, &priv->end, FALSE);
+	job->changed_id = g_signal_connect (doc,
+					    "changed",
+					    G_CALLBACK (document_changed_cb),
+					    job);
+
+	gedit_sort_lines_async (gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (doc),
+							   &priv->start,
+							   &priv->end,
+							   TRUE),
+				mode,
+				sort_flags,
+				starting_column,
+				separator,
+				job->cancellable,
+				sort_lines_ready_cb,
+				job);
 }
 
 static void
@@ -168,6 +315,8 @@ create_sort_dialog (GeditSortPlugin *plugin)
 	priv->col_num_spinbutton = GTK_WIDGET (gtk_builder_get_object (builder, "col_num_spinbutton"));
 	priv->case_checkbutton = GTK_WIDGET (gtk_builder_get_object (builder, "case_checkbutton"));
 	priv->remove_dups_checkbutton = GTK_WIDGET (gtk_builder_get_object (builder, "remove_dups_checkbutton"));
+	priv->separator_entry = GTK_WIDGET (gtk_builder_get_object (builder, "separator_entry"));
+	priv->mode_combobox = GTK_WIDGET (gtk_builder_get_object (builder, "mode_combobox"));
 	g_object_unref (builder);
 
 	gtk_dialog_set_default_response (GTK_DIALOG (priv->dialog),
@@ -282,6 +431,12 @@ gedit_sort_plugin_window_deactivate (GeditWindowActivatable *activatable)
 
 	priv = GEDIT_SORT_PLUGIN (activatable)->priv;
 	g_action_map_remove_action (G_ACTION_MAP (priv->window), "sort");
+
+	if (priv->cancellable != NULL)
+	{
+		g_cancellable_cancel (priv->cancellable);
+		g_clear_object (&priv->cancellable);
+	}
 }
 
 static void
@@ -308,6 +463,7 @@ gedit_sort_plugin_dispose (GObject *object)
 	gedit_debug_message (DEBUG_PLUGINS, "GeditSortPlugin disposing");
 
 	g_clear_object (&plugin->priv->action);
+	g_clear_object (&plugin->priv->cancellable);
 	g_clear_object (&plugin->priv->window);
 	g_clear_object (&plugin->priv->menu_ext);
 	g_clear_object (&plugin->priv->app);
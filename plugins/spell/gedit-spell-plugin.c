@@ -37,6 +37,9 @@
 #define SPELL_BASE_SETTINGS	"org.gnome.gedit.plugins.spell"
 #define SETTINGS_KEY_HIGHLIGHT_MISSPELLED "highlight-misspelled"
 
+#define INLINE_CHECKER_SETUP_ID_KEY "gedit-spell-plugin-inline-checker-setup-id"
+#define SHARED_CHECKER_CODE_KEY "gedit-spell-plugin-shared-checker-code"
+
 static void gedit_window_activatable_iface_init (GeditWindowActivatableInterface *iface);
 static void peas_gtk_configurable_iface_init (PeasGtkConfigurableInterface *iface);
 
@@ -62,6 +65,20 @@ struct _SpellConfigureWidget
 	GSettings *settings;
 };
 
+typedef struct _InlineCheckerSetup InlineCheckerSetup;
+
+struct _InlineCheckerSetup
+{
+	GeditSpellPlugin *plugin;
+	GeditView *view;
+};
+
+/* Language code -> GspellChecker, shared by all the documents of the
+ * application. The checkers are not owned by the table, they are removed when
+ * the last document using them is closed.
+ */
+static GHashTable *shared_checkers = NULL;
+
 G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditSpellPlugin,
 				gedit_spell_plugin,
 				PEAS_TYPE_EXTENSION_BASE,
@@ -160,6 +177,197 @@ get_spell_checker (GeditDocument *doc)
 	return gspell_text_buffer_get_spell_checker (gspell_buffer);
 }
 
+static gboolean
+is_checker (gpointer key,
+	    gpointer value,
+	    gpointer user_data)
+{
+	return value == user_data;
+}
+
+static void
+shared_checker_finalized_cb (gpointer  data,
+			     GObject  *where_the_object_was)
+{
+	g_hash_table_foreach_remove (shared_checkers, is_checker, where_the_object_was);
+}
+
+static void set_shared_checker (GeditDocument        *doc,
+				const GspellLanguage *lang);
+
+/* The language of a shared checker is changed by the context menu of the
+ * view of one of its documents. Only that document takes the new language,
+ * with the shared checker of that language, the others keep the previous
+ * one. When the document can't be found, they all follow.
+ */
+static void
+shared_checker_language_notify_cb (GspellChecker *checker,
+				   GParamSpec    *pspec,
+				   gpointer       user_data)
+{
+	const GspellLanguage *lang;
+	const GspellLanguage *previous_lang;
+	const gchar *code;
+	gchar *previous_code;
+	GList *views;
+	GList *l;
+	GList *docs = NULL;
+	GList *changed = NULL;
+
+	lang = gspell_checker_get_language (checker);
+	code = lang != NULL ? gspell_language_get_code (lang) : "";
+
+	previous_code = g_strdup (g_object_get_data (G_OBJECT (checker), SHARED_CHECKER_CODE_KEY));
+
+	if (g_strcmp0 (code, previous_code) == 0)
+	{
+		g_free (previous_code);
+		return;
+	}
+
+	/* Keep the checker under its new language */
+	if (g_hash_table_lookup (shared_checkers, previous_code) == checker)
+	{
+		g_hash_table_remove (shared_checkers, previous_code);
+	}
+
+	if (!g_hash_table_contains (shared_checkers, code))
+	{
+		g_hash_table_insert (shared_checkers, g_strdup (code), checker);
+	}
+
+	g_object_set_data_full (G_OBJECT (checker),
+				SHARED_CHECKER_CODE_KEY,
+				g_strdup (code),
+				g_free);
+
+	views = gedit_app_get_views (GEDIT_APP (g_application_get_default ()));
+
+	for (l = views; l != NULL; l = l->next)
+	{
+		GeditDocument *doc;
+
+		doc = GEDIT_DOCUMENT (gtk_text_view_get_buffer (GTK_TEXT_VIEW (l->data)));
+
+		if (get_spell_checker (doc) != checker)
+		{
+			continue;
+		}
+
+		if (g_list_find (docs, doc) == NULL)
+		{
+			docs = g_list_prepend (docs, doc);
+		}
+
+		if (gtk_widget_has_focus (GTK_WIDGET (l->data)))
+		{
+			changed = g_list_prepend (changed, doc);
+		}
+	}
+
+	if (changed == NULL)
+	{
+		changed = g_list_copy (docs);
+	}
+
+	previous_lang = gspell_language_lookup (previous_code);
+
+	for (l = docs; l != NULL; l = l->next)
+	{
+		GeditDocument *doc = l->data;
+
+		if (g_list_find (changed, doc) == NULL)
+		{
+			set_shared_checker (doc, previous_lang);
+			continue;
+		}
+
+		set_shared_checker (doc, lang);
+
+		if (lang != NULL)
+		{
+			gedit_document_set_metadata (doc,
+						     GEDIT_METADATA_ATTRIBUTE_SPELL_LANGUAGE, code,
+						     NULL);
+		}
+	}
+
+	g_list_free (changed);
+	g_list_free (docs);
+	g_list_free (views);
+	g_free (previous_code);
+}
+
+/* Documents with the same language share their checker, so that a
+ * dictionary is set up once per language and the words ignored during the
+ * session are known to all the documents.
+ */
+static GspellChecker *
+get_shared_checker (const GspellLanguage *lang)
+{
+	const gchar *code;
+	GspellChecker *checker;
+
+	if (shared_checkers == NULL)
+	{
+		shared_checkers = g_hash_table_new_full (g_str_hash,
+							 g_str_equal,
+							 g_free,
+							 NULL);
+	}
+
+	if (lang == NULL)
+	{
+		lang = gspell_language_get_default ();
+	}
+
+	/* NULL if no dictionaries are installed */
+	code = lang != NULL ? gspell_language_get_code (lang) : "";
+
+	checker = g_hash_table_lookup (shared_checkers, code);
+	if (checker != NULL)
+	{
+		return g_object_ref (checker);
+	}
+
+	checker = gspell_checker_new (lang);
+
+	g_hash_table_insert (shared_checkers, g_strdup (code), checker);
+	g_object_set_data_full (G_OBJECT (checker),
+				SHARED_CHECKER_CODE_KEY,
+				g_strdup (code),
+				g_free);
+	g_object_weak_ref (G_OBJECT (checker),
+			   shared_checker_finalized_cb,
+			   NULL);
+
+	g_signal_connect (checker,
+			  "notify::language",
+			  G_CALLBACK (shared_checker_language_notify_cb),
+			  NULL);
+
+	return checker;
+}
+
+static void
+set_shared_checker (GeditDocument        *doc,
+		    const GspellLanguage *lang)
+{
+	GspellTextBuffer *gspell_buffer;
+	GspellChecker *checker;
+
+	gspell_buffer = gspell_text_buffer_get_from_gtk_text_buffer (GTK_TEXT_BUFFER (doc));
+
+	checker = get_shared_checker (lang);
+
+	if (gspell_text_buffer_get_spell_checker (gspell_buffer) != checker)
+	{
+		gspell_text_buffer_set_spell_checker (gspell_buffer, checker);
+	}
+
+	g_object_unref (checker);
+}
+
 static const GspellLanguage *
 get_language_from_metadata (GeditDocument *doc)
 {
@@ -218,6 +426,30 @@ language_dialog_response_cb (GtkDialog *dialog,
 	gtk_widget_destroy (GTK_WIDGET (dialog));
 }
 
+static void
+language_notify_cb (GspellLanguageChooser *chooser,
+		    GParamSpec            *pspec,
+		    GeditDocument         *doc)
+{
+	const GspellLanguage *lang;
+	const gchar *language_code;
+
+	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
+
+	lang = gspell_language_chooser_get_language (chooser);
+	g_return_if_fail (lang != NULL);
+
+	language_code = gspell_language_get_code (lang);
+	g_return_if_fail (language_code != NULL);
+
+	/* The checker is shared, the other documents keep their language. */
+	set_shared_checker (doc, lang);
+
+	gedit_document_set_metadata (doc,
+				     GEDIT_METADATA_ATTRIBUTE_SPELL_LANGUAGE, language_code,
+				     NULL);
+}
+
 static void
 set_language_cb (GSimpleAction *action,
 		 GVariant      *parameter,
@@ -248,9 +480,11 @@ set_language_cb (GSimpleAction *action,
 						     GTK_DIALOG_MODAL |
 						     GTK_DIALOG_DESTROY_WITH_PARENT);
 
-	g_object_bind_property (dialog, "language",
-				checker, "language",
-				G_BINDING_DEFAULT);
+	g_signal_connect_object (dialog,
+				 "notify::language",
+				 G_CALLBACK (language_notify_cb),
+				 doc,
+				 0);
 
 	window_group = gedit_window_get_group (priv->window);
 
@@ -431,53 +665,89 @@ setup_inline_checker_from_metadata (GeditSpellPlugin *plugin,
 }
 
 static void
-language_notify_cb (GspellChecker *checker,
-		    GParamSpec    *pspec,
-		    GeditDocument *doc)
+cancel_inline_checker_setup (GeditView *view)
 {
-	const GspellLanguage *lang;
-	const gchar *language_code;
+	guint id;
 
-	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
+	id = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (view), INLINE_CHECKER_SETUP_ID_KEY));
 
-	lang = gspell_checker_get_language (checker);
-	g_return_if_fail (lang != NULL);
+	if (id != 0)
+	{
+		g_source_remove (id);
+		g_object_set_data (G_OBJECT (view), INLINE_CHECKER_SETUP_ID_KEY, NULL);
+	}
+}
 
-	language_code = gspell_language_get_code (lang);
-	g_return_if_fail (language_code != NULL);
+static gboolean
+inline_checker_setup_idle_cb (gpointer user_data)
+{
+	InlineCheckerSetup *setup = user_data;
 
-	gedit_document_set_metadata (doc,
-				     GEDIT_METADATA_ATTRIBUTE_SPELL_LANGUAGE, language_code,
-				     NULL);
+	g_object_set_data (G_OBJECT (setup->view), INLINE_CHECKER_SETUP_ID_KEY, NULL);
+	setup_inline_checker_from_metadata (setup->plugin, setup->view);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+inline_checker_setup_free (gpointer data)
+{
+	g_slice_free (InlineCheckerSetup, data);
+}
+
+/* The inline checker checks the visible region of the view when it is
+ * enabled, and the rest as it is scrolled into view. Enabling it at a low
+ * priority lets the view show the loaded text, and be sized and scrolled
+ * to the cursor first, so that the region checked is the right one and
+ * loading a big document is not followed by a check of its beginning.
+ */
+static void
+schedule_inline_checker_setup (GeditSpellPlugin *plugin,
+			       GeditView        *view)
+{
+	InlineCheckerSetup *setup;
+	guint id;
+
+	cancel_inline_checker_setup (view);
+
+	setup = g_slice_new (InlineCheckerSetup);
+	setup->plugin = plugin;
+	setup->view = view;
+
+	id = g_idle_add_full (G_PRIORITY_LOW,
+			      inline_checker_setup_idle_cb,
+			      setup,
+			      inline_checker_setup_free);
+
+	g_object_set_data (G_OBJECT (view), INLINE_CHECKER_SETUP_ID_KEY, GUINT_TO_POINTER (id));
 }
 
 static void
 on_document_loaded (GeditDocument    *doc,
 		    GeditSpellPlugin *plugin)
 {
-	GspellChecker *checker;
+	const GspellLanguage *lang;
 	GeditTab *tab;
 	GeditView *view;
+	GspellTextView *gspell_view;
 
-	checker = get_spell_checker (doc);
+	tab = gedit_tab_get_from_document (doc);
+	view = gedit_tab_get_view (tab);
 
-	if (checker != NULL)
-	{
-		const GspellLanguage *lang;
+	/* Don't check the whole document with the previous language, when
+	 * the document is reverted for example.
+	 */
+	gspell_view = gspell_text_view_get_from_gtk_text_view (GTK_TEXT_VIEW (view));
+	gspell_text_view_set_inline_spell_checking (gspell_view, FALSE);
 
-		lang = get_language_from_metadata (doc);
+	lang = get_language_from_metadata (doc);
 
-		if (lang != NULL)
-		{
-			g_signal_handlers_block_by_func (checker, language_notify_cb, doc);
-			gspell_checker_set_language (checker, lang);
-			g_signal_handlers_unblock_by_func (checker, language_notify_cb, doc);
-		}
+	if (lang != NULL && get_spell_checker (doc) != NULL)
+	{
+		set_shared_checker (doc, lang);
 	}
 
-	tab = gedit_tab_get_from_document (doc);
-	view = gedit_tab_get_view (tab);
-	setup_inline_checker_from_metadata (plugin, view);
+	schedule_inline_checker_setup (plugin, view);
 }
 
 static void
@@ -533,23 +803,7 @@ activate_spell_checking_in_view (GeditSpellPlugin *plugin,
 	 */
 	if (get_spell_checker (doc) == NULL)
 	{
-		const GspellLanguage *lang;
-		GspellChecker *checker;
-		GspellTextBuffer *gspell_buffer;
-
-		lang = get_language_from_metadata (doc);
-		checker = gspell_checker_new (lang);
-
-		g_signal_connect_object (checker,
-					 "notify::language",
-					 G_CALLBACK (language_notify_cb),
-					 doc,
-					 0);
-
-		gspell_buffer = gspell_text_buffer_get_from_gtk_text_buffer (GTK_TEXT_BUFFER (doc));
-		gspell_text_buffer_set_spell_checker (gspell_buffer, checker);
-		g_object_unref (checker);
-
+		set_shared_checker (doc, get_language_from_metadata (doc));
 		setup_inline_checker_from_metadata (plugin, view);
 	}
 
@@ -572,6 +826,8 @@ disconnect_view (GeditSpellPlugin *plugin,
 {
 	GtkTextBuffer *buffer;
 
+	cancel_inline_checker_setup (view);
+
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
 
 	/* It should still be the same buffer as the one where the signal